@@ -0,0 +1,218 @@
+﻿#include "Blend.h"
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define BLEND_TARGET(isa)
+#else
+#define BLEND_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace Blend
+{
+    RowFn row = rowScalar;
+
+    namespace
+    {
+        Level current = Level::Scalar;
+        Level detected = Level::Scalar;
+        bool detectedOnce = false;
+
+        Level detect()
+        {
+#if defined(_MSC_VER)
+            int info[4] = {0};
+            __cpuid(info, 0);
+            const int maxLeaf = info[0];
+            if (maxLeaf < 1)
+                return Level::Scalar;
+
+            __cpuid(info, 1);
+            const bool sse41 = (info[2] & (1 << 19)) != 0;
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool avx = (info[2] & (1 << 28)) != 0;
+
+            bool avx2 = false;
+            if (maxLeaf >= 7 && osxsave && avx)
+            {
+                // 操作系统必须保存 YMM 寄存器状态
+                const unsigned long long xcr0 = _xgetbv(0);
+                if ((xcr0 & 0x6) == 0x6)
+                {
+                    __cpuidex(info, 7, 0);
+                    avx2 = (info[1] & (1 << 5)) != 0;
+                }
+            }
+            if (avx2)
+                return Level::AVX2;
+            if (sse41)
+                return Level::SSE41;
+            return Level::Scalar;
+#else
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+                return Level::AVX2;
+            if (__builtin_cpu_supports("sse4.1"))
+                return Level::SSE41;
+            return Level::Scalar;
+#endif
+        }
+
+        // 精确的无符号32位除以255: floor(x / 255) == (x * 0x80808081) >> 39, 对全部 x < 2^32 成立
+        BLEND_TARGET("sse4.1")
+        inline __m128i div255_128(__m128i x)
+        {
+            const __m128i magic = _mm_set1_epi32(static_cast<int>(0x80808081u));
+            __m128i even = _mm_srli_epi64(_mm_mul_epu32(x, magic), 39);
+            __m128i odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32), magic), 39);
+            return _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+        }
+
+        BLEND_TARGET("avx2")
+        inline __m256i div255_256(__m256i x)
+        {
+            const __m256i magic = _mm256_set1_epi32(static_cast<int>(0x80808081u));
+            __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(x, magic), 39);
+            __m256i odd = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), magic), 39);
+            return _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+        }
+    }
+
+    void rowScalar(uint32_t *dest, const uint32_t *src, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            dest[i] = pixel(dest[i], src[i]);
+        }
+    }
+
+    // 一次处理4个像素, 按标量公式在32位通道内逐步复现(乘法、精确除255、掩码), 保证逐位一致
+    BLEND_TARGET("sse4.1")
+    void rowSSE41(uint32_t *dest, const uint32_t *src, int count)
+    {
+        const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+        const __m128i rbMask = _mm_set1_epi32(0x00FF00FF);
+        const __m128i gMask = _mm_set1_epi32(0x0000FF00);
+        const __m128i c255 = _mm_set1_epi32(255);
+        const __m128i zero = _mm_setzero_si128();
+
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            __m128i sa = _mm_and_si128(s, alphaMask);
+
+            // 4个像素全透明: 目标不变
+            if (_mm_testz_si128(sa, sa))
+                continue;
+            // 4个像素全不透明: 直接写源像素
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, alphaMask)) == 0xFFFF)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), s);
+                continue;
+            }
+
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dest + i));
+            __m128i a = _mm_srli_epi32(s, 24);
+            __m128i invA = _mm_sub_epi32(c255, a);
+
+            __m128i rb = _mm_mullo_epi32(_mm_and_si128(d, rbMask), invA);
+            __m128i g = _mm_mullo_epi32(_mm_and_si128(d, gMask), invA);
+            rb = _mm_and_si128(div255_128(rb), rbMask);
+            g = _mm_and_si128(div255_128(g), gMask);
+
+            __m128i out = _mm_add_epi32(s, _mm_add_epi32(rb, g));
+            // src_a == 0 的像素保持目标原值(包括目标Alpha)
+            out = _mm_blendv_epi8(out, d, _mm_cmpeq_epi32(a, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), out);
+        }
+        for (; i < count; ++i)
+        {
+            dest[i] = pixel(dest[i], src[i]);
+        }
+    }
+
+    // 一次处理8个像素, 逻辑与 SSE4.1 版本相同
+    BLEND_TARGET("avx2")
+    void rowAVX2(uint32_t *dest, const uint32_t *src, int count)
+    {
+        const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+        const __m256i rbMask = _mm256_set1_epi32(0x00FF00FF);
+        const __m256i gMask = _mm256_set1_epi32(0x0000FF00);
+        const __m256i c255 = _mm256_set1_epi32(255);
+        const __m256i zero = _mm256_setzero_si256();
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+            __m256i sa = _mm256_and_si256(s, alphaMask);
+
+            if (_mm256_testz_si256(sa, sa))
+                continue;
+            if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, alphaMask)) == -1)
+            {
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + i), s);
+                continue;
+            }
+
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dest + i));
+            __m256i a = _mm256_srli_epi32(s, 24);
+            __m256i invA = _mm256_sub_epi32(c255, a);
+
+            __m256i rb = _mm256_mullo_epi32(_mm256_and_si256(d, rbMask), invA);
+            __m256i g = _mm256_mullo_epi32(_mm256_and_si256(d, gMask), invA);
+            rb = _mm256_and_si256(div255_256(rb), rbMask);
+            g = _mm256_and_si256(div255_256(g), gMask);
+
+            __m256i out = _mm256_add_epi32(s, _mm256_add_epi32(rb, g));
+            out = _mm256_blendv_epi8(out, d, _mm256_cmpeq_epi32(a, zero));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + i), out);
+        }
+        // 剩余不足8个的像素交给 SSE4.1 和标量尾部处理
+        if (i < count)
+        {
+            rowSSE41(dest + i, src + i, count - i);
+        }
+    }
+
+    void init()
+    {
+        setLevel(maxLevel());
+    }
+
+    void setLevel(Level level)
+    {
+        if (level > maxLevel())
+            level = maxLevel();
+
+        current = level;
+        switch (level)
+        {
+        case Level::AVX2:
+            row = rowAVX2;
+            break;
+        case Level::SSE41:
+            row = rowSSE41;
+            break;
+        default:
+            row = rowScalar;
+            break;
+        }
+    }
+
+    Level level()
+    {
+        return current;
+    }
+
+    Level maxLevel()
+    {
+        if (!detectedOnce)
+        {
+            detected = detect();
+            detectedOnce = true;
+        }
+        return detected;
+    }
+}
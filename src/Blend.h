@@ -0,0 +1,60 @@
+﻿#pragma once
+#include <cstdint>
+
+// 预乘Alpha混合内核
+// 标量版本 Blend::pixel 是参考实现, SSE4.1/AVX2 内核与其逐位一致。
+// 内核在 Blend::init() 中按CPU特性选择一次, 之后通过函数指针调用, 行循环内不再做分支判断。
+namespace Blend
+{
+    enum class Level
+    {
+        Scalar = 0,
+        SSE41 = 1,
+        AVX2 = 2,
+    };
+
+    // 高效的32位预乘Alpha混合 (整数运算)
+    inline uint32_t pixel(uint32_t dest, uint32_t src)
+    {
+        uint32_t src_a = src >> 24;
+        if (src_a == 255)
+            return src;
+        if (src_a == 0)
+            return dest;
+
+        uint32_t inv_a = 255 - src_a;
+
+        // 分离 dest 的 R,B 和 G 通道
+        uint32_t dest_rb = dest & 0x00FF00FF;
+        uint32_t dest_g = dest & 0x0000FF00;
+
+        // dest = dest * (1 - src_a)
+        dest_rb = (dest_rb * inv_a) / 255;
+        dest_g = (dest_g * inv_a) / 255;
+
+        // 清理溢出位
+        dest_rb &= 0x00FF00FF;
+        dest_g &= 0x0000FF00;
+
+        // out = src(premultiplied) + dest(scaled)
+        return src + dest_rb + dest_g;
+    }
+
+    // 行混合: dest[i] = pixel(dest[i], src[i]), i ∈ [0, count)
+    using RowFn = void (*)(uint32_t *dest, const uint32_t *src, int count);
+
+    // 当前选中的行混合内核, init() 之前为标量版本
+    extern RowFn row;
+
+    // 检测CPU特性并选择最快的内核
+    void init();
+    // 强制指定内核级别(用于对比测试), 超出CPU支持的级别会被降级
+    void setLevel(Level level);
+    Level level();
+    // CPU支持的最高级别
+    Level maxLevel();
+
+    void rowScalar(uint32_t *dest, const uint32_t *src, int count);
+    void rowSSE41(uint32_t *dest, const uint32_t *src, int count);
+    void rowAVX2(uint32_t *dest, const uint32_t *src, int count);
+}
@@ -0,0 +1,155 @@
+﻿#include "CachedImage.h"
+
+namespace
+{
+    inline SpanType classify(uint32_t a)
+    {
+        if (a == 0)
+            return SpanType::Transparent;
+        if (a == 255)
+            return SpanType::Opaque;
+        return SpanType::Partial;
+    }
+
+    struct Run
+    {
+        int x;
+        int len;
+        SpanType type;
+    };
+}
+
+uint32_t *CachedImage::allocate(int w, int h)
+{
+    width = w;
+    height = h;
+    pixelStorage = std::make_unique<uint32_t[]>((size_t)w * h);
+    pixels = pixelStorage.get();
+    return pixelStorage.get();
+}
+
+uint8_t *CachedImage::allocateCoverage(int w, int h)
+{
+    width = w;
+    height = h;
+    coverageStorage = std::make_unique<uint8_t[]>((size_t)w * h);
+    coverage = coverageStorage.get();
+    return coverageStorage.get();
+}
+
+void CachedImage::mirrorFrom(const CachedImage &src)
+{
+    uint32_t *dest = allocate(src.width, src.height);
+    for (int y = 0; y < height; ++y)
+    {
+        const uint32_t *row = src.pixels + (size_t)y * width;
+        uint32_t *out = dest + (size_t)y * width;
+        for (int x = 0; x < width; ++x)
+        {
+            out[x] = row[width - 1 - x];
+        }
+    }
+    buildSpans();
+}
+
+void CachedImage::buildSpans()
+{
+    spanStorage.clear();
+    rowSpanStorage.clear();
+    spans = nullptr;
+    rowSpans = nullptr;
+    isOpaque = true;
+
+    if ((!pixels && !coverage) || width <= 0 || height <= 0)
+        return;
+    auto alpha = [this](size_t i) -> uint32_t
+    {
+        return pixels ? pixels[i] >> 24 : coverage[i];
+    };
+
+    // 游程坐标用16位存储, 超宽图像不建表, 绘制时走通用路径
+    if (width > UINT16_MAX)
+    {
+        const int pixelCount = width * height;
+        for (int i = 0; i < pixelCount; ++i)
+        {
+            if (alpha(i) < 255)
+            {
+                isOpaque = false;
+                break;
+            }
+        }
+        return;
+    }
+
+    rowSpanStorage.reserve((size_t)height + 1);
+    std::vector<Run> runs;
+    runs.reserve(64);
+
+    for (int y = 0; y < height; ++y)
+    {
+        rowSpanStorage.push_back(static_cast<uint32_t>(spanStorage.size()));
+        const size_t row = (size_t)y * width;
+
+        // 1. 原始游程
+        runs.clear();
+        int start = 0;
+        SpanType type = classify(alpha(row));
+        for (int x = 1; x < width; ++x)
+        {
+            SpanType t = classify(alpha(row + x));
+            if (t != type)
+            {
+                runs.push_back({start, x - start, type});
+                start = x;
+                type = t;
+            }
+        }
+        runs.push_back({start, width - start, type});
+
+        if (runs.size() != 1 || runs[0].type != SpanType::Opaque)
+            isOpaque = false;
+
+        // 2. 短的不透明段(贴着半透明段)和夹在非透明段之间的短透明缝隙并入半透明
+        for (size_t i = 0; i < runs.size(); ++i)
+        {
+            Run &r = runs[i];
+            if (r.len >= MIN_RUN)
+                continue;
+            bool hasPrev = i > 0;
+            bool hasNext = i + 1 < runs.size();
+            if (r.type == SpanType::Opaque)
+            {
+                if ((hasPrev && runs[i - 1].type == SpanType::Partial) || (hasNext && runs[i + 1].type == SpanType::Partial))
+                    r.type = SpanType::Partial;
+            }
+            else if (r.type == SpanType::Transparent)
+            {
+                if (hasPrev && hasNext && runs[i - 1].type != SpanType::Transparent && runs[i + 1].type != SpanType::Transparent)
+                    r.type = SpanType::Partial;
+            }
+        }
+
+        // 3. 合并相邻同类段, 丢弃透明段
+        size_t rowFirst = spanStorage.size();
+        for (const Run &r : runs)
+        {
+            if (r.type == SpanType::Transparent)
+                continue;
+            if (spanStorage.size() > rowFirst)
+            {
+                ImageSpan &last = spanStorage.back();
+                if (last.type == r.type && last.x + last.len == r.x)
+                {
+                    last.len = static_cast<uint16_t>(last.len + r.len);
+                    continue;
+                }
+            }
+            spanStorage.push_back({static_cast<uint16_t>(r.x), static_cast<uint16_t>(r.len), r.type});
+        }
+    }
+    rowSpanStorage.push_back(static_cast<uint32_t>(spanStorage.size()));
+    spanStorage.shrink_to_fit();
+    spans = spanStorage.data();
+    rowSpans = rowSpanStorage.data();
+}
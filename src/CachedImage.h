@@ -0,0 +1,82 @@
+﻿#pragma once
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+// 行内游程类型
+enum class SpanType : uint8_t
+{
+    Transparent = 0, // alpha == 0, 绘制时直接跳过
+    Opaque = 1,      // alpha == 255, 绘制时直接内存复制
+    Partial = 2,     // 其余, 需要逐像素混合
+};
+
+// 一段连续的同类像素, x 为图像内列坐标
+struct ImageSpan
+{
+    uint16_t x;
+    uint16_t len;
+    SpanType type;
+};
+// 资源包中按该布局直接存储
+static_assert(sizeof(ImageSpan) == 6, "ImageSpan layout is stored in sprite packs");
+
+// 图像缓存结构
+// 像素和游程表通过指针访问: 运行时解码的图像指向自身持有的存储, 资源包中的图像直接指向映射的文件内容
+struct CachedImage
+{
+    // 短于该长度的不透明段/透明缝隙并入相邻的半透明段, 避免游程过碎
+    // (对 alpha 为 0 或 255 的像素做混合与跳过/复制结果一致, 合并不影响输出)
+    static const int MIN_RUN = 4;
+
+    int width = 0;
+    int height = 0;
+    const uint32_t *pixels = nullptr; // 预乘Alpha的BGRA格式
+    // 只有覆盖率 (0~255) 没有颜色的图像, 如字形图集页, 此时 pixels 为空, 绘制时再乘上颜色
+    const uint8_t *coverage = nullptr;
+    bool isOpaque = true;
+
+    // 每行的游程表, 只记录不透明和半透明段, 段之间的空隙即透明像素
+    // 第 y 行的游程为 spans[rowSpans[y] .. rowSpans[y + 1]), rowSpans 为空表示没有游程表
+    const ImageSpan *spans = nullptr;
+    const uint32_t *rowSpans = nullptr;
+
+    // 分配自身持有的像素存储并返回可写指针
+    uint32_t *allocate(int w, int h);
+    // 分配自身持有的覆盖率存储 (初始为0) 并返回可写指针
+    uint8_t *allocateCoverage(int w, int h);
+    // 解码后调用一次: 生成游程表并更新 isOpaque; 覆盖率图像按覆盖率分段
+    void buildSpans();
+    // 生成 src 的水平镜像 (自身持有存储, 游程表重新生成)
+    void mirrorFrom(const CachedImage &src);
+
+    // 自身持有的堆内存 (像素+游程表), 指向资源包的图像为0
+    size_t heapBytes() const
+    {
+        size_t bytes = spanStorage.capacity() * sizeof(ImageSpan) + rowSpanStorage.capacity() * sizeof(uint32_t);
+        if (pixelStorage)
+            bytes += (size_t)width * height * sizeof(uint32_t);
+        if (coverageStorage)
+            bytes += (size_t)width * height;
+        return bytes;
+    }
+
+    bool hasSpans() const
+    {
+        return rowSpans != nullptr;
+    }
+    const ImageSpan *rowBegin(int y) const
+    {
+        return spans + rowSpans[y];
+    }
+    const ImageSpan *rowEnd(int y) const
+    {
+        return spans + rowSpans[y + 1];
+    }
+
+private:
+    std::unique_ptr<uint32_t[]> pixelStorage;
+    std::unique_ptr<uint8_t[]> coverageStorage;
+    std::vector<ImageSpan> spanStorage;
+    std::vector<uint32_t> rowSpanStorage;
+};
@@ -1,10 +1,10 @@
-﻿#include "Common.h"
-
-double GAME_SCALE = 1;
-int GAME_WIDTH = 640;
-int GAME_HEIGHT = 336;
-int GAME_OFFSET_X = 0;
-int GAME_OFFSET_Y = 0;
-int GAME_LINE = GAME_HEIGHT - 32;
-int WORLD_LEFT = 64;
+﻿#include "Common.h"
+
+double GAME_SCALE = 2;
+int GAME_WIDTH = 640;
+int GAME_HEIGHT = 336;
+int GAME_OFFSET_X = 0;
+int GAME_OFFSET_Y = 0;
+int GAME_LINE = GAME_HEIGHT - 32;
+int WORLD_LEFT = 64;
 int WORLD_RIGHT = 1920;
\ No newline at end of file
@@ -1,11 +1,11 @@
-﻿#pragma once
-
-// 声明全局变量（extern表示"这些变量在其他地方定义"）
-extern double GAME_SCALE;
-extern int GAME_WIDTH;
-extern int GAME_HEIGHT;
-extern int GAME_OFFSET_X;
-extern int GAME_OFFSET_Y;
-extern int GAME_LINE;
-extern int WORLD_LEFT;
-extern int WORLD_RIGHT;
+﻿#pragma once
+
+// 声明全局变量（extern表示"这些变量在其他地方定义"）
+extern double GAME_SCALE;
+extern int GAME_WIDTH;
+extern int GAME_HEIGHT;
+extern int GAME_OFFSET_X;
+extern int GAME_OFFSET_Y;
+extern int GAME_LINE;
+extern int WORLD_LEFT;
+extern int WORLD_RIGHT;
@@ -1,515 +1,1980 @@
-﻿#include "GDI.h"
-#define NOMINMAX
-
-#include <algorithm> // for std::max/min
-#include <cmath>     // for lround
-#include <shlwapi.h> // for SHCreateMemStream
-
-#pragma comment(lib, "Gdiplus.lib")
-#pragma comment(lib, "Msimg32.lib")
-#pragma comment(lib, "shlwapi.lib")
-
-// 使用 std 命名空间
-using std::max;
-using std::min;
-
-// ---------------------------------------------------------------------------
-// --- 静态成员初始化 ---
-// ---------------------------------------------------------------------------
-HWND GDI::hwnd = nullptr;
-ULONG_PTR GDI::gdiplusToken = 0;
-uint32_t *GDI::backPixels = nullptr;
-HBITMAP GDI::hBackBitmap = nullptr;
-HDC GDI::hBackDC = nullptr;
-BITMAPINFO GDI::backInfo = {};
-int GDI::backWidth = 0;
-int GDI::backHeight = 0;
-int GDI::cameraX = 0;
-int GDI::cameraY = 0;
-std::unordered_map<int, CachedImage> GDI::imageCache;
-std::unordered_map<float, HFONT> GDI::fontCache;
-
-// ---------------------------------------------------------------------------
-// --- 内部辅助函数 ---
-// ---------------------------------------------------------------------------
-namespace
-{
-    // 高效的32位预乘Alpha混合 (整数运算)
-    inline uint32_t AlphaBlendPixel_Premultiplied(uint32_t dest, uint32_t src)
-    {
-        uint32_t src_a = src >> 24;
-        if (src_a == 255)
-            return src;
-        if (src_a == 0)
-            return dest;
-
-        uint32_t inv_a = 255 - src_a;
-
-        // 分离 dest 的 R,B 和 G 通道
-        uint32_t dest_rb = dest & 0x00FF00FF;
-        uint32_t dest_g = dest & 0x0000FF00;
-
-        // dest = dest * (1 - src_a)
-        dest_rb = (dest_rb * inv_a) / 255;
-        dest_g = (dest_g * inv_a) / 255;
-
-        // 清理溢出位
-        dest_rb &= 0x00FF00FF;
-        dest_g &= 0x0000FF00;
-
-        // out = src(premultiplied) + dest(scaled)
-        return src + dest_rb + dest_g;
-    }
-}
-
-// ---------------------------------------------------------------------------
-// --- GDI 核心生命周期与底层实现 ---
-// ---------------------------------------------------------------------------
-
-void GDI::init(HWND h)
-{
-    hwnd = h;
-    Gdiplus::GdiplusStartupInput gdiplusStartupInput;
-    Gdiplus::GdiplusStartup(&gdiplusToken, &gdiplusStartupInput, NULL);
-
-    RECT rc;
-    GetClientRect(hwnd, &rc);
-    if (createBackBuffer(rc.right - rc.left, rc.bottom - rc.top))
-    {
-        SetBkMode(hBackDC, TRANSPARENT);
-    }
-}
-
-void GDI::end()
-{
-    for (auto const &[size, font] : fontCache)
-    {
-        DeleteObject(font);
-    }
-    fontCache.clear();
-    imageCache.clear();
-    destroyBackBuffer();
-
-    if (gdiplusToken)
-    {
-        Gdiplus::GdiplusShutdown(gdiplusToken);
-        gdiplusToken = 0;
-    }
-}
-
-void GDI::flush([[maybe_unused]] float dt)
-{
-    if (!hwnd)
-        return;
-    HDC hdc = GetDC(hwnd);
-    if (!hdc)
-        return;
-
-    if (hBackDC)
-    {
-        BitBlt(hdc, 0, 0, backWidth, backHeight, hBackDC, 0, 0, SRCCOPY);
-    }
-
-    ReleaseDC(hwnd, hdc);
-}
-
-// 文本绘制：这是一个性能权衡。
-// 立即模式下，每次调用都改变DC状态（字体/颜色）开销较大。
-// 为了极致性能，上层应用应自行将相同字体/颜色的文本绘制集中调用。
-// 此处为保证正确性，每次都完整设置并恢复状态。
-void GDI::text(const std::wstring &txt, int x, int y, float size, Gdiplus::Color color)
-{
-    if (!hBackDC || txt.empty())
-        return;
-
-    HFONT hf = getFont(size);
-    HFONT oldFont = (HFONT)SelectObject(hBackDC, hf);
-
-    COLORREF col = RGB(color.GetR(), color.GetG(), color.GetB());
-    COLORREF oldColor = SetTextColor(hBackDC, col);
-
-    ExtTextOutW(hBackDC, x - cameraX, y - cameraY, 0, nullptr, txt.c_str(), (int)txt.length(), nullptr);
-
-    SelectObject(hBackDC, oldFont);
-    SetTextColor(hBackDC, oldColor);
-}
-
-// 极致优化：使用SSE2指令集绘制矩形
-void GDI::drawRectFast(int x, int y, int w, int h, Gdiplus::Color color)
-{
-    // 1. 裁剪
-    int clipX1 = max(0, x);
-    int clipY1 = max(0, y);
-    int clipX2 = min(backWidth, x + w);
-    int clipY2 = min(backHeight, y + h);
-
-    int clippedW = clipX2 - clipX1;
-    if (clippedW <= 0 || clipY1 >= clipY2)
-        return;
-
-    // 2. 颜色转换 Gdiplus(ARGB) -> Buffer(BGRA)
-    uint32_t argb = color.GetValue();
-    uint8_t a = (argb >> 24);
-    uint8_t r = (argb >> 16);
-    uint8_t g = (argb >> 8);
-    uint8_t b = argb;
-    uint32_t bgraColor = (a << 24) | (b << 16) | (g << 8) | r;
-
-    uint32_t *destRowStart = backPixels + (clipY1 * backWidth) + clipX1;
-
-    // 3. 根据透明度选择不同路径
-    if (a == 255)
-    { // --- 不透明路径 (SSE2优化) ---
-        const __m128i color_s = _mm_set1_epi32(bgraColor);
-        for (int j = clipY1; j < clipY2; ++j)
-        {
-            uint32_t *p = destRowStart;
-            int count = clippedW;
-
-            // 内存对齐处理：先处理行首未对齐的几个像素
-            while ((reinterpret_cast<uintptr_t>(p) & 15) && count > 0)
-            {
-                *p++ = bgraColor;
-                count--;
-            }
-
-            // SSE2核心循环：一次处理4个像素
-            __m128i *p_s = reinterpret_cast<__m128i *>(p);
-            while (count >= 4)
-            {
-                _mm_store_si128(p_s++, color_s);
-                count -= 4;
-            }
-
-            // 处理行尾剩下的不足4个的像素
-            p = reinterpret_cast<uint32_t *>(p_s);
-            while (count > 0)
-            {
-                *p++ = bgraColor;
-                count--;
-            }
-            destRowStart += backWidth;
-        }
-    }
-    else if (a > 0)
-    { // --- Alpha混合路径 (逐像素) ---
-        // SIMD优化Alpha混合非常复杂，对于通用情况，逐像素仍是可靠方案
-        uint32_t pr = (r * a) / 255;
-        uint32_t pg = (g * a) / 255;
-        uint32_t pb = (b * a) / 255;
-        uint32_t srcPixel = (a << 24) | (pb << 16) | (pg << 8) | pr;
-
-        for (int j = clipY1; j < clipY2; ++j)
-        {
-            uint32_t *destPtr = destRowStart;
-            for (int i = 0; i < clippedW; ++i)
-            {
-                *destPtr = AlphaBlendPixel_Premultiplied(*destPtr, srcPixel);
-                destPtr++;
-            }
-            destRowStart += backWidth;
-        }
-    }
-}
-
-// 图像绘制 (基本保持原样，其瓶颈在于内存带宽和像素计算，已使用高效的定点数算法)
-void GDI::drawImageFast(int resId, int x, int y, int w, int h,
-                        bool flip, bool hasSrcRect, int srcX_in,
-                        int srcY_in, int srcW_in, int srcH_in)
-{
-    CachedImage *img = loadImage(resId);
-    if (!img)
-        return;
-
-    const int imgW = img->width;
-    const int imgH = img->height;
-
-    int srcW = hasSrcRect ? srcW_in : imgW;
-    int srcH = hasSrcRect ? srcH_in : imgH;
-    int srcX = hasSrcRect ? srcX_in : 0;
-    int srcY = hasSrcRect ? srcY_in : 0;
-
-    if (srcW <= 0 || srcH <= 0 || w <= 0 || h <= 0)
-        return;
-
-    int clipX1 = max(0, x);
-    int clipY1 = max(0, y);
-    int clipX2 = min(backWidth, x + w);
-    int clipY2 = min(backHeight, y + h);
-
-    if (clipX1 >= clipX2 || clipY1 >= clipY2)
-        return;
-
-    const int FRACT_BITS = 16;
-    const uint64_t FRACT_UNIT = 1ULL << FRACT_BITS;
-
-    uint64_t stepX_fixed = (static_cast<uint64_t>(srcW) * FRACT_UNIT) / w;
-    uint64_t stepY_fixed = (static_cast<uint64_t>(srcH) * FRACT_UNIT) / h;
-
-    uint64_t srcX_fixed_start = static_cast<uint64_t>(clipX1 - x) * stepX_fixed;
-    uint64_t srcY_fixed_start = static_cast<uint64_t>(clipY1 - y) * stepY_fixed;
-
-    uint32_t *destRow = backPixels + (clipY1 * backWidth) + clipX1;
-    uint64_t srcY_fixed = srcY_fixed_start;
-
-    for (int j = clipY1; j < clipY2; ++j)
-    {
-        int current_srcY = srcY + (srcY_fixed >> FRACT_BITS);
-
-        const uint32_t *srcRowBase = img->pixels.get() + min(imgH - 1, max(0, current_srcY)) * (size_t)imgW;
-        uint64_t srcX_fixed = srcX_fixed_start;
-        uint32_t *destPtr = destRow;
-
-        bool isOpaque = img->isOpaque;
-
-        if (isOpaque)
-        { // --- 不透明路径 ---
-            if (!flip)
-            {
-                // 优化: 1:1无缩放绘制，直接 memcpy
-                if (w == srcW && h == srcH)
-                {
-                    int srcStart = srcX + (srcX_fixed_start >> FRACT_BITS);
-                    memcpy(destPtr, srcRowBase + srcStart, (size_t)(clipX2 - clipX1) * 4);
-                }
-                else
-                {
-                    for (int i = clipX1; i < clipX2; ++i)
-                    {
-                        int sx = srcX + (srcX_fixed >> FRACT_BITS);
-                        *destPtr++ = srcRowBase[min(imgW - 1, max(0, sx))];
-                        srcX_fixed += stepX_fixed;
-                    }
-                }
-            }
-            else
-            { // flip
-                for (int i = clipX1; i < clipX2; ++i)
-                {
-                    int sx = srcX + srcW - 1 - (srcX_fixed >> FRACT_BITS);
-                    *destPtr++ = srcRowBase[min(imgW - 1, max(0, sx))];
-                    srcX_fixed += stepX_fixed;
-                }
-            }
-        }
-        else
-        { // --- Alpha混合路径 ---
-            if (!flip)
-            {
-                for (int i = clipX1; i < clipX2; ++i)
-                {
-                    int sx = srcX + (srcX_fixed >> FRACT_BITS);
-                    *destPtr = AlphaBlendPixel_Premultiplied(*destPtr, srcRowBase[min(imgW - 1, max(0, sx))]);
-                    destPtr++;
-                    srcX_fixed += stepX_fixed;
-                }
-            }
-            else
-            { // flip
-                for (int i = clipX1; i < clipX2; ++i)
-                {
-                    int sx = srcX + srcW - 1 - (srcX_fixed >> FRACT_BITS);
-                    *destPtr = AlphaBlendPixel_Premultiplied(*destPtr, srcRowBase[min(imgW - 1, max(0, sx))]);
-                    destPtr++;
-                    srcX_fixed += stepX_fixed;
-                }
-            }
-        }
-        destRow += backWidth;
-        srcY_fixed += stepY_fixed;
-    }
-}
-
-// (createBackBuffer, destroyBackBuffer, loadImage, getFont 函数与上一版基本相同，为简洁省略)
-// ... 粘贴上一版中这四个函数的实现即可 ...
-bool GDI::createBackBuffer(int w, int h)
-{
-    destroyBackBuffer();
-    if (w <= 0 || h <= 0)
-        return false;
-
-    backWidth = w;
-    backHeight = h;
-
-    ZeroMemory(&backInfo, sizeof(backInfo));
-    backInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    backInfo.bmiHeader.biWidth = w;
-    backInfo.bmiHeader.biHeight = -h; // top-down
-    backInfo.bmiHeader.biPlanes = 1;
-    backInfo.bmiHeader.biBitCount = 32;
-    backInfo.bmiHeader.biCompression = BI_RGB;
-
-    HDC hdc = GetDC(hwnd);
-    hBackBitmap = CreateDIBSection(hdc, &backInfo, DIB_RGB_COLORS, (void **)&backPixels, NULL, 0);
-    ReleaseDC(hwnd, hdc);
-
-    if (!hBackBitmap)
-    {
-        backPixels = nullptr;
-        return false;
-    }
-
-    hBackDC = CreateCompatibleDC(nullptr);
-    SelectObject(hBackDC, hBackBitmap);
-
-    return true;
-}
-
-void GDI::destroyBackBuffer()
-{
-    if (hBackDC)
-    {
-        DeleteDC(hBackDC);
-        hBackDC = nullptr;
-    }
-    if (hBackBitmap)
-    {
-        DeleteObject(hBackBitmap);
-        hBackBitmap = nullptr;
-    }
-    backPixels = nullptr;
-    backWidth = backHeight = 0;
-}
-
-CachedImage *GDI::loadImage(int resId)
-{
-    auto it = imageCache.find(resId);
-    if (it != imageCache.end())
-        return &it->second;
-
-    HMODULE hMod = GetModuleHandleW(NULL);
-    HRSRC hResInfo = FindResource(hMod, MAKEINTRESOURCE(resId), RT_RCDATA);
-    if (!hResInfo)
-        return nullptr;
-
-    DWORD resSize = SizeofResource(hMod, hResInfo);
-    HGLOBAL hResData = LoadResource(hMod, hResInfo);
-    if (!hResData || resSize == 0)
-        return nullptr;
-
-    void *pRes = LockResource(hResData);
-    if (!pRes)
-        return nullptr;
-
-    IStream *pStream = SHCreateMemStream((const BYTE *)pRes, resSize);
-    if (!pStream)
-        return nullptr;
-
-    std::unique_ptr<Gdiplus::Bitmap> bmp(Gdiplus::Bitmap::FromStream(pStream));
-    pStream->Release();
-
-    if (!bmp || bmp->GetLastStatus() != Gdiplus::Ok)
-        return nullptr;
-
-    int width = bmp->GetWidth();
-    int height = bmp->GetHeight();
-
-    CachedImage cached;
-    cached.width = width;
-    cached.height = height;
-    cached.pixels = std::make_unique<uint32_t[]>(width * height);
-    cached.isOpaque = true;
-
-    Gdiplus::BitmapData bmpData;
-    Gdiplus::Rect rect(0, 0, width, height);
-    if (bmp->LockBits(&rect, Gdiplus::ImageLockModeRead, PixelFormat32bppPARGB, &bmpData) != Gdiplus::Ok)
-    {
-        return nullptr;
-    }
-
-    const uint32_t *srcPixels = (const uint32_t *)bmpData.Scan0;
-    const int pixelCount = width * height;
-    uint32_t *destPixels = cached.pixels.get();
-    for (int i = 0; i < pixelCount; ++i)
-    {
-        uint32_t pixel = srcPixels[i];
-        if ((pixel >> 24) < 255)
-        {
-            cached.isOpaque = false;
-        }
-        destPixels[i] = pixel;
-    }
-
-    bmp->UnlockBits(&bmpData);
-
-    auto [iter, success] = imageCache.emplace(resId, std::move(cached));
-    return &iter->second;
-}
-
-HFONT GDI::getFont(float size)
-{
-    auto it = fontCache.find(size);
-    if (it != fontCache.end())
-        return it->second;
-
-    // 更精确地将点(Point)大小转换为逻辑像素大小
-    LOGFONTW lf = {0};
-    HDC hdc = GetDC(hwnd);
-    lf.lfHeight = -MulDiv(static_cast<int>(round(size)), GetDeviceCaps(hdc, LOGPIXELSY), 72);
-    ReleaseDC(hwnd, hdc);
-
-    lf.lfWeight = FW_NORMAL;
-    wcscpy_s(lf.lfFaceName, LF_FACESIZE, L"Arial");
-    HFONT hf = CreateFontIndirectW(&lf);
-
-    fontCache[size] = hf;
-    return hf;
-}
-
-/**
- * @brief 专用于绘制静态图的底层函数（1:1绘制，无翻转，无视相机）
- *
- * 通过特化逻辑，为不透明图像启用逐行memcpy，性能远高于通用绘制函数。
- */
-void GDI::drawImageStaticFast(int resId, int x, int y)
-{
-    // 1. 加载图像资源
-    CachedImage *img = loadImage(resId);
-    if (!img)
-        return;
-
-    const int imgW = img->width;
-    const int imgH = img->height;
-
-    // 2. 屏幕空间裁剪
-    const int clipX1 = max(0, x);
-    const int clipY1 = max(0, y);
-    const int clipX2 = min(backWidth, x + imgW);
-    const int clipY2 = min(backHeight, y + imgH);
-
-    // 计算裁剪后的有效宽度，如果屏幕上不可见则提前退出
-    const int clippedW = clipX2 - clipX1;
-    if (clippedW <= 0 || clipY1 >= clipY2)
-    {
-        return;
-    }
-
-    // 3. 计算图像源的起始读取位置
-    // 因为是1:1绘制，所以源坐标的偏移就等于裁剪区域的左上角与原始绘制位置的差值
-    const int srcX_start = clipX1 - x;
-    const int srcY_start = clipY1 - y;
-
-    // 4. 逐行绘制
-    for (int j = clipY1; j < clipY2; ++j)
-    {
-        // 计算目标行和源行的起始指针
-        uint32_t *destPtr = backPixels + (size_t)j * backWidth + clipX1;
-        const uint32_t *srcPtr = img->pixels.get() + (size_t)(srcY_start + (j - clipY1)) * imgW + srcX_start;
-
-        // 5. 根据不透明属性选择最高效的路径
-        if (img->isOpaque)
-        {
-            // 优化核心：对于不透明图像，直接内存复制整行像素
-            memcpy(destPtr, srcPtr, (size_t)clippedW * sizeof(uint32_t));
-        }
-        else
-        {
-            // 对于带Alpha通道的图像，逐像素进行混合
-            for (int i = 0; i < clippedW; ++i)
-            {
-                // AlphaBlendPixel_Premultiplied 函数已在您的代码中定义
-                destPtr[i] = AlphaBlendPixel_Premultiplied(destPtr[i], srcPtr[i]);
-            }
-        }
-    }
+﻿#include "GDI.h"
+#define NOMINMAX
+
+#include "Blend.h"
+
+#include <algorithm> // for std::max/min
+#include <cmath>     // for lround
+#include <chrono>
+#include <bit>
+#include <cstdarg>
+#include <cwchar>
+#include <shlwapi.h> // for SHCreateMemStream
+
+#pragma comment(lib, "Gdiplus.lib")
+#pragma comment(lib, "Msimg32.lib")
+#pragma comment(lib, "shlwapi.lib")
+
+// 使用 std 命名空间
+using std::max;
+using std::min;
+
+// ---------------------------------------------------------------------------
+// --- 静态成员初始化 ---
+// ---------------------------------------------------------------------------
+HWND GDI::hwnd = nullptr;
+ULONG_PTR GDI::gdiplusToken = 0;
+uint32_t *GDI::backPixels = nullptr;
+HBITMAP GDI::hBackBitmap = nullptr;
+HDC GDI::hBackDC = nullptr;
+BITMAPINFO GDI::backInfo = {};
+int GDI::backWidth = 0;
+int GDI::backHeight = 0;
+int GDI::logicalWidth = 0;
+int GDI::logicalHeight = 0;
+int GDI::outputWidth = 0;
+int GDI::outputHeight = 0;
+float GDI::curRenderScale = 1.0f;
+uint32_t *GDI::presentPixels = nullptr;
+HBITMAP GDI::hPresentBitmap = nullptr;
+HDC GDI::hPresentDC = nullptr;
+std::vector<uint32_t> GDI::presentCols;
+std::vector<uint32_t> GDI::presentRows;
+int GDI::presentFactor = 0;
+bool GDI::governorEnabled = false;
+float GDI::governorBudgetMs = 1000.0f / 60.0f;
+float GDI::governorMinScale = 0.5f;
+float GDI::frameMsAvg = 0;
+int GDI::governorCooldown = 0;
+int GDI::cameraX = 0;
+int GDI::cameraY = 0;
+std::unordered_map<int, ImageEntry> GDI::imageCache;
+SpritePack GDI::spritePack;
+std::string GDI::resDir;
+int GDI::nextImageKey = -65536;
+TextAtlas GDI::textAtlas;
+std::unique_ptr<ThreadPool> GDI::loadPool;
+std::mutex GDI::loadMutex;
+std::condition_variable GDI::loadCv;
+MissingImagePolicy GDI::missingPolicy = MissingImagePolicy::Skip;
+LoadStats GDI::loaderStats;
+bool GDI::frameStalled = false;
+bool GDI::frameMissed = false;
+uint64_t GDI::frameIndex = 1;
+ImageCacheStats GDI::cacheStats;
+std::unordered_set<int> GDI::evictedImages;
+bool GDI::mirrorImages = true;
+std::unordered_map<ScaledImageKey, ScaledImageEntry, ScaledImageKeyHash> GDI::scaledCache;
+ScaledCacheStats GDI::scaledStats;
+int GDI::loadsInFlight = 0;
+std::vector<int> GDI::finishedLoads;
+std::unordered_map<float, HFONT> GDI::fontCache;
+std::vector<DrawCmd> GDI::cmds;
+std::vector<uint64_t> GDI::sortKeys;
+std::vector<uint64_t> GDI::sortTmp;
+int GDI::curLayer = 0;
+bool GDI::curYSort = false;
+std::unique_ptr<ThreadPool> GDI::rasterPool;
+int GDI::tileCols = 0;
+int GDI::tileRows = 0;
+std::vector<std::vector<uint32_t>> GDI::tileBins;
+RenderStats GDI::renderStats;
+std::vector<uint64_t> GDI::tileHash;
+std::vector<uint64_t> GDI::prevTileHash;
+std::vector<uint8_t> GDI::tileDirty;
+std::vector<uint8_t> GDI::tileCovered;
+std::vector<std::vector<RECT>> GDI::tileClips;
+std::vector<uint64_t> GDI::tileDrawnPixels;
+std::vector<uint64_t> GDI::tileCulledPixels;
+bool GDI::fullRedraw = true;
+
+// ---------------------------------------------------------------------------
+// --- 内部辅助函数 ---
+// ---------------------------------------------------------------------------
+namespace
+{
+    // 缩放/翻转时先把采样结果收集到栈上的临时行, 再交给SIMD行混合内核
+    constexpr int BLEND_CHUNK = 256;
+
+    // 64位键的LSD基数排序, 每趟8位; 所有键在某一字节上相同时跳过该趟
+    // (层号和排序y大多相同, 通常只需要排提交序号所在的低位字节)
+    void radixSort(std::vector<uint64_t> &keys, std::vector<uint64_t> &tmp)
+    {
+        const size_t n = keys.size();
+        if (n < 2)
+            return;
+        tmp.resize(n);
+
+        uint32_t counts[8][256] = {};
+        for (uint64_t k : keys)
+        {
+            for (int pass = 0; pass < 8; ++pass)
+            {
+                counts[pass][(k >> (pass * 8)) & 0xFF]++;
+            }
+        }
+
+        uint64_t *src = keys.data();
+        uint64_t *dst = tmp.data();
+        for (int pass = 0; pass < 8; ++pass)
+        {
+            uint32_t *c = counts[pass];
+            if (c[(src[0] >> (pass * 8)) & 0xFF] == n)
+                continue;
+
+            uint32_t offsets[256];
+            uint32_t sum = 0;
+            for (int i = 0; i < 256; ++i)
+            {
+                offsets[i] = sum;
+                sum += c[i];
+            }
+            for (size_t i = 0; i < n; ++i)
+            {
+                uint64_t k = src[i];
+                dst[offsets[(k >> (pass * 8)) & 0xFF]++] = k;
+            }
+            std::swap(src, dst);
+        }
+        if (src != keys.data())
+        {
+            memcpy(keys.data(), src, n * sizeof(uint64_t));
+        }
+    }
+
+    // 命令内容哈希, 用于判断分块内容是否变化
+    inline uint64_t hashMix(uint64_t h, uint64_t v)
+    {
+        h ^= v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+        return h * 0xFF51AFD7ED558CCDULL;
+    }
+
+    // 定点数采样精度
+    constexpr int FRACT_BITS = 16;
+    constexpr uint64_t FRACT_UNIT = 1ULL << FRACT_BITS;
+
+    // 按游程表绘制一行: 跳过透明段, 不透明段直接复制, 只混合半透明段
+    // dest/count 为裁剪后的目标行; 第k个目标像素采样源局部列 u = ((off + k) * step) >> FRACT_BITS,
+    // 翻转时源列为 srcX + srcW - 1 - u, 否则为 srcX + u。调用方保证源矩形位于图像内。
+    void drawSpanRow(uint32_t *dest, int count, const CachedImage *img, int sy,
+                     int srcX, int srcW, int off, uint64_t step, bool flip)
+    {
+        const uint32_t *srcRow = img->pixels + (size_t)sy * img->width;
+        const bool unit = step == FRACT_UNIT;
+
+        // 源局部列 >= u 的第一个目标下标
+        auto firstDest = [&](int u) -> int
+        {
+            int64_t k = unit ? u : static_cast<int64_t>((static_cast<uint64_t>(u) * FRACT_UNIT + step - 1) / step);
+            return static_cast<int>(std::clamp<int64_t>(k - off, 0, count));
+        };
+
+        for (const ImageSpan *sp = img->rowBegin(sy), *spEnd = img->rowEnd(sy); sp != spEnd; ++sp)
+        {
+            const int a = max<int>(sp->x, srcX);
+            const int b = min<int>(sp->x + sp->len, srcX + srcW);
+            if (a >= b)
+                continue;
+
+            // 源列 [a, b) 对应的目标区间 [k0, k1)
+            const int k0 = flip ? firstDest(srcX + srcW - b) : firstDest(a - srcX);
+            const int k1 = flip ? firstDest(srcX + srcW - a) : firstDest(b - srcX);
+            if (k0 >= k1)
+                continue;
+
+            if (unit && !flip)
+            { // 1:1 源像素连续
+                const uint32_t *s = srcRow + srcX + off + k0;
+                if (sp->type == SpanType::Opaque)
+                    memcpy(dest + k0, s, (size_t)(k1 - k0) * 4);
+                else
+                    Blend::row(dest + k0, s, k1 - k0);
+                continue;
+            }
+
+            // 缩放或翻转: 定点数采样
+            uint64_t fx = static_cast<uint64_t>(off + k0) * step;
+            if (sp->type == SpanType::Opaque)
+            {
+                for (int k = k0; k < k1; ++k)
+                {
+                    int u = static_cast<int>(fx >> FRACT_BITS);
+                    dest[k] = srcRow[flip ? srcX + srcW - 1 - u : srcX + u];
+                    fx += step;
+                }
+                continue;
+            }
+            uint32_t chunk[BLEND_CHUNK];
+            for (int k = k0; k < k1; k += BLEND_CHUNK)
+            {
+                const int n = min(BLEND_CHUNK, k1 - k);
+                for (int i = 0; i < n; ++i)
+                {
+                    int u = static_cast<int>(fx >> FRACT_BITS);
+                    chunk[i] = srcRow[flip ? srcX + srcW - 1 - u : srcX + u];
+                    fx += step;
+                }
+                Blend::row(dest + k, chunk, n);
+            }
+        }
+    }
+
+    // 颜色 rgb (0x00RRGGBB) 乘覆盖率 a, 得到预乘Alpha的BGRA
+    inline uint32_t shade(uint32_t rgb, uint32_t a)
+    {
+        const uint32_t r = (rgb >> 16) & 0xFF, g = (rgb >> 8) & 0xFF, b = rgb & 0xFF;
+        return (a << 24) | (((r * a + 127) / 255) << 16) | (((g * a + 127) / 255) << 8) | ((b * a + 127) / 255);
+    }
+
+    // 按游程表绘制覆盖率图像 (字形图集页) 的一行: 不透明段直接填颜色, 半透明段乘上颜色后混合
+    // 采样映射与 drawSpanRow 相同 (字形不翻转), 调用方保证源矩形位于图像内
+    void drawCoverageRow(uint32_t *dest, int count, const CachedImage *img, int sy,
+                         int srcX, int srcW, int off, uint64_t step, uint32_t rgb)
+    {
+        const uint8_t *srcRow = img->coverage + (size_t)sy * img->width;
+        const bool unit = step == FRACT_UNIT;
+        const uint32_t solid = 0xFF000000 | rgb;
+
+        auto firstDest = [&](int u) -> int
+        {
+            int64_t k = unit ? u : static_cast<int64_t>((static_cast<uint64_t>(u) * FRACT_UNIT + step - 1) / step);
+            return static_cast<int>(std::clamp<int64_t>(k - off, 0, count));
+        };
+
+        for (const ImageSpan *sp = img->rowBegin(sy), *spEnd = img->rowEnd(sy); sp != spEnd; ++sp)
+        {
+            const int a = max<int>(sp->x, srcX);
+            const int b = min<int>(sp->x + sp->len, srcX + srcW);
+            if (a >= b)
+                continue;
+            const int k0 = firstDest(a - srcX);
+            const int k1 = firstDest(b - srcX);
+            if (k0 >= k1)
+                continue;
+
+            if (sp->type == SpanType::Opaque)
+            {
+                std::fill(dest + k0, dest + k1, solid);
+                continue;
+            }
+            uint64_t fx = static_cast<uint64_t>(off + k0) * step;
+            uint32_t chunk[BLEND_CHUNK];
+            for (int k = k0; k < k1; k += BLEND_CHUNK)
+            {
+                const int n = min(BLEND_CHUNK, k1 - k);
+                for (int i = 0; i < n; ++i)
+                {
+                    chunk[i] = shade(rgb, srcRow[srcX + static_cast<int>(fx >> FRACT_BITS)]);
+                    fx += step;
+                }
+                Blend::row(dest + k, chunk, n);
+            }
+        }
+    }
+
+    // 分块局部列 [a, b) 的掩码
+    inline uint64_t coverBits(int a, int b)
+    {
+        const uint64_t hi = b >= 64 ? ~0ULL : (1ULL << b) - 1;
+        const uint64_t lo = (1ULL << a) - 1;
+        return hi & ~lo;
+    }
+
+    // 与 drawSpanRow 相同的映射下, 第 sy 行不透明游程覆盖的目标列掩码
+    // originX 为图像目标左边在分块局部的列, 结果限制在 [x1, x2)
+    uint64_t coverSpanRow(const CachedImage *img, int sy, int srcX, int srcW, uint64_t step, bool flip,
+                          int originX, int x1, int x2)
+    {
+        const bool unit = step == FRACT_UNIT;
+        auto firstDest = [&](int u) -> int64_t
+        {
+            return originX + (unit ? u : static_cast<int64_t>((static_cast<uint64_t>(u) * FRACT_UNIT + step - 1) / step));
+        };
+
+        uint64_t bits = 0;
+        for (const ImageSpan *sp = img->rowBegin(sy), *spEnd = img->rowEnd(sy); sp != spEnd; ++sp)
+        {
+            if (sp->type != SpanType::Opaque)
+                continue;
+            const int a = max<int>(sp->x, srcX);
+            const int b = min<int>(sp->x + sp->len, srcX + srcW);
+            if (a >= b)
+                continue;
+            const int64_t k0 = std::max<int64_t>(x1, flip ? firstDest(srcX + srcW - b) : firstDest(a - srcX));
+            const int64_t k1 = std::min<int64_t>(x2, flip ? firstDest(srcX + srcW - a) : firstDest(b - srcX));
+            if (k0 < k1)
+                bits |= coverBits(static_cast<int>(k0), static_cast<int>(k1));
+        }
+        return bits;
+    }
+
+    // v * num / den 向下取整 (v 可为负), 用于内部分辨率坐标到渲染分辨率坐标的换算
+    inline int scaleFloor(int v, int num, int den)
+    {
+        const int64_t p = static_cast<int64_t>(v) * num;
+        return static_cast<int>(p >= 0 ? p / den : -((-p + den - 1) / den));
+    }
+
+    // 整数倍最近邻放大一行: 每个源像素重复2次/4次, SSE2 解包后整块写出
+    void upscaleRow2x(uint32_t *dest, const uint32_t *src, int count)
+    {
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + 2 * i), _mm_unpacklo_epi32(v, v));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + 2 * i + 4), _mm_unpackhi_epi32(v, v));
+        }
+        for (; i < count; ++i)
+        {
+            dest[2 * i] = dest[2 * i + 1] = src[i];
+        }
+    }
+
+    void upscaleRow4x(uint32_t *dest, const uint32_t *src, int count)
+    {
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            const __m128i lo = _mm_unpacklo_epi32(v, v); // a a b b
+            const __m128i hi = _mm_unpackhi_epi32(v, v); // c c d d
+            __m128i *d = reinterpret_cast<__m128i *>(dest + 4 * i);
+            _mm_storeu_si128(d, _mm_unpacklo_epi64(lo, lo));
+            _mm_storeu_si128(d + 1, _mm_unpackhi_epi64(lo, lo));
+            _mm_storeu_si128(d + 2, _mm_unpacklo_epi64(hi, hi));
+            _mm_storeu_si128(d + 3, _mm_unpackhi_epi64(hi, hi));
+        }
+        for (; i < count; ++i)
+        {
+            dest[4 * i] = dest[4 * i + 1] = dest[4 * i + 2] = dest[4 * i + 3] = src[i];
+        }
+    }
+
+    // 通用图像绘制 (无游程表时) 的参数, 由 drawImageFast 裁剪后填好
+    struct BlitArgs
+    {
+        uint32_t *dest; // 裁剪后目标矩形的左上角
+        int destStride;
+        int width;  // 裁剪后目标宽高
+        int height;
+        const CachedImage *img;
+        int srcX;
+        int srcW;
+        int off;        // 目标左边被裁掉的列数
+        uint64_t stepX; // 定点数步长
+        int srcY;
+        uint64_t srcYFixed; // 第一行对应的源行定点坐标 (相对 srcY)
+        uint64_t stepY;
+    };
+
+    // 生成列索引表: 第k个目标列 (从第 first 列算起) 采样的源列, 已钳位到图像内
+    // 每次绘制每个列块只算一次, 各行复用; 不缩放时 u 就是列号, 省去定点乘法
+    template <bool Flip, bool Scaled>
+    void buildColumns(uint32_t *cols, int n, int first, const BlitArgs &a)
+    {
+        const int last = a.img->width - 1;
+        for (int k = 0; k < n; ++k)
+        {
+            int u;
+            if constexpr (Scaled)
+                u = static_cast<int>((static_cast<uint64_t>(a.off + first + k) * a.stepX) >> FRACT_BITS);
+            else
+                u = a.off + first + k;
+            const int sx = Flip ? a.srcX + a.srcW - 1 - u : a.srcX + u;
+            cols[k] = static_cast<uint32_t>(std::clamp(sx, 0, last));
+        }
+    }
+
+    // 通用图像绘制的编译期特化, 每次绘制按 (不透明, 翻转, 缩放) 查表选一次
+    // 不翻转不缩放时源行连续, 直接整行复制/混合 (调用方保证源列在图像内);
+    // 其余情况先生成列索引表, 内层循环只剩无分支的按表取像素
+    template <bool Opaque, bool Flip, bool Scaled>
+    void blitImage(const BlitArgs &a)
+    {
+        const CachedImage *img = a.img;
+        const int lastRow = img->height - 1;
+        auto srcRow = [&](uint64_t syFixed) -> const uint32_t *
+        {
+            const int sy = std::clamp(a.srcY + static_cast<int>(syFixed >> FRACT_BITS), 0, lastRow);
+            return img->pixels + (size_t)sy * img->width;
+        };
+
+        if constexpr (!Flip && !Scaled)
+        {
+            const int srcStart = a.srcX + a.off;
+            uint32_t *dest = a.dest;
+            uint64_t syFixed = a.srcYFixed;
+            for (int j = 0; j < a.height; ++j)
+            {
+                const uint32_t *src = srcRow(syFixed) + srcStart;
+                if constexpr (Opaque)
+                    memcpy(dest, src, (size_t)a.width * 4);
+                else
+                    Blend::row(dest, src, a.width);
+                dest += a.destStride;
+                syFixed += a.stepY;
+            }
+        }
+        else
+        {
+            uint32_t cols[BLEND_CHUNK];
+            for (int first = 0; first < a.width; first += BLEND_CHUNK)
+            {
+                const int n = min(BLEND_CHUNK, a.width - first);
+                buildColumns<Flip, Scaled>(cols, n, first, a);
+                uint32_t *dest = a.dest + first;
+                uint64_t syFixed = a.srcYFixed;
+                for (int j = 0; j < a.height; ++j)
+                {
+                    const uint32_t *src = srcRow(syFixed);
+                    if constexpr (Opaque)
+                    {
+                        for (int k = 0; k < n; ++k)
+                        {
+                            dest[k] = src[cols[k]];
+                        }
+                    }
+                    else
+                    {
+                        uint32_t chunk[BLEND_CHUNK];
+                        for (int k = 0; k < n; ++k)
+                        {
+                            chunk[k] = src[cols[k]];
+                        }
+                        Blend::row(dest, chunk, n);
+                    }
+                    dest += a.destStride;
+                    syFixed += a.stepY;
+                }
+            }
+        }
+    }
+
+    using BlitFn = void (*)(const BlitArgs &);
+    // 下标依次为 [Opaque][Flip][Scaled]
+    constexpr BlitFn BLIT_KERNELS[2][2][2] = {
+        {{blitImage<false, false, false>, blitImage<false, false, true>},
+         {blitImage<false, true, false>, blitImage<false, true, true>}},
+        {{blitImage<true, false, false>, blitImage<true, false, true>},
+         {blitImage<true, true, false>, blitImage<true, true, true>}},
+    };
+}
+
+// ---------------------------------------------------------------------------
+// --- GDI 核心生命周期与底层实现 ---
+// ---------------------------------------------------------------------------
+
+void GDI::init(HWND h, int width, int height)
+{
+    hwnd = h;
+    // 按CPU特性选择一次混合内核
+    Blend::init();
+    Gdiplus::GdiplusStartupInput gdiplusStartupInput;
+    Gdiplus::GdiplusStartup(&gdiplusToken, &gdiplusStartupInput, NULL);
+
+    RECT rc;
+    GetClientRect(hwnd, &rc);
+    outputWidth = rc.right - rc.left;
+    outputHeight = rc.bottom - rc.top;
+    logicalWidth = width > 0 ? width : outputWidth;
+    logicalHeight = height > 0 ? height : outputHeight;
+    curRenderScale = 1.0f;
+    if (createBackBuffer(logicalWidth, logicalHeight))
+    {
+        SetBkMode(hBackDC, TRANSPARENT);
+    }
+    updatePresentBuffer();
+    if (!rasterPool)
+    {
+        setThreadCount(0);
+    }
+    // 一个后台加载线程负责解码, 不和光栅化共用线程池, 避免长时间解码拖住光栅化批次
+    if (!loadPool)
+    {
+        loadPool = std::make_unique<ThreadPool>(2);
+    }
+
+    // 资源包放在 exe 同目录的 res/ 下, 没有则运行时解码
+    if (resDir.empty())
+    {
+        wchar_t exePath[MAX_PATH];
+        DWORD len = GetModuleFileNameW(NULL, exePath, MAX_PATH);
+        if (len > 0 && len < MAX_PATH)
+        {
+            PathRemoveFileSpecW(exePath);
+            char utf8[MAX_PATH * 3];
+            if (WideCharToMultiByte(CP_UTF8, 0, exePath, -1, utf8, sizeof(utf8), nullptr, nullptr) > 0)
+                resDir = std::string(utf8) + "\\res";
+        }
+    }
+    if (!spritePack.isOpen() && !resDir.empty())
+        openSpritePack(resDir + "\\sprites.pak");
+}
+
+bool GDI::openSpritePack(const std::string &path)
+{
+    // 已绑定到旧资源包的图像随之失效
+    for (auto it = imageCache.begin(); it != imageCache.end();)
+    {
+        if (const SpritePackEntry *packed = spritePack.isOpen() ? spritePack.find(it->first) : nullptr)
+        {
+            cacheStats.mappedBytes -= (size_t)packed->width * packed->height * 4;
+            releaseMirror(it->second);
+            it = imageCache.erase(it);
+        }
+        else
+            ++it;
+    }
+    return spritePack.open(path);
+}
+
+void GDI::end()
+{
+    for (auto const &[size, font] : fontCache)
+    {
+        DeleteObject(font);
+    }
+    fontCache.clear();
+    textAtlas.clear();
+    // 先停掉加载线程 (正在解码的那张会先写完), 再释放图像
+    loadPool.reset();
+    imageCache.clear();
+    evictedImages.clear();
+    finishedLoads.clear();
+    loadsInFlight = 0;
+    cacheStats.residentBytes = 0;
+    cacheStats.mappedBytes = 0;
+    cacheStats.mirroredBytes = 0;
+    cacheStats.mirrored = 0;
+    scaledCache.clear();
+    scaledStats.bytes = 0;
+    scaledStats.entries = 0;
+    spritePack.close();
+    destroyPresentBuffer();
+    destroyBackBuffer();
+    rasterPool.reset();
+
+    if (gdiplusToken)
+    {
+        Gdiplus::GdiplusShutdown(gdiplusToken);
+        gdiplusToken = 0;
+    }
+}
+
+void GDI::flush([[maybe_unused]] float dt)
+{
+    if (!hwnd)
+        return;
+
+    auto rasterStart = std::chrono::steady_clock::now();
+
+    // 1. 按 layer / 排序y / 提交序号 排序
+    sortKeys.clear();
+    sortKeys.reserve(cmds.size());
+    for (size_t i = 0; i < cmds.size(); ++i)
+    {
+        const DrawCmd &cmd = cmds[i];
+        uint64_t layerKey = static_cast<uint64_t>(cmd.layer + 128) & 0xFF;
+        uint64_t yKey = static_cast<uint64_t>(std::clamp(cmd.sortY + (1 << 23), 0, (1 << 24) - 1));
+        sortKeys.push_back((layerKey << 56) | (yKey << 32) | i);
+    }
+    radixSort(sortKeys, sortTmp);
+
+    // 2. 分块并找出脏分块
+    renderStats.commands = static_cast<int>(cmds.size());
+    renderStats.threads = threadCount();
+    binCommands();
+
+    // 3. 分块光栅化 (文本已展开为字形图集上的字形命令, 先补齐新字形所在页的游程表)
+    textAtlas.commit();
+    rasterize();
+
+    renderStats.rasterMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - rasterStart).count();
+
+    // 4. 只提交脏分块
+    present();
+
+    collectLoads();
+    evictImages();
+    evictScaled();
+    governResolution(dt);
+    frameIndex++;
+    if (frameStalled)
+        loaderStats.stallFrames++;
+    if (frameMissed)
+        loaderStats.missFrames++;
+    frameStalled = false;
+    frameMissed = false;
+
+    prevTileHash.swap(tileHash);
+    fullRedraw = false;
+}
+
+// 把排序后的命令按目标矩形分到屏幕分块 (分块里存排序后的位置), 计算各分块的内容哈希并标记脏分块
+void GDI::binCommands()
+{
+    const int tileCount = tileCols * tileRows;
+    for (auto &bin : tileBins)
+    {
+        bin.clear();
+    }
+    std::fill(tileHash.begin(), tileHash.end(), 0);
+    renderStats.binned = 0;
+
+    for (size_t i = 0; i < sortKeys.size(); ++i)
+    {
+        const DrawCmd &cmd = cmds[static_cast<uint32_t>(sortKeys[i])];
+
+        uint64_t h = hashMix(static_cast<uint64_t>(cmd.type), static_cast<uint64_t>(cmd.resId));
+        h = hashMix(h, reinterpret_cast<uintptr_t>(cmd.img));
+        h = hashMix(h, (static_cast<uint64_t>(static_cast<uint32_t>(cmd.x)) << 32) | static_cast<uint32_t>(cmd.y));
+        h = hashMix(h, (static_cast<uint64_t>(static_cast<uint32_t>(cmd.w)) << 32) | static_cast<uint32_t>(cmd.h));
+        h = hashMix(h, (static_cast<uint64_t>(static_cast<uint32_t>(cmd.srcX)) << 32) | static_cast<uint32_t>(cmd.srcY));
+        h = hashMix(h, (static_cast<uint64_t>(static_cast<uint32_t>(cmd.srcW)) << 32) | static_cast<uint32_t>(cmd.srcH));
+        h = hashMix(h, (static_cast<uint64_t>(cmd.color) << 2) | (cmd.flip ? 2 : 0) | (cmd.hasSrcRect ? 1 : 0));
+
+        int x1, y1, x2, y2;
+        if (!tileRange(cmd, x1, y1, x2, y2))
+            continue;
+
+        for (int ty = y1; ty <= y2; ++ty)
+        {
+            for (int tx = x1; tx <= x2; ++tx)
+            {
+                const int tile = ty * tileCols + tx;
+                tileBins[tile].push_back(static_cast<uint32_t>(i));
+                tileHash[tile] = hashMix(tileHash[tile], h);
+                renderStats.binned++;
+            }
+        }
+    }
+    for (int t = 0; t < tileCount; ++t)
+    {
+        tileDirty[t] = fullRedraw || tileHash[t] != prevTileHash[t];
+    }
+
+    renderStats.dirtyTiles = 0;
+    for (int t = 0; t < tileCount; ++t)
+    {
+        renderStats.dirtyTiles += tileDirty[t];
+    }
+}
+
+// 命令覆盖的分块范围 [x1, x2] x [y1, y2], 不在屏幕内返回 false
+bool GDI::tileRange(const DrawCmd &cmd, int &x1, int &y1, int &x2, int &y2)
+{
+    int left = max(0, cmd.x);
+    int top = max(0, cmd.y);
+    int right = min(backWidth, cmd.x + cmd.w);
+    int bottom = min(backHeight, cmd.y + cmd.h);
+    if (left >= right || top >= bottom)
+        return false;
+    x1 = left / TILE_SIZE;
+    y1 = top / TILE_SIZE;
+    x2 = (right - 1) / TILE_SIZE;
+    y2 = (bottom - 1) / TILE_SIZE;
+    return true;
+}
+
+// 并行光栅化全部排序后的命令; 只处理脏分块, 先做遮挡剔除, 需要时再清屏
+void GDI::rasterize()
+{
+    // 每个分块只由一个线程写, 分块内按命令顺序合成, 输出与整屏顺序绘制一致
+    rasterPool->parallelFor(tileCols * tileRows, [](int tile)
+                            {
+        if (!tileDirty[tile])
+            return;
+        int tx = tile % tileCols;
+        int ty = tile / tileCols;
+        RECT clip;
+        clip.left = tx * TILE_SIZE;
+        clip.top = ty * TILE_SIZE;
+        clip.right = min(backWidth, (tx + 1) * TILE_SIZE);
+        clip.bottom = min(backHeight, (ty + 1) * TILE_SIZE);
+
+        cullTile(tile, clip);
+
+        if (!tileCovered[tile])
+        {
+            const size_t rowBytes = (size_t)(clip.right - clip.left) * 4;
+            for (int y = clip.top; y < clip.bottom; ++y)
+            {
+                memset(backPixels + (size_t)y * backWidth + clip.left, 0, rowBytes);
+            }
+        }
+
+        const auto &bin = tileBins[tile];
+        const auto &clips = tileClips[tile];
+        for (size_t n = 0; n < bin.size(); ++n)
+        {
+            const RECT &cmdClip = clips[n];
+            if (cmdClip.left < cmdClip.right)
+            {
+                const DrawCmd &cmd = cmds[static_cast<uint32_t>(sortKeys[bin[n]])];
+                execute(cmd, cmdClip);
+            }
+        } });
+}
+
+// 遮挡剔除: 从前往后(按绘制顺序倒序)累积每行被不透明像素覆盖的列掩码,
+// 每条命令的裁剪矩形收缩到其未被覆盖部分的包围盒, 完全被覆盖的命令直接丢弃。
+// 被收缩掉的像素之后一定会被不透明像素整体覆盖, 输出与不剔除时一致。
+void GDI::cullTile(int tile, const RECT &clip)
+{
+    const int tileW = clip.right - clip.left;
+    const int tileH = clip.bottom - clip.top;
+    uint64_t covered[TILE_SIZE] = {};
+
+    const auto &bin = tileBins[tile];
+    auto &clips = tileClips[tile];
+    clips.resize(bin.size());
+
+    uint64_t drawn = 0;
+    uint64_t culled = 0;
+    for (size_t n = bin.size(); n-- > 0;)
+    {
+        const DrawCmd &cmd = cmds[static_cast<uint32_t>(sortKeys[bin[n]])];
+        RECT &r = clips[n];
+        r = clip;
+
+        // 命令在分块内的目标矩形 (分块局部坐标)
+        int x1 = max<int>(cmd.x - clip.left, 0);
+        int y1 = max<int>(cmd.y - clip.top, 0);
+        int x2 = min<int>(cmd.x + cmd.w - clip.left, tileW);
+        int y2 = min<int>(cmd.y + cmd.h - clip.top, tileH);
+        if (x1 >= x2 || y1 >= y2)
+        {
+            r.right = r.left;
+            continue;
+        }
+
+        // 未覆盖部分的包围盒
+        const uint64_t cols = coverBits(x1, x2);
+        uint64_t open = 0;
+        int top = -1, bottom = -1;
+        for (int j = y1; j < y2; ++j)
+        {
+            const uint64_t rowOpen = cols & ~covered[j];
+            if (rowOpen)
+            {
+                if (top < 0)
+                    top = j;
+                bottom = j + 1;
+                open |= rowOpen;
+            }
+        }
+        if (!open)
+        {
+            r.right = r.left;
+            culled += (uint64_t)(x2 - x1) * (y2 - y1);
+            continue;
+        }
+        const int left = std::countr_zero(open);
+        const int right = 64 - std::countl_zero(open);
+        r.left = clip.left + left;
+        r.top = clip.top + top;
+        r.right = clip.left + right;
+        r.bottom = clip.top + bottom;
+        drawn += (uint64_t)(right - left) * (bottom - top);
+        culled += (uint64_t)(x2 - x1) * (y2 - y1) - (uint64_t)(right - left) * (bottom - top);
+
+        addCoverage(cmd, clip, x1, y1, x2, y2, covered);
+    }
+
+    const uint64_t full = coverBits(0, tileW);
+    bool all = true;
+    for (int j = 0; j < tileH && all; ++j)
+    {
+        all = covered[j] == full;
+    }
+    tileCovered[tile] = all;
+    tileDrawnPixels[tile] = drawn;
+    tileCulledPixels[tile] = culled;
+}
+
+// 把命令在分块局部矩形 [x1, x2) x [y1, y2) 内一定写成不透明的像素记入 covered
+void GDI::addCoverage(const DrawCmd &cmd, const RECT &clip, int x1, int y1, int x2, int y2, uint64_t *covered)
+{
+    if (cmd.type == DrawCmdType::Rect)
+    {
+        if ((cmd.color >> 24) != 255)
+            return;
+        const uint64_t bits = coverBits(x1, x2);
+        for (int j = y1; j < y2; ++j)
+        {
+            covered[j] |= bits;
+        }
+        return;
+    }
+
+    const CachedImage *img = cmd.img;
+    const bool isStatic = cmd.type == DrawCmdType::ImageStatic;
+    const bool useSrc = !isStatic && cmd.hasSrcRect;
+    const int srcX = useSrc ? cmd.srcX : 0;
+    const int srcY = useSrc ? cmd.srcY : 0;
+    const int srcW = useSrc ? cmd.srcW : img->width;
+    const int srcH = useSrc ? cmd.srcH : img->height;
+    // 空的源矩形 drawImageFast 什么都不画, 不能算覆盖
+    if (srcW <= 0 || srcH <= 0)
+        return;
+    if (img->isOpaque)
+    { // 不透明图像写满目标矩形
+        const uint64_t bits = coverBits(x1, x2);
+        for (int j = y1; j < y2; ++j)
+        {
+            covered[j] |= bits;
+        }
+        return;
+    }
+    if (!img->hasSpans())
+        return;
+
+    // 带透明像素: 只有不透明游程映射到的目标列算覆盖, 映射与 drawSpanRow 一致
+    const bool flip = !isStatic && cmd.flip;
+    if (srcX < 0 || srcY < 0 || srcX + srcW > img->width || srcY + srcH > img->height)
+        return;
+
+    const uint64_t stepX = (static_cast<uint64_t>(srcW) * FRACT_UNIT) / cmd.w;
+    const uint64_t stepY = (static_cast<uint64_t>(srcH) * FRACT_UNIT) / cmd.h;
+    const int originX = cmd.x - clip.left;
+    const int originY = cmd.y - clip.top;
+    for (int j = y1; j < y2; ++j)
+    {
+        const int sy = srcY + static_cast<int>((static_cast<uint64_t>(j - originY) * stepY) >> FRACT_BITS);
+        covered[j] |= coverSpanRow(img, sy, srcX, srcW, stepX, flip, originX, x1, x2);
+    }
+}
+
+// 把脏分块合并成矩形提交: 同一行相邻的脏分块合成一段, 上下行相同的段再合并
+void GDI::present()
+{
+    const size_t tileBytesFull = (size_t)backWidth * backHeight * 4;
+    const size_t presentBytesFull = presentPixels ? (size_t)outputWidth * outputHeight * 4 : tileBytesFull;
+    renderStats.renderWidth = backWidth;
+    renderStats.renderHeight = backHeight;
+    renderStats.upscaleMs = 0;
+    renderStats.clearedTiles = 0;
+    renderStats.clearBytes = 0;
+    renderStats.presentRects = 0;
+    renderStats.presentBytes = 0;
+    renderStats.drawnPixels = 0;
+    renderStats.culledPixels = 0;
+    size_t dirtyPixels = 0;
+    for (int t = 0; t < tileCols * tileRows; ++t)
+    {
+        if (!tileDirty[t])
+            continue;
+        {
+            int tx = t % tileCols, ty = t / tileCols;
+            dirtyPixels += (size_t)(min(backWidth, (tx + 1) * TILE_SIZE) - tx * TILE_SIZE) *
+                           (min(backHeight, (ty + 1) * TILE_SIZE) - ty * TILE_SIZE);
+        }
+        renderStats.drawnPixels += tileDrawnPixels[t];
+        renderStats.culledPixels += tileCulledPixels[t];
+        if (!tileCovered[t])
+        {
+            int tx = t % tileCols, ty = t / tileCols;
+            renderStats.clearedTiles++;
+            renderStats.clearBytes += (size_t)(min(backWidth, (tx + 1) * TILE_SIZE) - tx * TILE_SIZE) *
+                                      (min(backHeight, (ty + 1) * TILE_SIZE) - ty * TILE_SIZE) * 4;
+        }
+    }
+
+    HDC hdc = GetDC(hwnd);
+    if (hdc && hBackDC)
+    {
+        // 进行中的矩形: 列范围 [x1, x2) 的分块, 从 startRow 行开始
+        struct Run
+        {
+            int x1, x2, startRow;
+        };
+        std::vector<Run> open, next;
+        auto emit = [&](const Run &r, int endRow)
+        {
+            int px = r.x1 * TILE_SIZE, py = r.startRow * TILE_SIZE;
+            int pw = min(backWidth, r.x2 * TILE_SIZE) - px;
+            int ph = min(backHeight, endRow * TILE_SIZE) - py;
+            renderStats.presentRects++;
+            if (!presentPixels)
+            {
+                BitBlt(hdc, px, py, pw, ph, hBackDC, px, py, SRCCOPY);
+                renderStats.presentBytes += (size_t)pw * ph * 4;
+                return;
+            }
+            // 渲染分辨率与窗口不同: 先放大到窗口大小的缓冲, 再提交对应的输出矩形
+            auto start = std::chrono::steady_clock::now();
+            RECT out;
+            upscale(px, py, pw, ph, out);
+            renderStats.upscaleMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            const int ow = out.right - out.left, oh = out.bottom - out.top;
+            BitBlt(hdc, out.left, out.top, ow, oh, hPresentDC, out.left, out.top, SRCCOPY);
+            renderStats.presentBytes += (size_t)ow * oh * 4;
+        };
+        for (int ty = 0; ty <= tileRows; ++ty)
+        {
+            next.clear();
+            if (ty < tileRows)
+            {
+                for (int tx = 0; tx < tileCols;)
+                {
+                    if (!tileDirty[ty * tileCols + tx])
+                    {
+                        ++tx;
+                        continue;
+                    }
+                    int x1 = tx;
+                    while (tx < tileCols && tileDirty[ty * tileCols + tx])
+                        ++tx;
+                    next.push_back({x1, tx, ty});
+                }
+            }
+            // 与上一行完全相同的段延续, 其余结束
+            for (const Run &r : open)
+            {
+                auto it = std::find_if(next.begin(), next.end(), [&](const Run &n)
+                                       { return n.x1 == r.x1 && n.x2 == r.x2; });
+                if (it != next.end())
+                    it->startRow = r.startRow;
+                else
+                    emit(r, ty);
+            }
+            open.swap(next);
+        }
+    }
+    if (hdc)
+        ReleaseDC(hwnd, hdc);
+
+    renderStats.bytesSaved = (tileBytesFull - renderStats.clearBytes) + (presentBytesFull - renderStats.presentBytes);
+    renderStats.overdraw = dirtyPixels ? static_cast<float>(renderStats.drawnPixels) / dirtyPixels : 0.0f;
+}
+
+void GDI::setThreadCount(int threads)
+{
+    if (threads <= 0)
+        threads = ThreadPool::hardwareThreads();
+    if (rasterPool && rasterPool->size() == threads)
+        return;
+    rasterPool = std::make_unique<ThreadPool>(threads);
+}
+
+int GDI::threadCount()
+{
+    return rasterPool ? rasterPool->size() : 1;
+}
+
+void GDI::text(std::wstring_view txt, int x, int y, float size, Gdiplus::Color color)
+{
+    if (!backPixels || txt.empty())
+        return;
+
+    // 每个字形展开为一条字形图集上的 1:1 字形命令, 与精灵走同一套分块/剔除, 颜色在光栅化时乘上
+    HFONT font = getFont(size);
+    const uint32_t rgb = color.GetValue() & 0xFFFFFF;
+    int penX = x - cameraX;
+    const int top = y - cameraY;
+    // 同一段文本的字形共用排序y, 整体参与 ySort
+    const int sortY = curYSort ? top + textAtlas.ascent(font, size) : 0;
+    const int16_t layer = static_cast<int16_t>(std::clamp(curLayer, -128, 127));
+    for (wchar_t ch : txt)
+    {
+        const Glyph *g = textAtlas.glyph(font, size, ch);
+        if (g->w > 0)
+        {
+            DrawCmd cmd{DrawCmdType::Glyph};
+            cmd.resId = -1 - g->page;
+            cmd.img = textAtlas.page(g->page);
+            cmd.x = penX + g->offsetX;
+            cmd.y = top + g->offsetY;
+            cmd.w = g->w;
+            cmd.h = g->h;
+            cmd.hasSrcRect = true;
+            cmd.srcX = g->x;
+            cmd.srcY = g->y;
+            cmd.srcW = g->w;
+            cmd.srcH = g->h;
+            cmd.color = 0xFF000000 | rgb;
+            toRenderSpace(cmd);
+            if (cmd.w > 0 && cmd.h > 0 &&
+                cmd.x < backWidth && cmd.y < backHeight && cmd.x + cmd.w > 0 && cmd.y + cmd.h > 0)
+            {
+                cmd.layer = layer;
+                cmd.sortY = sortY;
+                cmds.push_back(cmd);
+                renderStats.glyphs++;
+            }
+        }
+        penX += g->advance;
+    }
+}
+
+void GDI::textf(int x, int y, float size, Gdiplus::Color color, const wchar_t *fmt, ...)
+{
+    // 格式化到栈上缓冲区, 每帧刷新的文字不产生堆分配
+    wchar_t buf[256] = {};
+    va_list args;
+    va_start(args, fmt);
+    int len = vswprintf(buf, sizeof(buf) / sizeof(buf[0]), fmt, args);
+    va_end(args);
+    if (len < 0) // 超长时截断
+        len = static_cast<int>(wcsnlen(buf, sizeof(buf) / sizeof(buf[0]) - 1));
+    text(std::wstring_view(buf, len), x, y, size, color);
+}
+
+// 记录一条命令: 剔除完全在屏幕外的绘制, 取好图像, 并计算排序键
+void GDI::submit(DrawCmd &cmd)
+{
+    // 排序y按内部分辨率坐标算, 降低渲染分辨率不改变前后关系
+    const int sortY = cmd.y + cmd.h;
+    toRenderSpace(cmd);
+    if (cmd.w <= 0 || cmd.h <= 0 ||
+        cmd.x >= backWidth || cmd.y >= backHeight || cmd.x + cmd.w <= 0 || cmd.y + cmd.h <= 0)
+    {
+        return;
+    }
+    if (cmd.type == DrawCmdType::Image)
+    {
+        // 缓存查找在主线程完成, 光栅化线程只读图像 (由 1:1 绘制换算来的命令已取好)
+        if (!cmd.img)
+            cmd.img = loadImage(cmd.resId);
+        if (!cmd.img)
+        {
+            if (missingPolicy != MissingImagePolicy::Placeholder ||
+                imageCache.at(cmd.resId).state.load(std::memory_order_acquire) != ImageState::Loading)
+                return;
+            cmd.type = DrawCmdType::Rect;
+            cmd.color = Gdiplus::Color(96, 128, 128, 128).GetValue();
+        }
+        else if (const CachedImage *scaled = scaledImage(cmd))
+        {
+            // 重复出现的缩放绘制换成缓存中重采样好的图像上的1:1绘制
+            cmd.img = scaled;
+            cmd.hasSrcRect = false;
+            cmd.flip = false;
+        }
+        else if (cmd.flip && mirrorImages)
+        {
+            // 翻转绘制换成镜像图像上的正向绘制: 源矩形关于图像中线对称,
+            // 镜像第 i 列即原图第 width-1-i 列, 采样到的像素与逐像素翻转完全一致
+            const int width = cmd.img->width;
+            cmd.img = mirrorImage(cmd.resId);
+            cmd.flip = false;
+            if (cmd.hasSrcRect)
+                cmd.srcX = width - cmd.srcX - cmd.srcW;
+        }
+    }
+    cmd.layer = static_cast<int16_t>(std::clamp(curLayer, -128, 127));
+    cmd.sortY = curYSort ? sortY : 0;
+    cmds.push_back(cmd);
+}
+
+// 内部分辨率坐标换算到渲染分辨率: 按左上/右下边换算, 相邻的矩形换算后仍然相接
+// 1:1 绘制换算后不再是 1:1, 改为整图的缩放绘制
+void GDI::toRenderSpace(DrawCmd &cmd)
+{
+    if (backWidth == logicalWidth && backHeight == logicalHeight)
+        return;
+    const int x1 = scaleFloor(cmd.x, backWidth, logicalWidth);
+    const int y1 = scaleFloor(cmd.y, backHeight, logicalHeight);
+    const int x2 = scaleFloor(cmd.x + cmd.w, backWidth, logicalWidth);
+    const int y2 = scaleFloor(cmd.y + cmd.h, backHeight, logicalHeight);
+    cmd.x = x1;
+    cmd.y = y1;
+    cmd.w = x2 - x1;
+    cmd.h = y2 - y1;
+    if (cmd.type == DrawCmdType::ImageStatic)
+    {
+        cmd.type = DrawCmdType::Image;
+        cmd.flip = false;
+        cmd.hasSrcRect = false;
+    }
+}
+
+// 1:1 绘制需要图像尺寸来确定目标矩形, 记录时先取一次缓存
+void GDI::submitStatic(int resId, int x, int y)
+{
+    CachedImage *img = loadImage(resId);
+    if (!img)
+        return;
+    DrawCmd cmd{DrawCmdType::ImageStatic};
+    cmd.resId = resId;
+    cmd.img = img;
+    cmd.x = x;
+    cmd.y = y;
+    cmd.w = img->width;
+    cmd.h = img->height;
+    submit(cmd);
+}
+
+void GDI::execute(const DrawCmd &cmd, const RECT &clip)
+{
+    switch (cmd.type)
+    {
+    case DrawCmdType::Image:
+        drawImageFast(cmd.img, cmd.x, cmd.y, cmd.w, cmd.h, cmd.flip, cmd.hasSrcRect, cmd.srcX, cmd.srcY, cmd.srcW, cmd.srcH, clip);
+        break;
+    case DrawCmdType::ImageStatic:
+        drawImageStaticFast(cmd.img, cmd.x, cmd.y, clip);
+        break;
+    case DrawCmdType::Rect:
+        drawRectFast(cmd.x, cmd.y, cmd.w, cmd.h, Gdiplus::Color(cmd.color), clip);
+        break;
+    case DrawCmdType::Glyph:
+        drawGlyphFast(cmd.img, cmd.x, cmd.y, cmd.w, cmd.h, cmd.srcX, cmd.srcY, cmd.srcW, cmd.srcH, cmd.color, clip);
+        break;
+    }
+}
+
+// 极致优化：使用SSE2指令集绘制矩形
+void GDI::drawRectFast(int x, int y, int w, int h, Gdiplus::Color color, const RECT &clip)
+{
+    // 1. 裁剪
+    int clipX1 = max<int>(clip.left, x);
+    int clipY1 = max<int>(clip.top, y);
+    int clipX2 = min<int>(clip.right, x + w);
+    int clipY2 = min<int>(clip.bottom, y + h);
+
+    int clippedW = clipX2 - clipX1;
+    if (clippedW <= 0 || clipY1 >= clipY2)
+        return;
+
+    // 2. 颜色转换 Gdiplus(ARGB) -> Buffer(BGRA)
+    uint32_t argb = color.GetValue();
+    uint8_t a = (argb >> 24);
+    uint8_t r = (argb >> 16);
+    uint8_t g = (argb >> 8);
+    uint8_t b = argb;
+    uint32_t bgraColor = (a << 24) | (b << 16) | (g << 8) | r;
+
+    uint32_t *destRowStart = backPixels + (clipY1 * backWidth) + clipX1;
+
+    // 3. 根据透明度选择不同路径
+    if (a == 255)
+    { // --- 不透明路径 (SSE2优化) ---
+        const __m128i color_s = _mm_set1_epi32(bgraColor);
+        for (int j = clipY1; j < clipY2; ++j)
+        {
+            uint32_t *p = destRowStart;
+            int count = clippedW;
+
+            // 内存对齐处理：先处理行首未对齐的几个像素
+            while ((reinterpret_cast<uintptr_t>(p) & 15) && count > 0)
+            {
+                *p++ = bgraColor;
+                count--;
+            }
+
+            // SSE2核心循环：一次处理4个像素
+            __m128i *p_s = reinterpret_cast<__m128i *>(p);
+            while (count >= 4)
+            {
+                _mm_store_si128(p_s++, color_s);
+                count -= 4;
+            }
+
+            // 处理行尾剩下的不足4个的像素
+            p = reinterpret_cast<uint32_t *>(p_s);
+            while (count > 0)
+            {
+                *p++ = bgraColor;
+                count--;
+            }
+            destRowStart += backWidth;
+        }
+    }
+    else if (a > 0)
+    { // --- Alpha混合路径 (逐像素) ---
+        // SIMD优化Alpha混合非常复杂，对于通用情况，逐像素仍是可靠方案
+        uint32_t pr = (r * a) / 255;
+        uint32_t pg = (g * a) / 255;
+        uint32_t pb = (b * a) / 255;
+        uint32_t srcPixel = (a << 24) | (pb << 16) | (pg << 8) | pr;
+
+        for (int j = clipY1; j < clipY2; ++j)
+        {
+            uint32_t *destPtr = destRowStart;
+            for (int i = 0; i < clippedW; ++i)
+            {
+                *destPtr = Blend::pixel(*destPtr, srcPixel);
+                destPtr++;
+            }
+            destRowStart += backWidth;
+        }
+    }
+}
+
+// 图像绘制 (定点数采样, Alpha混合走 Blend 模块的SIMD内核)
+void GDI::drawImageFast(const CachedImage *img, int x, int y, int w, int h,
+                        bool flip, bool hasSrcRect, int srcX_in,
+                        int srcY_in, int srcW_in, int srcH_in, const RECT &clip)
+{
+
+    const int imgW = img->width;
+    const int imgH = img->height;
+
+    int srcW = hasSrcRect ? srcW_in : imgW;
+    int srcH = hasSrcRect ? srcH_in : imgH;
+    int srcX = hasSrcRect ? srcX_in : 0;
+    int srcY = hasSrcRect ? srcY_in : 0;
+
+    if (srcW <= 0 || srcH <= 0 || w <= 0 || h <= 0)
+        return;
+
+    int clipX1 = max<int>(clip.left, x);
+    int clipY1 = max<int>(clip.top, y);
+    int clipX2 = min<int>(clip.right, x + w);
+    int clipY2 = min<int>(clip.bottom, y + h);
+
+    if (clipX1 >= clipX2 || clipY1 >= clipY2)
+        return;
+
+    uint64_t stepX_fixed = (static_cast<uint64_t>(srcW) * FRACT_UNIT) / w;
+    uint64_t stepY_fixed = (static_cast<uint64_t>(srcH) * FRACT_UNIT) / h;
+
+    uint64_t srcY_fixed_start = static_cast<uint64_t>(clipY1 - y) * stepY_fixed;
+
+    uint32_t *destRow = backPixels + (clipY1 * backWidth) + clipX1;
+    uint64_t srcY_fixed = srcY_fixed_start;
+
+    // 带透明像素且源矩形在图像内: 走游程表, 缩放、翻转同样适用
+    if (!img->isOpaque && img->hasSpans() &&
+        srcX >= 0 && srcY >= 0 && srcX + srcW <= imgW && srcY + srcH <= imgH)
+    {
+        const int off = clipX1 - x;
+        for (int j = clipY1; j < clipY2; ++j)
+        {
+            int sy = srcY + static_cast<int>(srcY_fixed >> FRACT_BITS);
+            drawSpanRow(destRow, clipX2 - clipX1, img, sy, srcX, srcW, off, stepX_fixed, flip);
+            destRow += backWidth;
+            srcY_fixed += stepY_fixed;
+        }
+        return;
+    }
+
+    // 其余情况走特化的通用内核; 不缩放但源列超出图像时按缩放处理, 由列索引表钳位
+    const bool scaled = w != srcW || (!flip && (srcX < 0 || srcX + srcW > imgW));
+    BlitArgs args;
+    args.dest = destRow;
+    args.destStride = backWidth;
+    args.width = clipX2 - clipX1;
+    args.height = clipY2 - clipY1;
+    args.img = img;
+    args.srcX = srcX;
+    args.srcW = srcW;
+    args.off = clipX1 - x;
+    args.stepX = stepX_fixed;
+    args.srcY = srcY;
+    args.srcYFixed = srcY_fixed_start;
+    args.stepY = stepY_fixed;
+    BLIT_KERNELS[img->isOpaque][flip][scaled](args);
+}
+
+// 字形: 图集页上源矩形的绘制, 只走游程表, 空白处直接跳过
+void GDI::drawGlyphFast(const CachedImage *img, int x, int y, int w, int h,
+                        int srcX, int srcY, int srcW, int srcH, uint32_t color, const RECT &clip)
+{
+    if (srcW <= 0 || srcH <= 0 || w <= 0 || h <= 0 || !img->hasSpans())
+        return;
+
+    const int clipX1 = max<int>(clip.left, x);
+    const int clipY1 = max<int>(clip.top, y);
+    const int clipX2 = min<int>(clip.right, x + w);
+    const int clipY2 = min<int>(clip.bottom, y + h);
+    if (clipX1 >= clipX2 || clipY1 >= clipY2)
+        return;
+
+    const uint64_t stepX = (static_cast<uint64_t>(srcW) * FRACT_UNIT) / w;
+    const uint64_t stepY = (static_cast<uint64_t>(srcH) * FRACT_UNIT) / h;
+    uint64_t syFixed = static_cast<uint64_t>(clipY1 - y) * stepY;
+    uint32_t *destRow = backPixels + (clipY1 * backWidth) + clipX1;
+    const uint32_t rgb = color & 0xFFFFFF;
+    for (int j = clipY1; j < clipY2; ++j)
+    {
+        const int sy = srcY + static_cast<int>(syFixed >> FRACT_BITS);
+        drawCoverageRow(destRow, clipX2 - clipX1, img, sy, srcX, srcW, clipX1 - x, stepX, rgb);
+        destRow += backWidth;
+        syFixed += stepY;
+    }
+}
+
+// (createBackBuffer, destroyBackBuffer, loadImage, getFont 函数与上一版基本相同，为简洁省略)
+// ... 粘贴上一版中这四个函数的实现即可 ...
+bool GDI::createBackBuffer(int w, int h)
+{
+    destroyBackBuffer();
+    if (w <= 0 || h <= 0)
+        return false;
+
+    backWidth = w;
+    backHeight = h;
+
+    ZeroMemory(&backInfo, sizeof(backInfo));
+    backInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    backInfo.bmiHeader.biWidth = w;
+    backInfo.bmiHeader.biHeight = -h; // top-down
+    backInfo.bmiHeader.biPlanes = 1;
+    backInfo.bmiHeader.biBitCount = 32;
+    backInfo.bmiHeader.biCompression = BI_RGB;
+
+    HDC hdc = GetDC(hwnd);
+    hBackBitmap = CreateDIBSection(hdc, &backInfo, DIB_RGB_COLORS, (void **)&backPixels, NULL, 0);
+    ReleaseDC(hwnd, hdc);
+
+    if (!hBackBitmap)
+    {
+        backPixels = nullptr;
+        return false;
+    }
+
+    hBackDC = CreateCompatibleDC(nullptr);
+    SelectObject(hBackDC, hBackBitmap);
+
+    tileCols = (w + TILE_SIZE - 1) / TILE_SIZE;
+    tileRows = (h + TILE_SIZE - 1) / TILE_SIZE;
+    const size_t tileCount = (size_t)tileCols * tileRows;
+    tileBins.assign(tileCount, {});
+    tileHash.assign(tileCount, 0);
+    prevTileHash.assign(tileCount, 0);
+    tileDirty.assign(tileCount, 1);
+    tileCovered.assign(tileCount, 0);
+    tileClips.assign(tileCount, {});
+    tileDrawnPixels.assign(tileCount, 0);
+    tileCulledPixels.assign(tileCount, 0);
+    fullRedraw = true;
+
+    return true;
+}
+
+void GDI::destroyBackBuffer()
+{
+    if (hBackDC)
+    {
+        DeleteDC(hBackDC);
+        hBackDC = nullptr;
+    }
+    if (hBackBitmap)
+    {
+        DeleteObject(hBackBitmap);
+        hBackBitmap = nullptr;
+    }
+    backPixels = nullptr;
+    backWidth = backHeight = 0;
+}
+
+// 渲染分辨率变化后调用: 与窗口大小不同时准备放大目标和行列映射表, 相同时直接提交渲染缓冲
+void GDI::updatePresentBuffer()
+{
+    if (!backPixels || (outputWidth == backWidth && outputHeight == backHeight) || outputWidth <= 0 || outputHeight <= 0)
+    {
+        destroyPresentBuffer();
+        return;
+    }
+    if (!hPresentBitmap)
+    {
+        BITMAPINFO info = {};
+        info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        info.bmiHeader.biWidth = outputWidth;
+        info.bmiHeader.biHeight = -outputHeight; // top-down
+        info.bmiHeader.biPlanes = 1;
+        info.bmiHeader.biBitCount = 32;
+        info.bmiHeader.biCompression = BI_RGB;
+
+        HDC hdc = GetDC(hwnd);
+        hPresentBitmap = CreateDIBSection(hdc, &info, DIB_RGB_COLORS, (void **)&presentPixels, NULL, 0);
+        ReleaseDC(hwnd, hdc);
+        if (!hPresentBitmap)
+        {
+            presentPixels = nullptr;
+            return;
+        }
+        hPresentDC = CreateCompatibleDC(nullptr);
+        SelectObject(hPresentDC, hPresentBitmap);
+    }
+
+    // 输出像素 (ox, oy) 取渲染像素 (ox * backWidth / outputWidth, oy * backHeight / outputHeight)
+    presentCols.resize(outputWidth);
+    for (int ox = 0; ox < outputWidth; ++ox)
+    {
+        presentCols[ox] = static_cast<uint32_t>((uint64_t)ox * backWidth / outputWidth);
+    }
+    presentRows.resize(outputHeight);
+    for (int oy = 0; oy < outputHeight; ++oy)
+    {
+        presentRows[oy] = static_cast<uint32_t>((uint64_t)oy * backHeight / outputHeight);
+    }
+    presentFactor = 0;
+    if (outputWidth % backWidth == 0 && outputHeight % backHeight == 0 &&
+        outputWidth / backWidth == outputHeight / backHeight)
+        presentFactor = outputWidth / backWidth;
+    fullRedraw = true;
+}
+
+void GDI::destroyPresentBuffer()
+{
+    if (hPresentDC)
+    {
+        DeleteDC(hPresentDC);
+        hPresentDC = nullptr;
+    }
+    if (hPresentBitmap)
+    {
+        DeleteObject(hPresentBitmap);
+        hPresentBitmap = nullptr;
+    }
+    presentPixels = nullptr;
+    presentCols.clear();
+    presentRows.clear();
+    presentFactor = 0;
+}
+
+// 把渲染缓冲中的矩形最近邻放大到 presentPixels, out 返回对应的输出矩形
+// (映射到渲染列 [x, x + w) 的输出列为 [ceil(x * outputWidth / backWidth), ceil((x + w) * outputWidth / backWidth)))
+void GDI::upscale(int x, int y, int w, int h, RECT &out)
+{
+    auto outEdge = [](int v, int outSize, int size)
+    {
+        return static_cast<int>(((uint64_t)v * outSize + size - 1) / size);
+    };
+    out.left = outEdge(x, outputWidth, backWidth);
+    out.right = outEdge(x + w, outputWidth, backWidth);
+    out.top = outEdge(y, outputHeight, backHeight);
+    out.bottom = outEdge(y + h, outputHeight, backHeight);
+
+    const int count = out.right - out.left;
+    for (int oy = out.top; oy < out.bottom; ++oy)
+    {
+        uint32_t *dest = presentPixels + (size_t)oy * outputWidth + out.left;
+        if (oy > out.top && presentRows[oy] == presentRows[oy - 1])
+        { // 与上一输出行同源, 直接复制
+            memcpy(dest, dest - outputWidth, (size_t)count * 4);
+            continue;
+        }
+        const uint32_t *src = backPixels + (size_t)presentRows[oy] * backWidth;
+        if (presentFactor == 2)
+            upscaleRow2x(dest, src + x, w);
+        else if (presentFactor == 4)
+            upscaleRow4x(dest, src + x, w);
+        else
+        {
+            const uint32_t *cols = presentCols.data() + out.left;
+            for (int i = 0; i < count; ++i)
+            {
+                dest[i] = src[cols[i]];
+            }
+        }
+    }
+}
+
+void GDI::setRenderScale(float scale)
+{
+    scale = std::clamp(scale, 0.05f, 1.0f);
+    curRenderScale = scale;
+    const int w = max(1, static_cast<int>(std::lround(logicalWidth * scale)));
+    const int h = max(1, static_cast<int>(std::lround(logicalHeight * scale)));
+    if (!hwnd || (w == backWidth && h == backHeight))
+        return;
+    if (createBackBuffer(w, h))
+        SetBkMode(hBackDC, TRANSPARENT);
+    updatePresentBuffer();
+}
+
+void GDI::setResolutionGovernor(bool enabled, float budgetMs, float minScale)
+{
+    governorEnabled = enabled;
+    governorBudgetMs = budgetMs;
+    governorMinScale = std::clamp(minScale, 0.05f, 1.0f);
+    frameMsAvg = 0;
+    governorCooldown = 0;
+    if (!enabled)
+        setRenderScale(1.0f);
+}
+
+// 帧末执行: 帧时间取指数滑动平均, 超出预算降一档, 明显低于预算时升一档
+// 每次调整后等待一段时间再判断, 避免在两档之间来回切换
+void GDI::governResolution(float dt)
+{
+    if (!governorEnabled || dt <= 0)
+        return;
+    const float ms = dt * 1000.0f;
+    frameMsAvg = frameMsAvg > 0 ? frameMsAvg * 0.9f + ms * 0.1f : ms;
+    if (governorCooldown > 0)
+    {
+        governorCooldown--;
+        return;
+    }
+
+    const float STEP = 0.125f;
+    float scale = curRenderScale;
+    if (frameMsAvg > governorBudgetMs * 1.05f && scale > governorMinScale)
+        scale = max(governorMinScale, scale - STEP);
+    else if (frameMsAvg < governorBudgetMs * 0.75f && scale < 1.0f)
+        scale = min(1.0f, scale + STEP);
+    else
+        return;
+    setRenderScale(scale);
+    governorCooldown = 30;
+}
+
+// 取缓存项, 第一次见到的图像: 资源包里有则直接绑定, 否则提交给加载线程解码
+ImageEntry *GDI::requestImage(int resId)
+{
+    auto [it, inserted] = imageCache.try_emplace(resId);
+    ImageEntry *entry = &it->second;
+    if (!inserted)
+        return entry;
+    // 新请求的图像在本帧内不会被淘汰
+    entry->lastUsedFrame = frameIndex;
+
+    // 资源包里有预解码的像素和游程表, 直接指向映射内容
+    if (const SpritePackEntry *packed = spritePack.find(resId))
+    {
+        spritePack.bind(*packed, entry->image);
+        entry->state.store(ImageState::Ready, std::memory_order_release);
+        cacheStats.mappedBytes += (size_t)packed->width * packed->height * 4;
+        return entry;
+    }
+
+    if (evictedImages.erase(resId))
+        cacheStats.reloads++;
+
+    loaderStats.requested++;
+    loaderStats.pending++;
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        loadsInFlight++;
+    }
+    auto task = [entry, resId]
+    {
+        auto start = std::chrono::steady_clock::now();
+        CachedImage decoded;
+        bool ok = decodeImage(resId, decoded);
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        {
+            std::lock_guard<std::mutex> lock(loadMutex);
+            entry->image = std::move(decoded);
+            entry->decodeMs = ms;
+            entry->state.store(ok ? ImageState::Ready : ImageState::Failed, std::memory_order_release);
+            loadsInFlight--;
+            finishedLoads.push_back(resId);
+        }
+        loadCv.notify_all();
+    };
+    // init 之前没有加载线程, 直接同步解码
+    if (loadPool)
+        loadPool->submit(std::move(task));
+    else
+        task();
+    return entry;
+}
+
+// 主线程汇总加载线程完成的解码
+void GDI::collectLoads()
+{
+    std::vector<int> done;
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        done.swap(finishedLoads);
+    }
+    for (int resId : done)
+    {
+        ImageEntry &entry = imageCache.at(resId);
+        loaderStats.pending--;
+        if (entry.state.load(std::memory_order_acquire) == ImageState::Ready)
+        {
+            loaderStats.decoded++;
+            entry.bytes = entry.image.heapBytes();
+            cacheStats.residentBytes += entry.bytes;
+        }
+        else
+            loaderStats.failed++;
+        loaderStats.decodeMsTotal += entry.decodeMs;
+        loaderStats.decodeMsMax = std::max<double>(loaderStats.decodeMsMax, entry.decodeMs);
+    }
+}
+
+// 取可绘制的图像; 还在解码时按 missingPolicy 等待或返回 nullptr
+CachedImage *GDI::loadImage(int resId)
+{
+    ImageEntry *entry = requestImage(resId);
+    entry->lastUsedFrame = frameIndex;
+    ImageState state = entry->state.load(std::memory_order_acquire);
+    if (state == ImageState::Ready)
+        cacheStats.hits++;
+    else if (state == ImageState::Loading)
+        cacheStats.misses++;
+    if (state == ImageState::Loading)
+    {
+        if (missingPolicy == MissingImagePolicy::Block)
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock(loadMutex);
+            loadCv.wait(lock, [entry]
+                        { return entry->state.load(std::memory_order_acquire) != ImageState::Loading; });
+            state = entry->state.load(std::memory_order_acquire);
+            loaderStats.stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            frameStalled = true;
+        }
+        else
+        {
+            loaderStats.missedDraws++;
+            frameMissed = true;
+            return nullptr;
+        }
+    }
+    return state == ImageState::Ready ? &entry->image : nullptr;
+}
+
+// 取图像的水平镜像, 没有则生成 (主线程, 图像已就绪)
+const CachedImage *GDI::mirrorImage(int resId)
+{
+    ImageEntry &entry = imageCache.at(resId);
+    if (!entry.mirrored)
+    {
+        entry.mirrored = std::make_unique<CachedImage>();
+        entry.mirrored->mirrorFrom(entry.image);
+        const size_t bytes = entry.mirrored->heapBytes();
+        entry.bytes += bytes;
+        cacheStats.residentBytes += bytes;
+        cacheStats.mirroredBytes += bytes;
+        cacheStats.mirrored++;
+    }
+    return entry.mirrored.get();
+}
+
+void GDI::releaseMirror(ImageEntry &entry)
+{
+    if (!entry.mirrored)
+        return;
+    const size_t bytes = entry.mirrored->heapBytes();
+    entry.bytes -= bytes;
+    cacheStats.residentBytes -= bytes;
+    cacheStats.mirroredBytes -= bytes;
+    cacheStats.mirrored--;
+    entry.mirrored.reset();
+}
+
+void GDI::setMirroredImages(bool enabled)
+{
+    mirrorImages = enabled;
+    if (enabled)
+        return;
+    // 已记录的命令可能引用镜像, 只在帧之间调用
+    for (auto &[resId, entry] : imageCache)
+    {
+        releaseMirror(entry);
+    }
+}
+
+size_t ScaledImageKeyHash::operator()(const ScaledImageKey &key) const
+{
+    uint64_t h = hashMix(0, static_cast<uint32_t>(key.resId));
+    h = hashMix(h, (static_cast<uint64_t>(static_cast<uint32_t>(key.srcX)) << 32) | static_cast<uint32_t>(key.srcY));
+    h = hashMix(h, (static_cast<uint64_t>(static_cast<uint32_t>(key.srcW)) << 32) | static_cast<uint32_t>(key.srcH));
+    h = hashMix(h, (static_cast<uint64_t>(static_cast<uint32_t>(key.w)) << 32) | static_cast<uint32_t>(key.h));
+    return static_cast<size_t>(hashMix(h, key.flip));
+}
+
+// 缩放绘制查缓存: 命中返回重采样好的图像; 相邻两帧都出现时生成, 第一次出现只做记录
+// 重采样用 Opaque 内核原样取样 (不混合), 和直接缩放绘制采到的像素逐一相同
+const CachedImage *GDI::scaledImage(const DrawCmd &cmd)
+{
+    // 只缓存图像缓存中的资源, 字形和调用方持有的图像 (key 为负) 不缓存
+    if (cmd.resId <= 0)
+        return nullptr;
+    const CachedImage *img = cmd.img;
+    ScaledImageKey key{cmd.resId, 0, 0, img->width, img->height, cmd.w, cmd.h, cmd.flip};
+    if (cmd.hasSrcRect)
+    {
+        key.srcX = cmd.srcX;
+        key.srcY = cmd.srcY;
+        key.srcW = cmd.srcW;
+        key.srcH = cmd.srcH;
+    }
+    if ((key.srcW == cmd.w && key.srcH == cmd.h) || key.srcW <= 0 || key.srcH <= 0)
+        return nullptr;
+    // 单张超过预算1/4的不缓存, 避免一张图挤掉其余条目
+    const size_t bytes = (size_t)cmd.w * cmd.h * 4;
+    if (bytes > scaledStats.budgetBytes / 4)
+        return nullptr;
+
+    auto [it, inserted] = scaledCache.try_emplace(key);
+    ScaledImageEntry &entry = it->second;
+    const bool seenBefore = !inserted && entry.lastUsedFrame < frameIndex;
+    entry.lastUsedFrame = frameIndex;
+    if (entry.image)
+    {
+        scaledStats.hits++;
+        return entry.image.get();
+    }
+    scaledStats.misses++;
+    if (!seenBefore)
+        return nullptr;
+
+    auto scaled = std::make_unique<CachedImage>();
+    BlitArgs args;
+    args.dest = scaled->allocate(cmd.w, cmd.h);
+    args.destStride = cmd.w;
+    args.width = cmd.w;
+    args.height = cmd.h;
+    args.img = img;
+    args.srcX = key.srcX;
+    args.srcW = key.srcW;
+    args.off = 0;
+    args.stepX = (static_cast<uint64_t>(key.srcW) * FRACT_UNIT) / cmd.w;
+    args.srcY = key.srcY;
+    args.srcYFixed = 0;
+    args.stepY = (static_cast<uint64_t>(key.srcH) * FRACT_UNIT) / cmd.h;
+    const bool resample = cmd.w != key.srcW || (!cmd.flip && (key.srcX < 0 || key.srcX + key.srcW > img->width));
+    BLIT_KERNELS[1][cmd.flip][resample](args);
+    scaled->buildSpans();
+
+    scaledStats.bytes += scaled->heapBytes();
+    scaledStats.entries++;
+    scaledStats.builds++;
+    entry.image = std::move(scaled);
+    return entry.image.get();
+}
+
+// 帧末执行: 丢掉本帧没再出现的记录, 超出预算时按LRU淘汰本帧未用到的条目
+void GDI::evictScaled()
+{
+    std::vector<std::pair<uint64_t, decltype(scaledCache)::iterator>> candidates;
+    for (auto it = scaledCache.begin(); it != scaledCache.end();)
+    {
+        if (!it->second.image)
+        {
+            if (it->second.lastUsedFrame < frameIndex)
+            {
+                it = scaledCache.erase(it);
+                continue;
+            }
+        }
+        else if (it->second.lastUsedFrame < frameIndex)
+            candidates.emplace_back(it->second.lastUsedFrame, it);
+        ++it;
+    }
+    if (scaledStats.bytes <= scaledStats.budgetBytes)
+        return;
+
+    std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b)
+              { return a.first < b.first; });
+    for (const auto &[frame, it] : candidates)
+    {
+        if (scaledStats.bytes <= scaledStats.budgetBytes)
+            break;
+        scaledStats.bytes -= it->second.image->heapBytes();
+        scaledStats.entries--;
+        scaledStats.evictions++;
+        scaledCache.erase(it);
+    }
+}
+
+void GDI::setScaledCacheBudget(size_t bytes)
+{
+    scaledStats.budgetBytes = bytes;
+    if (bytes > 0)
+        return;
+    scaledCache.clear();
+    scaledStats.bytes = 0;
+    scaledStats.entries = 0;
+}
+
+void GDI::prefetch(int resId)
+{
+    requestImage(resId);
+}
+
+void GDI::waitForLoads()
+{
+    {
+        std::unique_lock<std::mutex> lock(loadMutex);
+        loadCv.wait(lock, []
+                    { return loadsInFlight == 0; });
+    }
+    collectLoads();
+}
+
+void GDI::pin(int resId)
+{
+    requestImage(resId)->pinCount++;
+}
+
+void GDI::unpin(int resId)
+{
+    auto it = imageCache.find(resId);
+    if (it != imageCache.end() && it->second.pinCount > 0)
+        it->second.pinCount--;
+}
+
+// 帧末执行 (光栅化已完成, 本帧命令不再引用图像): 超出预算时按LRU淘汰
+// 只淘汰解码完成、持有堆内存、未固定且本帧没有用到的图像; 正在解码的图像被加载线程引用, 不能淘汰
+void GDI::evictImages()
+{
+    cacheStats.images = static_cast<int>(imageCache.size());
+    cacheStats.pinned = 0;
+    for (const auto &[resId, entry] : imageCache)
+    {
+        if (entry.pinCount > 0)
+            cacheStats.pinned++;
+    }
+
+    if (cacheStats.budgetBytes == 0 || cacheStats.residentBytes <= cacheStats.budgetBytes)
+        return;
+
+    std::vector<std::pair<uint64_t, int>> candidates;
+    for (const auto &[resId, entry] : imageCache)
+    {
+        if (entry.bytes > 0 && entry.pinCount == 0 && entry.lastUsedFrame < frameIndex &&
+            entry.state.load(std::memory_order_acquire) == ImageState::Ready)
+            candidates.emplace_back(entry.lastUsedFrame, resId);
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (const auto &[frame, resId] : candidates)
+    {
+        if (cacheStats.residentBytes <= cacheStats.budgetBytes)
+            break;
+        auto it = imageCache.find(resId);
+        cacheStats.evictions++;
+        if (it->second.image.heapBytes() == 0)
+        { // 指向资源包的图像只释放镜像, 映射内容保留
+            releaseMirror(it->second);
+            continue;
+        }
+        releaseMirror(it->second);
+        cacheStats.residentBytes -= it->second.bytes;
+        imageCache.erase(it);
+        evictedImages.insert(resId);
+    }
+    cacheStats.images = static_cast<int>(imageCache.size());
+}
+
+float GDI::decodeTime(int resId)
+{
+    auto it = imageCache.find(resId);
+    if (it == imageCache.end() || it->second.state.load(std::memory_order_acquire) != ImageState::Ready)
+        return -1.0f;
+    return it->second.decodeMs;
+}
+
+// 通过 GDI+ 解码 rc 中的图像资源, 在加载线程执行
+bool GDI::decodeImage(int resId, CachedImage &out)
+{
+    HMODULE hMod = GetModuleHandleW(NULL);
+    HRSRC hResInfo = FindResource(hMod, MAKEINTRESOURCE(resId), RT_RCDATA);
+    if (!hResInfo)
+        return false;
+
+    DWORD resSize = SizeofResource(hMod, hResInfo);
+    HGLOBAL hResData = LoadResource(hMod, hResInfo);
+    if (!hResData || resSize == 0)
+        return false;
+
+    void *pRes = LockResource(hResData);
+    if (!pRes)
+        return false;
+
+    IStream *pStream = SHCreateMemStream((const BYTE *)pRes, resSize);
+    if (!pStream)
+        return false;
+
+    std::unique_ptr<Gdiplus::Bitmap> bmp(Gdiplus::Bitmap::FromStream(pStream));
+    pStream->Release();
+
+    if (!bmp || bmp->GetLastStatus() != Gdiplus::Ok)
+        return false;
+
+    int width = bmp->GetWidth();
+    int height = bmp->GetHeight();
+
+    uint32_t *pixels = out.allocate(width, height);
+
+    Gdiplus::BitmapData bmpData;
+    Gdiplus::Rect rect(0, 0, width, height);
+    if (bmp->LockBits(&rect, Gdiplus::ImageLockModeRead, PixelFormat32bppPARGB, &bmpData) != Gdiplus::Ok)
+    {
+        return false;
+    }
+
+    memcpy(pixels, bmpData.Scan0, (size_t)width * height * 4);
+    bmp->UnlockBits(&bmpData);
+
+    // 解码时生成每行的透明/不透明/半透明游程表, 同时得出 isOpaque
+    out.buildSpans();
+    return true;
+}
+
+HFONT GDI::getFont(float size)
+{
+    auto it = fontCache.find(size);
+    if (it != fontCache.end())
+        return it->second;
+
+    // 更精确地将点(Point)大小转换为逻辑像素大小
+    LOGFONTW lf = {0};
+    HDC hdc = GetDC(hwnd);
+    lf.lfHeight = -MulDiv(static_cast<int>(round(size)), GetDeviceCaps(hdc, LOGPIXELSY), 72);
+    ReleaseDC(hwnd, hdc);
+
+    lf.lfWeight = FW_NORMAL;
+    wcscpy_s(lf.lfFaceName, LF_FACESIZE, L"Arial");
+    HFONT hf = CreateFontIndirectW(&lf);
+
+    fontCache[size] = hf;
+    return hf;
+}
+
+/**
+ * @brief 专用于绘制静态图的底层函数（1:1绘制，无翻转，坐标已做过相机变换）
+ *
+ * 通过特化逻辑，为不透明图像启用逐行memcpy，性能远高于通用绘制函数。
+ */
+void GDI::drawImageStaticFast(const CachedImage *img, int x, int y, const RECT &clip)
+{
+    // 1. 图像资源在记录命令时已经取好
+
+    const int imgW = img->width;
+    const int imgH = img->height;
+
+    // 2. 裁剪到 clip (整屏或单个分块)
+    const int clipX1 = max<int>(clip.left, x);
+    const int clipY1 = max<int>(clip.top, y);
+    const int clipX2 = min<int>(clip.right, x + imgW);
+    const int clipY2 = min<int>(clip.bottom, y + imgH);
+
+    // 计算裁剪后的有效宽度，如果屏幕上不可见则提前退出
+    const int clippedW = clipX2 - clipX1;
+    if (clippedW <= 0 || clipY1 >= clipY2)
+    {
+        return;
+    }
+
+    // 3. 计算图像源的起始读取位置
+    // 因为是1:1绘制，所以源坐标的偏移就等于裁剪区域的左上角与原始绘制位置的差值
+    const int srcX_start = clipX1 - x;
+    const int srcY_start = clipY1 - y;
+
+    // 4. 逐行绘制
+    for (int j = clipY1; j < clipY2; ++j)
+    {
+        // 计算目标行和源行的起始指针
+        uint32_t *destPtr = backPixels + (size_t)j * backWidth + clipX1;
+        const uint32_t *srcPtr = img->pixels + (size_t)(srcY_start + (j - clipY1)) * imgW + srcX_start;
+
+        // 5. 根据不透明属性选择最高效的路径
+        if (img->isOpaque)
+        {
+            // 优化核心：对于不透明图像，直接内存复制整行像素
+            memcpy(destPtr, srcPtr, (size_t)clippedW * sizeof(uint32_t));
+        }
+        else if (img->hasSpans())
+        {
+            // 对于带Alpha通道的图像，按游程表跳过透明段、复制不透明段、只混合半透明段
+            drawSpanRow(destPtr, clippedW, img, srcY_start + (j - clipY1), 0, imgW, srcX_start, FRACT_UNIT, false);
+        }
+        else
+        {
+            Blend::row(destPtr, srcPtr, clippedW);
+        }
+    }
 }
\ No newline at end of file
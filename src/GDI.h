@@ -1,118 +1,501 @@
-﻿#pragma once
-#include <Windows.h>
-#include <gdiplus.h>
-#include <memory>
-#include <unordered_map>
-#include <string>
-#include <cstdint>
-#include <immintrin.h> // For SIMD Intrinsics (SSE2)
-
-// 图像缓存结构 (保持不变)
-struct CachedImage
-{
-    int width = 0;
-    int height = 0;
-    std::unique_ptr<uint32_t[]> pixels; // 预乘Alpha的BGRA格式
-    bool isOpaque = true;
-};
-
-class GDI
-{
-public:
-    GDI() = delete;
-    ~GDI() = default;
-
-    // --- 核心生命周期接口 ---
-    static void init(HWND h);
-    static void begin([[maybe_unused]] float dt)
-    { // 清屏
-        if (backPixels)
-        {
-            memset(backPixels, 0, (size_t)backWidth * (size_t)backHeight * 4);
-        }
-    }
-    // tick 函数为空，仅为保持API兼容性。所有绘制都是立即执行的。
-    static void tick([[maybe_unused]] float dt) {}
-    static void flush([[maybe_unused]] float dt);
-    static void end();
-
-    // --- 绘图接口 (定义移至头文件以强制内联) ---
-    static void image(int resId, int x, int y, int w, int h, bool flip = false)
-    {
-        if (!backPixels)
-            return;
-        drawImageFast(resId, x - cameraX, y - cameraY, w, h, flip, false, 0, 0, 0, 0);
-    }
-
-    static void imageEx(int resId, int x, int y, int w, int h,
-                        bool flip, int srcX, int srcY,
-                        int srcW, int srcH)
-    {
-        if (!backPixels)
-            return;
-        drawImageFast(resId, x - cameraX, y - cameraY, w, h, flip, true, srcX, srcY, srcW, srcH);
-    }
-
-    // 用于UI等不受相机影响的静态图
-    static void imageStatic(int resId, int x, int y)
-    {
-        if (!backPixels)
-            return;
-        drawImageStaticFast(resId, x, y);
-    }
-
-    // 新增：用于绘制世界背景等受相机影响、但不缩放的静态图
-    static void imageWorld(int resId, int x, int y)
-    {
-        if (!backPixels)
-            return;
-        // 直接复用最高效的静态图绘制函数，并传入经过相机转换的坐标
-        drawImageStaticFast(resId, x - cameraX, y - cameraY);
-    }
-
-    static void rect(int x, int y, int w, int h, Gdiplus::Color color = Gdiplus::Color::Green)
-    {
-        if (!backPixels || w <= 0 || h <= 0)
-            return;
-        drawRectFast(x - cameraX, y - cameraY, w, h, color);
-    }
-
-    static void text(const std::wstring &txt, int x, int y, float size = 12.0f, Gdiplus::Color color = Gdiplus::Color::White);
-
-    // --- 相机接口 (内联) ---
-    static void setCamera(int x, int y)
-    {
-        cameraX = x;
-        cameraY = y;
-    }
-
-private:
-    // --- 核心成员 ---
-    static HWND hwnd;
-    static ULONG_PTR gdiplusToken;
-    static uint32_t *backPixels;
-    static HBITMAP hBackBitmap;
-    static HDC hBackDC;
-    static BITMAPINFO backInfo;
-    static int backWidth;
-    static int backHeight;
-    static int cameraX;
-    static int cameraY;
-
-    // --- 缓存 ---
-    static std::unordered_map<int, CachedImage> imageCache;
-    static std::unordered_map<float, HFONT> fontCache;
-
-    // --- 内部辅助函数 ---
-    static bool createBackBuffer(int w, int h);
-    static void destroyBackBuffer();
-    static CachedImage *loadImage(int resId);
-    static HFONT getFont(float size);
-
-    // --- 底层绘制实现 (性能关键) ---
-    static void drawImageFast(int resId, int x, int y, int w, int h,
-                              bool flip, bool hasSrcRect, int srcX,
-                              int srcY, int srcW, int srcH);
-    static void drawRectFast(int x, int y, int w, int h, Gdiplus::Color color);
-    static void drawImageStaticFast(int resId, int x, int y);
+﻿#pragma once
+#include <Windows.h>
+#include <gdiplus.h>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <immintrin.h> // For SIMD Intrinsics (SSE2)
+#include "CachedImage.h"
+#include "ThreadPool.h"
+#include "SpritePack.h"
+#include "TextAtlas.h"
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// 绘制命令类型
+enum class DrawCmdType : uint8_t
+{
+    Image,       // 缩放/翻转/源矩形绘制 (image / imageEx)
+    ImageStatic, // 1:1 绘制 (imageStatic / imageWorld)
+    Rect,        // 纯色矩形
+    Glyph,       // 字形: 覆盖率图集页上的源矩形, 乘 color 后混合
+};
+
+// 一条延迟执行的绘制命令, 坐标均已做过相机变换
+struct DrawCmd
+{
+    DrawCmdType type;
+    bool flip;
+    bool hasSrcRect;
+    int16_t layer;
+    int sortY; // 同层内的排序y, 未开启 ySort 时为0
+    int resId;
+    const CachedImage *img; // 记录时取好的图像, 光栅化线程只读
+    int x, y, w, h;             // 目标矩形
+    int srcX, srcY, srcW, srcH; // 源矩形
+    uint32_t color;             // 矩形/字形颜色 (Gdiplus ARGB)
+};
+
+// 每帧渲染统计
+struct RenderStats
+{
+    int commands = 0;   // 本帧执行的绘制命令数
+    int binned = 0;     // 分块后的 (命令, 分块) 对数
+    int threads = 1;    // 光栅化线程数
+    int glyphs = 0;     // 本帧绘制的字形数
+    double rasterMs = 0; // 排序+光栅化耗时 (不含提交到窗口)
+    double upscaleMs = 0; // 放大到窗口分辨率的耗时
+    int renderWidth = 0;  // 实际渲染分辨率
+    int renderHeight = 0;
+
+    // 脏分块: 分块内的命令序列与上一帧不同即为脏, 只有脏分块会重新清屏/光栅化/提交
+    int dirtyTiles = 0;
+    int clearedTiles = 0;     // 实际清屏的分块 (被不透明绘制完全覆盖的脏分块不清屏)
+    int presentRects = 0;     // 提交到窗口的矩形数
+    size_t clearBytes = 0;    // 实际清屏字节数
+    size_t presentBytes = 0;  // 实际提交字节数
+    size_t bytesSaved = 0;    // 相比整屏清屏+整屏提交节省的字节数
+
+    // 遮挡剔除: 被之后的不透明像素完全覆盖的部分不再绘制
+    size_t drawnPixels = 0;  // 剔除后各命令实际绘制的像素数(按裁剪矩形计)
+    size_t culledPixels = 0; // 被剔除的像素数
+    float overdraw = 0;      // 平均每个脏像素被写入的次数 drawnPixels / 脏分块像素数
+};
+
+// 图像加载状态
+enum class ImageState : uint8_t
+{
+    Loading, // 已提交给加载线程, 尚未解码完成
+    Ready,
+    Failed, // 资源不存在或解码失败, 之后不再重试
+};
+
+// 缓存中的一张图像: 加载线程只写 image/decodeMs, 写完后把 state 置为 Ready/Failed
+struct ImageEntry
+{
+    CachedImage image;
+    std::atomic<ImageState> state{ImageState::Loading};
+    float decodeMs = 0; // 解码耗时, 资源包中的图像为0
+
+    // 以下只由主线程访问
+    uint64_t lastUsedFrame = 0; // 最近一次被绘制的帧号, 用于LRU淘汰
+    int pinCount = 0;           // > 0 时不会被淘汰
+    size_t bytes = 0;           // 计入预算的堆内存, 解码完成后由主线程记录
+    std::unique_ptr<CachedImage> mirrored; // 水平镜像, 第一次翻转绘制时生成
+};
+
+// 图像缓存统计
+struct ImageCacheStats
+{
+    size_t budgetBytes = 0;   // 0 表示不限
+    size_t residentBytes = 0; // 解码后常驻的堆内存
+    size_t mappedBytes = 0;   // 直接指向资源包的图像 (不计入预算)
+    int images = 0;
+    int pinned = 0;
+    uint64_t hits = 0;      // 绘制时图像已就绪
+    uint64_t misses = 0;    // 绘制时图像未加载或仍在解码
+    uint64_t evictions = 0;
+    uint64_t reloads = 0;   // 被淘汰后又重新加载的次数
+    int mirrored = 0;         // 已生成镜像的图像数
+    size_t mirroredBytes = 0; // 镜像占用的堆内存, 已计入 residentBytes
+};
+
+// 缩放结果缓存的键: 同一图像的同一源矩形以相同大小和方向绘制时复用重采样结果
+struct ScaledImageKey
+{
+    int resId;
+    int srcX, srcY, srcW, srcH;
+    int w, h;
+    bool flip;
+    bool operator==(const ScaledImageKey &) const = default;
+};
+
+struct ScaledImageKeyHash
+{
+    size_t operator()(const ScaledImageKey &key) const;
+};
+
+struct ScaledImageEntry
+{
+    std::unique_ptr<CachedImage> image; // 第一次出现时为空, 再次出现才重采样
+    uint64_t lastUsedFrame = 0;
+};
+
+// 缩放结果缓存统计
+struct ScaledCacheStats
+{
+    size_t budgetBytes = 32 * 1024 * 1024; // 0 表示关闭
+    size_t bytes = 0;
+    int entries = 0;        // 已重采样的条目数
+    uint64_t hits = 0;      // 缩放绘制直接用上了缓存
+    uint64_t misses = 0;    // 缩放绘制仍需逐像素采样 (含首次出现和正在生成的)
+    uint64_t builds = 0;
+    uint64_t evictions = 0;
+};
+
+// 图像还没加载完成时, 绘制命令如何处理
+enum class MissingImagePolicy : uint8_t
+{
+    Block,       // 等待加载线程解码完成 (计入卡顿帧)
+    Skip,        // 本帧跳过该绘制
+    Placeholder, // 用半透明矩形代替 (1:1 绘制不知道尺寸, 仍然跳过)
+};
+
+// 图像加载统计
+struct LoadStats
+{
+    int requested = 0;      // 提交解码的图像数
+    int decoded = 0;        // 解码完成的图像数
+    int failed = 0;
+    int pending = 0;        // 正在等待/解码中的图像数
+    int stallFrames = 0;    // 等待解码而卡住的帧数 (Block 策略)
+    int missFrames = 0;     // 有绘制因图像未就绪被跳过/替代的帧数
+    int missedDraws = 0;    // 被跳过/替代的绘制命令数
+    double decodeMsTotal = 0;
+    double decodeMsMax = 0;
+    double stallMs = 0;     // 主线程累计等待时间
+};
+
+class GDI
+{
+public:
+    GDI() = delete;
+    ~GDI() = default;
+
+    // --- 核心生命周期接口 ---
+    // width/height 为内部渲染分辨率 (游戏坐标系), 为0时取窗口客户区大小;
+    // 与窗口大小不同时每帧在 flush 中按最近邻放大到窗口
+    static void init(HWND h, int width = 0, int height = 0);
+    static void begin([[maybe_unused]] float dt)
+    { // 开始记录新一帧的绘制命令; 清屏延迟到 flush 中按脏分块进行
+        cmds.clear();
+        renderStats.glyphs = 0;
+        curLayer = 0;
+        curYSort = false;
+    }
+    // tick 函数为空，仅为保持API兼容性。绘制命令统一在 flush 中排序执行。
+    static void tick([[maybe_unused]] float dt) {}
+    // 排序并执行本帧的全部绘制命令, 然后提交到窗口
+    static void flush([[maybe_unused]] float dt);
+    static void end();
+    // 打开预解码资源包 (tools/cooker 生成), 之后包内的图像不再解码
+    // init 时会自动尝试打开 exe 目录下的 res/sprites.pak
+    static bool openSpritePack(const std::string &path);
+    static const SpritePack &sprites()
+    {
+        return spritePack;
+    }
+    // exe 同目录下的 res 目录 (UTF-8), init 之前为空
+    static const std::string &resourceDir()
+    {
+        return resDir;
+    }
+
+    // --- 图像异步加载 ---
+    // 提前在加载线程解码图像, 之后的绘制不会因首次解码而卡顿 (资源包中的图像立即可用)
+    static void prefetch(int resId);
+    static void prefetch(std::initializer_list<int> resIds)
+    {
+        for (int resId : resIds)
+            prefetch(resId);
+    }
+    // 等待所有已提交的解码完成 (加载界面用)
+    static void waitForLoads();
+    static void setMissingImagePolicy(MissingImagePolicy policy)
+    {
+        missingPolicy = policy;
+    }
+    static const LoadStats &loadStats()
+    {
+        return loaderStats;
+    }
+    // 单张图像的解码耗时(毫秒), 未解码完成返回 -1
+    static float decodeTime(int resId);
+
+    // --- 图像缓存预算 ---
+    // 解码后的图像总内存超过预算时, 在帧末按最近绘制时间淘汰未固定、本帧未使用的图像
+    static void setImageBudget(size_t bytes)
+    {
+        cacheStats.budgetBytes = bytes;
+    }
+    // 固定图像 (引用计数), 固定期间不会被淘汰; pin 同时会提交预取
+    static void pin(int resId);
+    static void unpin(int resId);
+    static const ImageCacheStats &imageCacheStats()
+    {
+        return cacheStats;
+    }
+    // 翻转绘制改用预先镜像的图像 (默认开启): 翻转与不翻转走同样的 memcpy/SIMD/游程路径,
+    // 代价是每张翻转用过的图像多占一份内存; 关闭时释放已生成的镜像
+    static void setMirroredImages(bool enabled);
+
+    // --- 缩放结果缓存 ---
+    // 同样的缩放绘制 (图像, 源矩形, 宽高, 翻转) 在相邻两帧都出现时缓存重采样后的图像, 之后按1:1绘制
+    // 超出预算时在帧末按最近使用时间淘汰本帧未用到的条目; 只在帧之间修改, 设为0时关闭并清空
+    static void setScaledCacheBudget(size_t bytes);
+    static const ScaledCacheStats &scaledCacheStats()
+    {
+        return scaledStats;
+    }
+
+    // 窗口内容失效 (如 WM_PAINT) 时调用, 下一帧整屏重绘并提交
+    static void invalidate()
+    {
+        fullRedraw = true;
+    }
+
+    // --- 渲染分辨率 ---
+    // 实际渲染分辨率 = 内部分辨率 * scale (0 < scale <= 1), 绘制坐标仍按内部分辨率给出, 记录时换算
+    // 只在帧之间调用; 改变后整屏重绘
+    static void setRenderScale(float scale);
+    static float renderScale()
+    {
+        return curRenderScale;
+    }
+    // 动态分辨率: 平均帧时间超过 budgetMs 时逐级降低渲染分辨率 (最低 minScale), 有余量时逐级恢复
+    static void setResolutionGovernor(bool enabled, float budgetMs = 1000.0f / 60.0f, float minScale = 0.5f);
+
+    // --- 多线程光栅化 ---
+    // 屏幕按 TILE_SIZE 分块, 各分块并行光栅化, 分块内保持命令顺序, 结果与单线程逐位一致
+    static const int TILE_SIZE = 64;
+    // 光栅化线程数 (包含主线程), <= 0 时取硬件线程数, 1 为单线程
+    static void setThreadCount(int threads);
+    static int threadCount();
+    static const RenderStats &stats()
+    {
+        return renderStats;
+    }
+
+    // --- 绘制顺序 ---
+    // 之后的绘制命令进入 layer 层 (-128 ~ 127), 层号小的先画; 同层内按提交顺序绘制。
+    // ySort 为 true 时同层内按目标矩形底边 y 排序 (底边相同再按提交顺序), 用于角色前后遮挡。
+    static void setLayer(int layer, bool ySort = false)
+    {
+        curLayer = layer;
+        curYSort = ySort;
+    }
+
+    // --- 绘图接口 (只记录命令, 定义在头文件以强制内联) ---
+    static void image(int resId, int x, int y, int w, int h, bool flip = false)
+    {
+        if (!backPixels)
+            return;
+        DrawCmd cmd{DrawCmdType::Image, flip, false};
+        cmd.resId = resId;
+        cmd.x = x - cameraX;
+        cmd.y = y - cameraY;
+        cmd.w = w;
+        cmd.h = h;
+        submit(cmd);
+    }
+
+    static void imageEx(int resId, int x, int y, int w, int h,
+                        bool flip, int srcX, int srcY,
+                        int srcW, int srcH)
+    {
+        if (!backPixels)
+            return;
+        DrawCmd cmd{DrawCmdType::Image, flip, true};
+        cmd.resId = resId;
+        cmd.x = x - cameraX;
+        cmd.y = y - cameraY;
+        cmd.w = w;
+        cmd.h = h;
+        cmd.srcX = srcX;
+        cmd.srcY = srcY;
+        cmd.srcW = srcW;
+        cmd.srcH = srcH;
+        submit(cmd);
+    }
+
+    // 用于UI等不受相机影响的静态图
+    static void imageStatic(int resId, int x, int y)
+    {
+        if (!backPixels)
+            return;
+        submitStatic(resId, x, y);
+    }
+
+    // 新增：用于绘制世界背景等受相机影响、但不缩放的静态图
+    static void imageWorld(int resId, int x, int y)
+    {
+        if (!backPixels)
+            return;
+        // 与静态图同一种命令, 只是坐标经过相机转换
+        submitStatic(resId, x - cameraX, y - cameraY);
+    }
+
+    // 绘制调用方持有的图像 (如瓦片地图的烘焙块), 受相机影响, 不缩放
+    // key 用 newImageKey() 分配, 图像内容变化或重新生成时须换新的 key (脏分块按 key 判断内容是否变化)
+    static void bitmapWorld(const CachedImage *img, int key, int x, int y)
+    {
+        if (!backPixels || !img)
+            return;
+        DrawCmd cmd{DrawCmdType::ImageStatic};
+        cmd.resId = key;
+        cmd.img = img;
+        cmd.x = x - cameraX;
+        cmd.y = y - cameraY;
+        cmd.w = img->width;
+        cmd.h = img->height;
+        submit(cmd);
+    }
+    static int newImageKey()
+    {
+        return nextImageKey--;
+    }
+
+    static void rect(int x, int y, int w, int h, Gdiplus::Color color = Gdiplus::Color::Green)
+    {
+        if (!backPixels || w <= 0 || h <= 0)
+            return;
+        DrawCmd cmd{DrawCmdType::Rect};
+        cmd.x = x - cameraX;
+        cmd.y = y - cameraY;
+        cmd.w = w;
+        cmd.h = h;
+        cmd.color = color.GetValue();
+        submit(cmd);
+    }
+
+    // 文本: 字形首次使用时光栅化进字形图集, 之后按图像绘制
+    static void text(std::wstring_view txt, int x, int y, float size = 12.0f, Gdiplus::Color color = Gdiplus::Color::White);
+    // printf 风格的文本, 格式化到栈上缓冲区 (最长255字符), 每帧刷新的文字不产生堆分配
+    static void textf(int x, int y, float size, Gdiplus::Color color, const wchar_t *fmt, ...);
+
+    // --- 相机接口 (内联) ---
+    static void setCamera(int x, int y)
+    {
+        cameraX = x;
+        cameraY = y;
+    }
+
+private:
+    // --- 核心成员 ---
+    static HWND hwnd;
+    static ULONG_PTR gdiplusToken;
+    static uint32_t *backPixels;
+    static HBITMAP hBackBitmap;
+    static HDC hBackDC;
+    static BITMAPINFO backInfo;
+    static int backWidth;
+    static int backHeight;
+    // 内部分辨率 (绘制坐标系) 和窗口输出分辨率; 渲染分辨率即 backWidth/backHeight
+    static int logicalWidth;
+    static int logicalHeight;
+    static int outputWidth;
+    static int outputHeight;
+    static float curRenderScale;
+    // 渲染分辨率与窗口不同时的放大目标, 大小同窗口
+    static uint32_t *presentPixels;
+    static HBITMAP hPresentBitmap;
+    static HDC hPresentDC;
+    static std::vector<uint32_t> presentCols; // 输出列 -> 渲染列
+    static std::vector<uint32_t> presentRows; // 输出行 -> 渲染行
+    static int presentFactor;                 // 宽高同为整数倍时的倍数, 否则为0
+    // 动态分辨率
+    static bool governorEnabled;
+    static float governorBudgetMs;
+    static float governorMinScale;
+    static float frameMsAvg;
+    static int governorCooldown;
+    static int cameraX;
+    static int cameraY;
+
+    // --- 缓存 ---
+    // 只由主线程插入; unordered_map 的元素地址在插入/扩容后不变, 加载线程持有元素指针写入
+    static std::unordered_map<int, ImageEntry> imageCache;
+    static SpritePack spritePack; // 预解码资源包, 找到的图像直接指向映射内容
+    static std::string resDir;
+    static int nextImageKey; // 调用方持有的图像的 key, 从 -65536 向下分配 (-1 ~ -65535 留给字形图集页)
+
+    // --- 异步加载 ---
+    static std::unique_ptr<ThreadPool> loadPool;
+    static std::mutex loadMutex;
+    static std::condition_variable loadCv;
+    static MissingImagePolicy missingPolicy;
+    static LoadStats loaderStats;
+    static bool frameStalled;
+    static bool frameMissed;
+    static uint64_t frameIndex;
+    static ImageCacheStats cacheStats;
+    static std::unordered_set<int> evictedImages; // 被淘汰过的图像, 再次加载时计为 reload
+    static bool mirrorImages;
+    static std::unordered_map<ScaledImageKey, ScaledImageEntry, ScaledImageKeyHash> scaledCache;
+    static ScaledCacheStats scaledStats;
+    // 以下由 loadMutex 保护
+    static int loadsInFlight;
+    static std::vector<int> finishedLoads; // 加载线程完成的图像, 主线程在 collectLoads 中汇总统计
+    static std::unordered_map<float, HFONT> fontCache;
+    static TextAtlas textAtlas;
+
+    // --- 本帧绘制命令 ---
+    static std::vector<DrawCmd> cmds;
+    // 排序键: layer(8位) | 排序y(24位) | 提交序号(32位), 低32位即命令下标
+    static std::vector<uint64_t> sortKeys;
+    static std::vector<uint64_t> sortTmp;
+    static int curLayer;
+    static bool curYSort;
+
+    // --- 分块光栅化 ---
+    static std::unique_ptr<ThreadPool> rasterPool;
+    static int tileCols;
+    static int tileRows;
+    // 每个分块的命令下标列表 (按执行顺序)
+    static std::vector<std::vector<uint32_t>> tileBins;
+    static RenderStats renderStats;
+
+    // --- 脏分块 ---
+    // 分块内命令序列的哈希, 与上一帧比较得出脏分块
+    static std::vector<uint64_t> tileHash;
+    static std::vector<uint64_t> prevTileHash;
+    static std::vector<uint8_t> tileDirty;
+    static std::vector<uint8_t> tileCovered; // 分块被不透明像素完全覆盖, 无需清屏
+    static std::vector<std::vector<RECT>> tileClips; // 与 tileBins 一一对应, 遮挡剔除后各命令的裁剪矩形
+    static std::vector<uint64_t> tileDrawnPixels;
+    static std::vector<uint64_t> tileCulledPixels;
+    static bool fullRedraw;
+
+    // --- 内部辅助函数 ---
+    static void submit(DrawCmd &cmd);
+    static void submitStatic(int resId, int x, int y);
+    static void execute(const DrawCmd &cmd, const RECT &clip);
+    static void rasterize();
+    static void binCommands();
+    static void present();
+    static void cullTile(int tile, const RECT &clip);
+    static void addCoverage(const DrawCmd &cmd, const RECT &clip, int x1, int y1, int x2, int y2, uint64_t *covered);
+    static bool tileRange(const DrawCmd &cmd, int &x1, int &y1, int &x2, int &y2);
+    static bool createBackBuffer(int w, int h);
+    static void destroyBackBuffer();
+    static void updatePresentBuffer();
+    static void destroyPresentBuffer();
+    static void upscale(int x, int y, int w, int h, RECT &out);
+    static void governResolution(float dt);
+    static void toRenderSpace(DrawCmd &cmd);
+    static ImageEntry *requestImage(int resId);
+    static void collectLoads();
+    static void evictImages();
+    static CachedImage *loadImage(int resId);
+    static const CachedImage *mirrorImage(int resId);
+    static void releaseMirror(ImageEntry &entry);
+    static const CachedImage *scaledImage(const DrawCmd &cmd);
+    static void evictScaled();
+    static bool decodeImage(int resId, CachedImage &out);
+    static HFONT getFont(float size);
+
+    // --- 底层绘制实现 (性能关键) ---
+    // clip 为本次绘制允许写入的区域 (整屏或单个分块)
+    static void drawImageFast(const CachedImage *img, int x, int y, int w, int h,
+                              bool flip, bool hasSrcRect, int srcX,
+                              int srcY, int srcW, int srcH, const RECT &clip);
+    static void drawRectFast(int x, int y, int w, int h, Gdiplus::Color color, const RECT &clip);
+    static void drawImageStaticFast(const CachedImage *img, int x, int y, const RECT &clip);
+    static void drawGlyphFast(const CachedImage *img, int x, int y, int w, int h,
+                              int srcX, int srcY, int srcW, int srcH, uint32_t color, const RECT &clip);
 };
\ No newline at end of file
@@ -1,67 +1,101 @@
-﻿#pragma once
-#include <memory>
-#include <unordered_map>
-#include <string>
-#include "GDI.h"
-#include "quadtree/QuadTree.h"
-
-class Scene
-{
-protected:
-    // std::unordered_map<std::string, std::unique_ptr<Resource>> m_uniqueRes;
-    // std::unordered_map<std::string, std::shared_ptr<Resource>> m_sharedRes;
-
-public:
-    static std::unique_ptr<Scene> curScene;
-
-    static void change(std::unique_ptr<Scene> newScene)
-    {
-        if (curScene)
-        {
-            curScene->exit();
-        }
-        if (newScene != nullptr)
-        {
-            newScene->beforeEnter();
-            newScene->enter();
-        }
-        // 重置 curScene：释放当前管理的对象，接管新对象的所有权。
-        curScene = std::move(newScene);
-    }
-
-    // 所有权隐藏在m_uniqueRes,外部不用关心生命周期
-    template <typename R>
-    R *getSceneRes(const std::string &name)
-    {
-        // auto res = ResMgr::get<R>(name);
-        // R *raw = res.get();
-        // m_uniqueRes[name] = std::move(res);
-        return nullptr;
-    }
-
-    // 与get统一,方便外部使用
-    template <typename R>
-    R *loadSceneRes(const std::string &name)
-    {
-        // auto res = ResMgr::load<R>(name);
-        // R *raw = res.get();
-        // m_sharedRes[name] = res;
-        return nullptr;
-    }
-
-    virtual void onKeyDown(int key) {}
-    virtual void onKeyUp(int key) {}
-
-    virtual void beforeEnter() {}
-
-    virtual void enter() {}
-
-    virtual void tick(double deltaTime) {}
-
-    virtual void render() {}
-    virtual void renderGlobal() {}
-
-    virtual void exit() {}
-
-    virtual ~Scene() = default;
-};
+﻿#pragma once
+#include <memory>
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include "GDI.h"
+#include "quadtree/QuadTree.h"
+
+extern int GAME_HEIGHT;
+extern int WORLD_RIGHT;
+
+class Scene
+{
+protected:
+    // std::unordered_map<std::string, std::unique_ptr<Resource>> m_uniqueRes;
+    // std::unordered_map<std::string, std::shared_ptr<Resource>> m_sharedRes;
+
+    // 本场景固定在图像缓存中的资源, 场景切换时自动解除
+    std::vector<int> pinnedImages;
+
+    // 固定(并预取)本场景用到的图像, 场景存活期间不会被缓存预算淘汰
+    void pinImages(std::initializer_list<int> resIds)
+    {
+        for (int resId : resIds)
+        {
+            GDI::pin(resId);
+            pinnedImages.push_back(resId);
+        }
+    }
+    void unpinImages()
+    {
+        for (int resId : pinnedImages)
+        {
+            GDI::unpin(resId);
+        }
+        pinnedImages.clear();
+    }
+
+public:
+    static std::unique_ptr<Scene> curScene;
+
+    static void change(std::unique_ptr<Scene> newScene)
+    {
+        if (curScene)
+        {
+            curScene->exit();
+            curScene->unpinImages();
+        }
+        if (newScene != nullptr)
+        {
+            // 每个场景有自己的碰撞世界; 旧场景的对象随后析构时在新世界中找不到自己, 移除是空操作
+            Broadphase::WORLD = newScene->createWorld();
+            newScene->beforeEnter();
+            newScene->enter();
+        }
+        // 重置 curScene：释放当前管理的对象，接管新对象的所有权。
+        curScene = std::move(newScene);
+    }
+
+    // 所有权隐藏在m_uniqueRes,外部不用关心生命周期
+    template <typename R>
+    R *getSceneRes(const std::string &name)
+    {
+        // auto res = ResMgr::get<R>(name);
+        // R *raw = res.get();
+        // m_uniqueRes[name] = std::move(res);
+        return nullptr;
+    }
+
+    // 与get统一,方便外部使用
+    template <typename R>
+    R *loadSceneRes(const std::string &name)
+    {
+        // auto res = ResMgr::load<R>(name);
+        // R *raw = res.get();
+        // m_sharedRes[name] = res;
+        return nullptr;
+    }
+
+    virtual void onKeyDown(int key) {}
+    virtual void onKeyUp(int key) {}
+
+    // 本场景的碰撞世界 (宽相位), 进入场景前创建; 默认为覆盖整个关卡的四叉树
+    virtual std::unique_ptr<Broadphase> createWorld()
+    {
+        return std::make_unique<QuadTree>(QuadTreeRect(-100, -100, WORLD_RIGHT * 1.5, GAME_HEIGHT * 1.5), 4);
+    }
+
+    virtual void beforeEnter() {}
+
+    virtual void enter() {}
+
+    virtual void tick(double deltaTime) {}
+
+    virtual void render() {}
+    virtual void renderGlobal() {}
+
+    virtual void exit() {}
+
+    virtual ~Scene() = default;
+};
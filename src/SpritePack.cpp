@@ -0,0 +1,202 @@
+﻿#include "SpritePack.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SpritePack::~SpritePack()
+{
+    close();
+}
+
+bool SpritePack::open(const std::string &path)
+{
+    close();
+
+#ifdef _WIN32
+    // 路径按UTF-8处理
+    int wlen = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+    std::wstring wpath(wlen > 0 ? wlen - 1 : 0, L'\0');
+    if (wlen > 0)
+        MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wpath.data(), wlen);
+
+    HANDLE file = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = static_cast<const uint8_t *>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void *view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+    data = static_cast<const uint8_t *>(view);
+    size = static_cast<size_t>(st.st_size);
+#endif
+
+    if (!validate())
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SpritePack::close()
+{
+    byId.clear();
+    byName.clear();
+    entries = nullptr;
+    entryCount = 0;
+    if (!data)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(const_cast<uint8_t *>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+// 检查头部、索引、每个条目的数据范围和游程表, 之后的访问不再做边界检查
+bool SpritePack::validate()
+{
+    if (size < sizeof(SpritePackHeader))
+        return false;
+    const auto *header = reinterpret_cast<const SpritePackHeader *>(data);
+    if (header->magic != SPRITE_PACK_MAGIC || header->version != SPRITE_PACK_VERSION || header->fileSize != size)
+        return false;
+
+    auto inRange = [this](uint64_t offset, uint64_t bytes)
+    {
+        return offset <= size && bytes <= size - offset;
+    };
+
+    if (!inRange(header->indexOffset, (uint64_t)header->count * sizeof(SpritePackEntry)) ||
+        header->indexOffset % alignof(SpritePackEntry) != 0 || header->namesOffset > size)
+        return false;
+
+    entries = reinterpret_cast<const SpritePackEntry *>(data + header->indexOffset);
+    entryCount = header->count;
+    byId.reserve(entryCount);
+    byName.reserve(entryCount);
+
+    for (uint32_t i = 0; i < entryCount; ++i)
+    {
+        const SpritePackEntry &e = entries[i];
+        if (e.width == 0 || e.height == 0 || e.width > INT32_MAX / e.height)
+            return false;
+        const uint64_t pixelBytes = (uint64_t)e.width * e.height * 4;
+        if (!inRange(e.pixelOffset, pixelBytes) || e.pixelOffset % alignof(uint32_t) != 0)
+            return false;
+        if (e.flags & SPRITE_HAS_SPANS)
+        {
+            if (!inRange(e.spanOffset, (uint64_t)e.spanCount * sizeof(ImageSpan)) || e.spanOffset % alignof(ImageSpan) != 0 ||
+                !inRange(e.rowSpanOffset, ((uint64_t)e.height + 1) * 4) || e.rowSpanOffset % alignof(uint32_t) != 0)
+                return false;
+            // 行索引必须单调且不超过游程总数
+            const auto *rows = reinterpret_cast<const uint32_t *>(data + e.rowSpanOffset);
+            if (rows[0] != 0 || rows[e.height] != e.spanCount)
+                return false;
+            // 每行的游程按 x 排列、互不重叠且在图像宽度内, drawSpanRow/coverSpanRow 依赖这一点
+            const auto *spans = reinterpret_cast<const ImageSpan *>(data + e.spanOffset);
+            for (uint32_t y = 0; y < e.height; ++y)
+            {
+                if (rows[y] > rows[y + 1])
+                    return false;
+                uint32_t end = 0;
+                for (uint32_t k = rows[y]; k < rows[y + 1]; ++k)
+                {
+                    const ImageSpan &sp = spans[k];
+                    if (sp.len == 0 || sp.x < end || (uint32_t)sp.x + sp.len > e.width || static_cast<uint8_t>(sp.type) > static_cast<uint8_t>(SpanType::Partial))
+                        return false;
+                    end = (uint32_t)sp.x + sp.len;
+                }
+            }
+        }
+        if (!inRange(header->namesOffset + e.nameOffset, e.nameLength))
+            return false;
+
+        if (e.resId != 0)
+            byId.emplace(e.resId, i);
+        byName.emplace(name(e), i);
+    }
+    return true;
+}
+
+const SpritePackEntry *SpritePack::find(int resId) const
+{
+    auto it = byId.find(resId);
+    return it != byId.end() ? &entries[it->second] : nullptr;
+}
+
+const SpritePackEntry *SpritePack::find(std::string_view entryName) const
+{
+    auto it = byName.find(entryName);
+    return it != byName.end() ? &entries[it->second] : nullptr;
+}
+
+std::string_view SpritePack::name(const SpritePackEntry &entry) const
+{
+    const auto *header = reinterpret_cast<const SpritePackHeader *>(data);
+    return std::string_view(reinterpret_cast<const char *>(data + header->namesOffset + entry.nameOffset), entry.nameLength);
+}
+
+void SpritePack::bind(const SpritePackEntry &entry, CachedImage &out) const
+{
+    out.width = static_cast<int>(entry.width);
+    out.height = static_cast<int>(entry.height);
+    out.pixels = reinterpret_cast<const uint32_t *>(data + entry.pixelOffset);
+    out.isOpaque = (entry.flags & SPRITE_OPAQUE) != 0;
+    if (entry.flags & SPRITE_HAS_SPANS)
+    {
+        out.spans = reinterpret_cast<const ImageSpan *>(data + entry.spanOffset);
+        out.rowSpans = reinterpret_cast<const uint32_t *>(data + entry.rowSpanOffset);
+    }
+    else
+    {
+        out.spans = nullptr;
+        out.rowSpans = nullptr;
+    }
+}
@@ -0,0 +1,108 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "CachedImage.h"
+
+// 预解码精灵资源包 (由 tools/cooker 生成)
+// 文件内容全部为小端序, 布局:
+//   SpritePackHeader
+//   SpritePackEntry[count]          (indexOffset)
+//   名字字符串 (UTF-8, 不含结尾0)     (namesOffset)
+//   各图像的像素/游程表数据           (按 SPRITE_PACK_ALIGN 对齐)
+// 像素为预乘Alpha的BGRA, 游程表与 CachedImage::buildSpans 生成的完全一致,
+// 运行时映射文件后 CachedImage 直接指向文件内容, 不解码也不复制。
+// 预乘由 cooker 按 (c * a + 127) / 255 四舍五入计算, 不保证与 GDI+ 转 PARGB 的舍入一致:
+// 不透明和全透明像素完全相同, 半透明像素每个颜色通道可能差 1。
+// 所以同一张 png 从资源包和从 GDI+ 加载, 半透明边缘的混合结果可能差 1, 游程表和 alpha 不受影响。
+
+constexpr uint32_t SPRITE_PACK_MAGIC = 0x4B415048; // "HPAK"
+constexpr uint32_t SPRITE_PACK_VERSION = 1;
+constexpr uint32_t SPRITE_PACK_ALIGN = 64;
+
+enum SpritePackFlags : uint32_t
+{
+    SPRITE_OPAQUE = 1 << 0,    // 所有像素 alpha == 255
+    SPRITE_HAS_SPANS = 1 << 1, // 带游程表
+};
+
+struct SpritePackHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t indexOffset;
+    uint64_t namesOffset;
+    uint64_t fileSize;
+};
+
+struct SpritePackEntry
+{
+    int32_t resId; // resources.rc 中的资源ID, 不在 rc 中的图像为 0, 只能按名字查找
+    uint32_t width;
+    uint32_t height;
+    uint32_t flags;
+    uint64_t pixelOffset;
+    uint64_t spanOffset;    // ImageSpan[spanCount]
+    uint64_t rowSpanOffset; // uint32_t[height + 1]
+    uint32_t spanCount;
+    uint32_t nameOffset; // 相对 namesOffset
+    uint32_t nameLength;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(SpritePackHeader) == 40, "pack layout");
+static_assert(sizeof(SpritePackEntry) == 56, "pack layout");
+
+// 只读映射的资源包
+class SpritePack
+{
+public:
+    SpritePack() = default;
+    ~SpritePack();
+
+    SpritePack(const SpritePack &) = delete;
+    SpritePack &operator=(const SpritePack &) = delete;
+
+    // 映射并校验资源包, 失败时返回 false 且保持关闭状态
+    bool open(const std::string &path);
+    void close();
+
+    bool isOpen() const
+    {
+        return data != nullptr;
+    }
+    size_t count() const
+    {
+        return entryCount;
+    }
+    const SpritePackEntry &entry(size_t i) const
+    {
+        return entries[i];
+    }
+
+    const SpritePackEntry *find(int resId) const;
+    const SpritePackEntry *find(std::string_view name) const;
+    std::string_view name(const SpritePackEntry &entry) const;
+
+    // 让 out 直接指向映射中的像素和游程表 (零拷贝), 资源包关闭前有效
+    void bind(const SpritePackEntry &entry, CachedImage &out) const;
+
+private:
+    bool validate();
+
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    const SpritePackEntry *entries = nullptr;
+    size_t entryCount = 0;
+    std::unordered_map<int, uint32_t> byId;
+    std::unordered_map<std::string_view, uint32_t> byName;
+
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
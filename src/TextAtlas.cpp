@@ -0,0 +1,142 @@
+﻿#include "TextAtlas.h"
+#include <cstring>
+
+TextAtlas::~TextAtlas()
+{
+    clear();
+}
+
+void TextAtlas::clear()
+{
+    faces.clear();
+    pages.clear();
+    pageBits.clear();
+    pageDirty.clear();
+    glyphTotal = 0;
+    if (dc)
+    {
+        DeleteDC(dc);
+        dc = nullptr;
+    }
+}
+
+TextAtlas::Face &TextAtlas::face(HFONT font, float size)
+{
+    uint32_t key;
+    memcpy(&key, &size, sizeof(key));
+
+    auto [it, inserted] = faces.try_emplace(key);
+    Face &f = it->second;
+    if (inserted)
+    {
+        if (!dc)
+            dc = CreateCompatibleDC(nullptr);
+        HGDIOBJ old = SelectObject(dc, font);
+        TEXTMETRICW tm = {};
+        GetTextMetricsW(dc, &tm);
+        SelectObject(dc, old);
+        f.ascent = tm.tmAscent;
+    }
+    return f;
+}
+
+int TextAtlas::ascent(HFONT font, float size)
+{
+    return face(font, size).ascent;
+}
+
+void TextAtlas::commit()
+{
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        if (!pageDirty[i])
+            continue;
+        pages[i]->buildSpans();
+        pageDirty[i] = 0;
+    }
+}
+
+// 货架式装箱: 放不下当前行就换行, 放不下当前页就开新页
+bool TextAtlas::place(Face &f, int w, int h, int &x, int &y)
+{
+    if (w > PAGE_SIZE || h > PAGE_SIZE)
+        return false;
+    if (f.page >= 0 && f.shelfX + w > PAGE_SIZE)
+    {
+        f.shelfX = 0;
+        f.shelfY += f.shelfH;
+        f.shelfH = 0;
+    }
+    if (f.page < 0 || f.shelfY + h > PAGE_SIZE)
+    {
+        auto img = std::make_unique<CachedImage>();
+        pageBits.push_back(img->allocateCoverage(PAGE_SIZE, PAGE_SIZE)); // 初始全透明
+        img->isOpaque = false;
+        pages.push_back(std::move(img));
+        pageDirty.push_back(1);
+        f.page = static_cast<int>(pages.size()) - 1;
+        f.shelfX = 0;
+        f.shelfY = 0;
+        f.shelfH = 0;
+    }
+    x = f.shelfX;
+    y = f.shelfY;
+    f.shelfX += w;
+    if (h > f.shelfH)
+        f.shelfH = h;
+    return true;
+}
+
+const Glyph *TextAtlas::glyph(HFONT font, float size, wchar_t ch)
+{
+    Face &f = face(font, size);
+    auto it = f.glyphs.find(ch);
+    if (it != f.glyphs.end())
+        return &it->second;
+
+    HGDIOBJ old = SelectObject(dc, font);
+    const MAT2 identity = {{0, 1}, {0, 0}, {0, 0}, {0, 1}};
+    GLYPHMETRICS gm = {};
+    DWORD bytes = GetGlyphOutlineW(dc, ch, GGO_GRAY8_BITMAP, &gm, 0, nullptr, &identity);
+
+    Glyph g = {};
+    g.advance = static_cast<int16_t>(gm.gmCellIncX);
+    if (bytes != GDI_ERROR && bytes > 0)
+    {
+        scratch.resize(bytes);
+        GetGlyphOutlineW(dc, ch, GGO_GRAY8_BITMAP, &gm, bytes, scratch.data(), &identity);
+
+        // 字形四周各留1像素透明边, 缩放采样时不会取到相邻字形
+        const int w = static_cast<int>(gm.gmBlackBoxX);
+        const int h = static_cast<int>(gm.gmBlackBoxY);
+        int px, py;
+        if (place(f, w + 2, h + 2, px, py))
+        {
+            g.page = static_cast<uint16_t>(f.page);
+            g.x = static_cast<uint16_t>(px + 1);
+            g.y = static_cast<uint16_t>(py + 1);
+            g.w = static_cast<uint16_t>(w);
+            g.h = static_cast<uint16_t>(h);
+            g.offsetX = static_cast<int16_t>(gm.gmptGlyphOrigin.x);
+            g.offsetY = static_cast<int16_t>(f.ascent - gm.gmptGlyphOrigin.y);
+
+            // GGO_GRAY8 覆盖率为 0~64, 行按 4 字节对齐; 换算成 0~255
+            const int pitch = (w + 3) & ~3;
+            uint8_t *dest = pageBits[f.page];
+            for (int j = 0; j < h; ++j)
+            {
+                const uint8_t *src = scratch.data() + (size_t)j * pitch;
+                uint8_t *row = dest + (size_t)(g.y + j) * PAGE_SIZE + g.x;
+                for (int i = 0; i < w; ++i)
+                {
+                    row[i] = static_cast<uint8_t>((src[i] * 255 + 32) / 64);
+                }
+            }
+            pageDirty[f.page] = 1;
+        }
+    }
+    SelectObject(dc, old);
+
+    glyphTotal++;
+    return &f.glyphs.emplace(ch, g).first->second;
+}
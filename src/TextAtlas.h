@@ -0,0 +1,81 @@
+﻿#pragma once
+#include <Windows.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include "CachedImage.h"
+
+// 字形在图集页中的位置和排版信息
+struct Glyph
+{
+    uint16_t page;    // 所属图集页 (TextAtlas::page)
+    uint16_t x, y;    // 在图集页中的左上角
+    uint16_t w, h;    // 字形位图大小, 空白字符为0
+    int16_t offsetX;  // 相对笔位置的左边距
+    int16_t offsetY;  // 相对文本顶端的上边距
+    int16_t advance;  // 笔位置前进量
+};
+
+// 字形图集
+// 每个字号 (字体由字号决定) 对应一组图集页, 字形首次使用时用 GetGlyphOutlineW(GGO_GRAY8_BITMAP) 光栅化一次,
+// 只以覆盖率写入图集页, 与颜色无关: 同一字形换颜色不会再占图集, 颜色在绘制时乘上。
+// 图集页是只有覆盖率的 CachedImage, 与精灵一样带游程表, 空白处直接跳过。
+// 图集页分配后大小不变, 字形只追加不修改, 已记录的绘制命令引用的像素始终有效。
+class TextAtlas
+{
+public:
+    static const int PAGE_SIZE = 512;
+
+    TextAtlas() = default;
+    ~TextAtlas();
+
+    TextAtlas(const TextAtlas &) = delete;
+    TextAtlas &operator=(const TextAtlas &) = delete;
+
+    // 取字形, 首次使用时光栅化; font 为该字号的字体
+    const Glyph *glyph(HFONT font, float size, wchar_t ch);
+    // 文本首行的基线到顶端的距离 (与 ExtTextOutW 默认的 TA_TOP 对齐一致)
+    int ascent(HFONT font, float size);
+    // 为本帧新增了字形的图集页重建游程表, 在光栅化之前调用
+    void commit();
+
+    const CachedImage *page(int index) const
+    {
+        return pages[index].get();
+    }
+    int pageCount() const
+    {
+        return static_cast<int>(pages.size());
+    }
+    int glyphCount() const
+    {
+        return glyphTotal;
+    }
+
+    // 释放全部字形和图集页
+    void clear();
+
+private:
+    struct Face
+    {
+        std::unordered_map<wchar_t, Glyph> glyphs;
+        int ascent = 0;
+        // 当前写入的图集页和货架 (shelf) 位置
+        int page = -1;
+        int shelfX = 0;
+        int shelfY = 0;
+        int shelfH = 0;
+    };
+
+    Face &face(HFONT font, float size);
+    bool place(Face &f, int w, int h, int &x, int &y);
+
+    HDC dc = nullptr;
+    std::unordered_map<uint32_t, Face> faces; // 按字号的位模式索引
+    std::vector<std::unique_ptr<CachedImage>> pages;
+    std::vector<uint8_t *> pageBits;  // 各页可写的覆盖率
+    std::vector<uint8_t> pageDirty;   // 有新字形, 游程表待重建
+    std::vector<uint8_t> scratch;
+    int glyphTotal = 0;
+};
@@ -0,0 +1,131 @@
+﻿#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int threads)
+{
+    if (threads <= 0)
+        threads = hardwareThreads();
+    for (int i = 1; i < threads; ++i)
+    {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    wakeCv.notify_all();
+    for (auto &t : workers)
+    {
+        t.join();
+    }
+}
+
+int ThreadPool::hardwareThreads()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : static_cast<int>(n);
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)> &fn)
+{
+    if (count <= 0)
+        return;
+    // 没有工作线程或只有一个任务时直接在调用线程执行
+    if (workers.empty() || count == 1)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            fn(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        job = &fn;
+        jobCount = count;
+        nextIndex.store(0, std::memory_order_relaxed);
+        finished = 0;
+        ++generation;
+    }
+    wakeCv.notify_all();
+
+    runJobs(&fn, count);
+
+    // 等所有工作线程都退出本批次, 之后 fn 才能安全销毁
+    std::unique_lock<std::mutex> lock(mtx);
+    doneCv.wait(lock, [this]
+                { return finished == workers.size(); });
+    job = nullptr;
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    if (workers.empty())
+    {
+        task();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        tasks.push_back(std::move(task));
+    }
+    wakeCv.notify_one();
+}
+
+void ThreadPool::runJobs(const std::function<void(int)> *fn, int count)
+{
+    while (true)
+    {
+        int i = nextIndex.fetch_add(1, std::memory_order_relaxed);
+        if (i >= count)
+            break;
+        (*fn)(i);
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    uint64_t seen = 0;
+    while (true)
+    {
+        const std::function<void(int)> *fn = nullptr;
+        int count = 0;
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            wakeCv.wait(lock, [&]
+                        { return stopping || generation != seen || !tasks.empty(); });
+            if (stopping)
+                return;
+            if (generation != seen)
+            {
+                seen = generation;
+                fn = job;
+                count = jobCount;
+            }
+            else
+            {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+        }
+
+        if (!fn)
+        {
+            task();
+            continue;
+        }
+
+        runJobs(fn, count);
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (++finished == workers.size())
+                doneCv.notify_one();
+        }
+    }
+}
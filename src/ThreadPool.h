@@ -0,0 +1,58 @@
+﻿#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+
+// 简单的工作线程池
+// parallelFor 把 [0, count) 的任务分给工作线程和调用线程一起执行, 返回时全部完成。
+// submit 提交异步任务, 只由工作线程执行; 工作线程空闲时才取任务, parallelFor 批次优先。
+class ThreadPool
+{
+public:
+    // threads: 参与并行的总线程数(包含调用线程), <= 0 时取硬件线程数
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // 参与并行的总线程数(包含调用线程)
+    int size() const
+    {
+        return static_cast<int>(workers.size()) + 1;
+    }
+
+    void parallelFor(int count, const std::function<void(int)> &fn);
+
+    // 提交一个异步任务, 没有工作线程时在调用线程直接执行
+    // 析构时尚未开始的任务会被丢弃
+    void submit(std::function<void()> task);
+
+    static int hardwareThreads();
+
+private:
+    void workerLoop();
+    void runJobs(const std::function<void(int)> *fn, int count);
+
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable wakeCv;
+    std::condition_variable doneCv;
+
+    // 当前批次
+    const std::function<void(int)> *job = nullptr;
+    int jobCount = 0;
+    std::atomic<int> nextIndex{0};
+    uint64_t generation = 0;
+    // 本批次已经退出 runJobs 的工作线程数, 等于 workers.size() 时批次结束
+    size_t finished = 0;
+    bool stopping = false;
+
+    // 异步任务队列
+    std::deque<std::function<void()>> tasks;
+};
@@ -0,0 +1,112 @@
+﻿#include "TileCollision.h"
+#include <algorithm>
+#include <cmath>
+
+std::unique_ptr<TileCollision> TileCollision::WORLD = nullptr;
+
+void TileCollision::reset(int col0, int row0, int cols_, int rows_, int tileW_, int tileH_)
+{
+    originCol = col0;
+    originRow = row0;
+    cols = std::max(cols_, 0);
+    rows = std::max(rows_, 0);
+    tileW = std::max(tileW_, 1);
+    tileH = std::max(tileH_, 1);
+    words = (cols + 63) / 64;
+    bits.assign((size_t)words * rows, 0);
+    surfaceStart.assign((size_t)cols + 1, 0);
+    surfaces.clear();
+    highest.assign(cols, NO_GROUND);
+}
+
+void TileCollision::set(int col, int row)
+{
+    const int c = col - originCol, r = row - originRow;
+    if (c < 0 || c >= cols || r < 0 || r >= rows)
+        return;
+    bits[(size_t)r * words + (c >> 6)] |= uint64_t(1) << (c & 63);
+}
+
+// 实心格上方不是实心 (或是地图顶边) 时, 该格顶边为一个地面
+void TileCollision::finish()
+{
+    surfaces.clear();
+    for (int c = 0; c < cols; ++c)
+    {
+        surfaceStart[c] = static_cast<int>(surfaces.size());
+        const size_t word = c >> 6;
+        const uint64_t mask = uint64_t(1) << (c & 63);
+        bool above = false;
+        for (int r = 0; r < rows; ++r)
+        {
+            const bool solid = (bits[(size_t)r * words + word] & mask) != 0;
+            if (solid && !above)
+                surfaces.push_back((originRow + r) * tileH);
+            above = solid;
+        }
+        highest[c] = surfaces.size() > (size_t)surfaceStart[c] ? surfaces[surfaceStart[c]] : NO_GROUND;
+    }
+    surfaceStart[cols] = static_cast<int>(surfaces.size());
+}
+
+bool TileCollision::isSolid(int col, int row) const
+{
+    const int c = col - originCol, r = row - originRow;
+    if (c < 0 || c >= cols || r < 0 || r >= rows)
+        return false;
+    return (bits[(size_t)r * words + (c >> 6)] >> (c & 63)) & 1;
+}
+
+bool TileCollision::solidAt(double x, double y) const
+{
+    return isSolid(static_cast<int>(std::floor(x / tileW)), static_cast<int>(std::floor(y / tileH)));
+}
+
+// 列下标 (相对 originCol), 范围外为 -1
+int TileCollision::column(double x) const
+{
+    const double c = std::floor(x / tileW) - originCol;
+    return c >= 0 && c < cols ? static_cast<int>(c) : -1;
+}
+
+int TileCollision::groundAt(double x) const
+{
+    const int c = column(x);
+    return c < 0 ? NO_GROUND : highest[c];
+}
+
+int TileCollision::groundBelowColumn(int c, int y) const
+{
+    // 一列通常只有一两个地面, 顺序找即可
+    for (int i = surfaceStart[c], end = surfaceStart[c + 1]; i < end; ++i)
+    {
+        if (surfaces[i] >= y)
+            return surfaces[i];
+    }
+    return NO_GROUND;
+}
+
+int TileCollision::groundBelow(double x, double y) const
+{
+    const int c = column(x);
+    return c < 0 ? NO_GROUND : groundBelowColumn(c, static_cast<int>(std::ceil(y)));
+}
+
+int TileCollision::groundBelow(double x0, double x1, double y) const
+{
+    if (cols == 0 || x1 <= x0)
+        return groundBelow(x0, y);
+    // 只看地图范围内的列
+    const int c0 = std::max(static_cast<int>(std::floor(x0 / tileW)) - originCol, 0);
+    const int c1 = std::min(static_cast<int>(std::ceil(x1 / tileW)) - originCol, cols);
+    const int feet = static_cast<int>(std::ceil(y));
+    int best = NO_GROUND;
+    for (int c = c0; c < c1; ++c)
+    {
+        // 没有地面的列
+        if (highest[c] == NO_GROUND)
+            continue;
+        best = std::min(best, groundBelowColumn(c, feet));
+    }
+    return best;
+}
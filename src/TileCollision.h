@@ -0,0 +1,66 @@
+﻿#pragma once
+#include <climits>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+// 静态地形碰撞
+// 由 Tilemap::bakeCollision 把碰撞层的实心格烘焙成整张地图的位图 (每格1位),
+// 再按列整理出每段连续实心格的顶面 (地面高度)。角色落地只查这里, 关卡地形不进入 Broadphase::WORLD。
+// 地面是单向的: 只挡住从上方落下的角色, 从下方跳起可以穿过。
+class TileCollision
+{
+public:
+    static std::unique_ptr<TileCollision> WORLD;
+
+    // 没有地面时的返回值
+    static constexpr int NO_GROUND = INT_MAX;
+
+    // 清空并设定范围 (格子), 之后用 set 标记实心格, 最后 finish 生成地面表
+    void reset(int col0, int row0, int cols, int rows, int tileW, int tileH);
+    void set(int col, int row);
+    void finish();
+
+    int left() const
+    {
+        return originCol * tileW;
+    }
+    int top() const
+    {
+        return originRow * tileH;
+    }
+    int right() const
+    {
+        return (originCol + cols) * tileW;
+    }
+    int bottom() const
+    {
+        return (originRow + rows) * tileH;
+    }
+
+    // 格子坐标与 Tilemap 相同, 范围外不是实心
+    bool isSolid(int col, int row) const;
+    // 世界坐标 (像素)
+    bool solidAt(double x, double y) const;
+    // x 所在列最高的地面, O(1)
+    int groundAt(double x) const;
+    // x 所在列在 y 处或 y 以下的第一个地面
+    int groundBelow(double x, double y) const;
+    // [x0, x1) 覆盖的各列中最高的 groundBelow, 用于有宽度的角色脚下
+    int groundBelow(double x0, double x1, double y) const;
+
+private:
+    int column(double x) const;
+    int groundBelowColumn(int col, int y) const;
+
+    int originCol = 0, originRow = 0;
+    int cols = 0, rows = 0;
+    int tileW = 1, tileH = 1;
+    int words = 0;              // 每行的 uint64 个数
+    std::vector<uint64_t> bits; // 实心位, 按行排列
+
+    // 每列的地面 (实心段顶面的世界 y, 从上到下), 列 c 的地面为 surfaces[surfaceStart[c], surfaceStart[c + 1])
+    std::vector<int> surfaceStart;
+    std::vector<int> surfaces;
+    std::vector<int> highest; // 每列最高的地面, 无为 NO_GROUND
+};
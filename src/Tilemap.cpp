@@ -0,0 +1,1172 @@
+﻿#include "Tilemap.h"
+#include "GDI.h"
+#include "TileCollision.h"
+#include "Blend.h"
+#include <algorithm>
+#include <climits>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace fs = std::filesystem;
+
+// 只支持 Tiled 输出用到的 XML 子集: 元素, 属性, 文本, 实体和 CDATA; 声明/注释/DOCTYPE 跳过
+struct Tilemap::XmlNode
+{
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> attrs;
+    std::string text;
+    std::vector<XmlNode> children;
+    size_t begin = 0, end = 0; // 内容 (开始标签与结束标签之间) 在源文本中的范围
+
+    const std::string *attr(std::string_view key) const
+    {
+        for (const auto &[k, v] : attrs)
+        {
+            if (k == key)
+                return &v;
+        }
+        return nullptr;
+    }
+    int intAttr(std::string_view key, int def = 0) const
+    {
+        const std::string *v = attr(key);
+        return v ? std::atoi(v->c_str()) : def;
+    }
+    double floatAttr(std::string_view key, double def) const
+    {
+        const std::string *v = attr(key);
+        return v ? std::atof(v->c_str()) : def;
+    }
+    const XmlNode *child(std::string_view tag) const
+    {
+        for (const XmlNode &c : children)
+        {
+            if (c.name == tag)
+                return &c;
+        }
+        return nullptr;
+    }
+
+    static bool parse(std::string_view src, XmlNode &root, std::string &error);
+
+private:
+    static bool parseElement(std::string_view src, size_t &pos, XmlNode &node, std::string &error);
+};
+
+namespace
+{
+    bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    void skipSpace(std::string_view src, size_t &pos)
+    {
+        while (pos < src.size() && isSpace(src[pos]))
+            pos++;
+    }
+
+    // 跳过到 end 之后, 找不到返回 false
+    bool skipPast(std::string_view src, size_t &pos, std::string_view end)
+    {
+        size_t at = src.find(end, pos);
+        if (at == std::string_view::npos)
+            return false;
+        pos = at + end.size();
+        return true;
+    }
+
+    void appendUtf8(std::string &out, uint32_t cp)
+    {
+        if (cp < 0x80)
+            out += static_cast<char>(cp);
+        else if (cp < 0x800)
+        {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000)
+        {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    // 追加文本并展开实体, 无法识别的实体原样保留
+    void appendDecoded(std::string &out, std::string_view raw)
+    {
+        size_t pos = 0;
+        while (pos < raw.size())
+        {
+            size_t amp = raw.find('&', pos);
+            size_t semi = amp == std::string_view::npos ? amp : raw.find(';', amp);
+            if (semi == std::string_view::npos)
+            {
+                out.append(raw.substr(pos));
+                return;
+            }
+            out.append(raw.substr(pos, amp - pos));
+            std::string_view name = raw.substr(amp + 1, semi - amp - 1);
+            if (name == "lt")
+                out += '<';
+            else if (name == "gt")
+                out += '>';
+            else if (name == "amp")
+                out += '&';
+            else if (name == "quot")
+                out += '"';
+            else if (name == "apos")
+                out += '\'';
+            else if (name.size() > 1 && name[0] == '#')
+            {
+                const bool hex = name[1] == 'x' || name[1] == 'X';
+                std::string digits(name.substr(hex ? 2 : 1));
+                appendUtf8(out, static_cast<uint32_t>(std::strtoul(digits.c_str(), nullptr, hex ? 16 : 10)));
+            }
+            else
+                out.append(raw.substr(amp, semi - amp + 1));
+            pos = semi + 1;
+        }
+    }
+
+    int floorDiv(int a, int b)
+    {
+        int q = a / b;
+        return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+    }
+
+    int ceilDiv(int a, int b)
+    {
+        return -floorDiv(-a, b);
+    }
+
+    // UTF-8 字符串转路径 (C++20 中 fs::u8path 已弃用)
+    fs::path utf8Path(std::string_view s)
+    {
+        return fs::path(std::u8string(reinterpret_cast<const char8_t *>(s.data()), s.size()));
+    }
+
+    // dir / rel 规范化后的名字 ('/' 分隔, UTF-8), 与资源包中的名字一致
+    std::string joinName(const std::string &dir, const std::string &rel)
+    {
+        auto u8 = (utf8Path(dir) / utf8Path(rel)).lexically_normal().generic_u8string();
+        return std::string(reinterpret_cast<const char *>(u8.data()), u8.size());
+    }
+
+    std::string parentName(const std::string &name)
+    {
+        size_t slash = name.find_last_of('/');
+        return slash == std::string::npos ? std::string() : name.substr(0, slash);
+    }
+
+    bool readFile(const fs::path &path, std::string &out)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    bool decodeBase64(std::string_view text, std::vector<uint8_t> &out)
+    {
+        uint32_t bits = 0;
+        int count = 0;
+        for (char c : text)
+        {
+            int v;
+            if (c >= 'A' && c <= 'Z')
+                v = c - 'A';
+            else if (c >= 'a' && c <= 'z')
+                v = c - 'a' + 26;
+            else if (c >= '0' && c <= '9')
+                v = c - '0' + 52;
+            else if (c == '+')
+                v = 62;
+            else if (c == '/')
+                v = 63;
+            else if (c == '=' || isSpace(c))
+                continue;
+            else
+                return false;
+            bits = (bits << 6) | v;
+            count += 6;
+            if (count >= 8)
+            {
+                count -= 8;
+                out.push_back(static_cast<uint8_t>(bits >> count));
+            }
+        }
+        return true;
+    }
+
+    // 图层数据 (CSV 或未压缩的 Base64) 解码为 GID
+    bool decodeGids(std::string_view text, bool base64, std::vector<uint32_t> &out)
+    {
+        out.clear();
+        if (base64)
+        {
+            std::vector<uint8_t> bytes;
+            if (!decodeBase64(text, bytes))
+                return false;
+            for (size_t i = 0; i + 3 < bytes.size(); i += 4)
+                out.push_back(bytes[i] | (bytes[i + 1] << 8) | (bytes[i + 2] << 16) | ((uint32_t)bytes[i + 3] << 24));
+            return true;
+        }
+        uint32_t value = 0;
+        bool inNumber = false;
+        for (char c : text)
+        {
+            if (c >= '0' && c <= '9')
+            {
+                value = value * 10 + (c - '0');
+                inNumber = true;
+            }
+            else if (inNumber)
+            {
+                out.push_back(value);
+                value = 0;
+                inNumber = false;
+            }
+        }
+        if (inNumber)
+            out.push_back(value);
+        return true;
+    }
+
+    // 预乘像素整体乘以图层不透明度
+    inline uint32_t fade(uint32_t pixel, uint32_t opacity)
+    {
+        uint32_t a = ((pixel >> 24) * opacity + 127) / 255;
+        uint32_t r = (((pixel >> 16) & 0xFF) * opacity + 127) / 255;
+        uint32_t g = (((pixel >> 8) & 0xFF) * opacity + 127) / 255;
+        uint32_t b = ((pixel & 0xFF) * opacity + 127) / 255;
+        return (a << 24) | (r << 16) | (g << 8) | b;
+    }
+
+    // 颜色与 Blend::pixel 一致; 烘焙块的底色可能仍是半透明, 另外按 over 运算保留 alpha
+    inline uint32_t over(uint32_t dest, uint32_t src)
+    {
+        const uint32_t a = src >> 24;
+        if (a == 255)
+            return src;
+        if (a == 0)
+            return dest;
+        const uint32_t destA = dest >> 24;
+        return (Blend::pixel(dest, src) & 0x00FFFFFF) | ((a + destA * (255 - a) / 255) << 24);
+    }
+}
+
+bool Tilemap::XmlNode::parse(std::string_view src, XmlNode &root, std::string &error)
+{
+    size_t pos = 0;
+    if (src.substr(0, 3) == "\xEF\xBB\xBF")
+        pos = 3;
+    while (true)
+    {
+        skipSpace(src, pos);
+        if (pos >= src.size())
+        {
+            error = "no root element";
+            return false;
+        }
+        if (src.substr(pos, 2) == "<?")
+        {
+            if (!skipPast(src, pos, "?>"))
+                break;
+        }
+        else if (src.substr(pos, 4) == "<!--")
+        {
+            if (!skipPast(src, pos, "-->"))
+                break;
+        }
+        else if (src.substr(pos, 2) == "<!")
+        {
+            if (!skipPast(src, pos, ">"))
+                break;
+        }
+        else if (src[pos] == '<')
+            return parseElement(src, pos, root, error);
+        else
+        {
+            error = "unexpected text at offset " + std::to_string(pos);
+            return false;
+        }
+    }
+    error = "unexpected end of file";
+    return false;
+}
+
+bool Tilemap::XmlNode::parseElement(std::string_view src, size_t &pos, XmlNode &node, std::string &error)
+{
+    auto isNameEnd = [](char c)
+    { return isSpace(c) || c == '/' || c == '>' || c == '='; };
+
+    pos++; // '<'
+    size_t start = pos;
+    while (pos < src.size() && !isNameEnd(src[pos]))
+        pos++;
+    node.name.assign(src.substr(start, pos - start));
+    if (node.name.empty())
+    {
+        error = "missing element name at offset " + std::to_string(start);
+        return false;
+    }
+
+    // 属性
+    while (true)
+    {
+        skipSpace(src, pos);
+        if (pos >= src.size())
+        {
+            error = "unexpected end of file in <" + node.name + ">";
+            return false;
+        }
+        if (src[pos] == '/')
+        {
+            if (src.substr(pos, 2) != "/>")
+            {
+                error = "malformed <" + node.name + "> at offset " + std::to_string(pos);
+                return false;
+            }
+            pos += 2;
+            node.begin = node.end = pos;
+            return true;
+        }
+        if (src[pos] == '>')
+        {
+            pos++;
+            node.begin = pos;
+            break;
+        }
+        start = pos;
+        while (pos < src.size() && !isNameEnd(src[pos]))
+            pos++;
+        std::string key(src.substr(start, pos - start));
+        skipSpace(src, pos);
+        if (key.empty() || pos + 1 >= src.size() || src[pos] != '=')
+        {
+            error = "malformed attribute in <" + node.name + "> at offset " + std::to_string(start);
+            return false;
+        }
+        pos++;
+        skipSpace(src, pos);
+        const char quote = pos < src.size() ? src[pos] : 0;
+        size_t end = (quote == '"' || quote == '\'') ? src.find(quote, pos + 1) : std::string_view::npos;
+        if (end == std::string_view::npos)
+        {
+            error = "malformed attribute in <" + node.name + "> at offset " + std::to_string(start);
+            return false;
+        }
+        std::string value;
+        appendDecoded(value, src.substr(pos + 1, end - pos - 1));
+        node.attrs.emplace_back(std::move(key), std::move(value));
+        pos = end + 1;
+    }
+
+    // 内容: 文本和子元素, 直到匹配的结束标签
+    while (pos < src.size())
+    {
+        size_t lt = src.find('<', pos);
+        if (lt == std::string_view::npos)
+            break;
+        appendDecoded(node.text, src.substr(pos, lt - pos));
+        pos = lt;
+        if (src.substr(pos, 2) == "</")
+        {
+            node.end = pos;
+            pos += 2;
+            start = pos;
+            while (pos < src.size() && !isNameEnd(src[pos]))
+                pos++;
+            if (src.substr(start, pos - start) != node.name)
+            {
+                error = "mismatched </" + std::string(src.substr(start, pos - start)) + "> for <" + node.name + ">";
+                return false;
+            }
+            if (!skipPast(src, pos, ">"))
+                break;
+            return true;
+        }
+        if (src.substr(pos, 4) == "<!--")
+        {
+            if (!skipPast(src, pos, "-->"))
+                break;
+        }
+        else if (src.substr(pos, 9) == "<![CDATA[")
+        {
+            size_t end = src.find("]]>", pos + 9);
+            if (end == std::string_view::npos)
+                break;
+            node.text.append(src.substr(pos + 9, end - pos - 9));
+            pos = end + 3;
+        }
+        else if (src.substr(pos, 2) == "<?" || src.substr(pos, 2) == "<!")
+        {
+            if (!skipPast(src, pos, ">"))
+                break;
+        }
+        else
+        {
+            node.children.emplace_back();
+            if (!parseElement(src, pos, node.children.back(), error))
+                return false;
+        }
+    }
+    error = "unexpected end of file in <" + node.name + ">";
+    return false;
+}
+
+Tilemap::~Tilemap()
+{
+    clear();
+}
+
+void Tilemap::clear()
+{
+    // 先停掉烘焙线程: 等正在烘焙的块完成, 丢弃还没开始的任务
+    bakePool.reset();
+    finishedBakes.clear();
+    chunks.clear();
+    loaded = false;
+    infinite = false;
+    filePath.clear();
+    originCol = originRow = 0;
+    cols = rows = 0;
+    tileW = tileH = 0;
+    layers.clear();
+    tiles.clear();
+    images.clear();
+    chunkX0 = chunkY0 = chunkX1 = chunkY1 = 0;
+    frame = 0;
+    chunkStats = {};
+}
+
+bool Tilemap::fail(std::string message)
+{
+    lastError = std::move(message);
+    clear();
+    return false;
+}
+
+bool Tilemap::load(const std::string &root, const std::string &path, const SpritePack &pack)
+{
+    clear();
+    lastError.clear();
+    if (!pack.isOpen())
+        return fail("sprite pack is not open");
+
+    // 地图和 .tsx 都按相对 root 的名字处理, 图块集图像的名字与资源包一致
+    auto readXml = [&](const std::string &name, XmlNode &doc)
+    {
+        std::string text, error;
+        if (!readFile(utf8Path(root) / utf8Path(name), text))
+            return fail("cannot read " + name);
+        if (!XmlNode::parse(text, doc, error))
+            return fail(name + ": " + error);
+        return true;
+    };
+
+    XmlNode map;
+    if (!readXml(path, map))
+        return false;
+    if (map.name != "map")
+        return fail(path + ": not a Tiled map");
+    const std::string *orientation = map.attr("orientation");
+    if (!orientation || *orientation != "orthogonal")
+        return fail(path + ": only orthogonal maps are supported");
+    infinite = map.intAttr("infinite") != 0;
+    cols = map.intAttr("width");
+    rows = map.intAttr("height");
+    tileW = map.intAttr("tilewidth");
+    tileH = map.intAttr("tileheight");
+    if (cols <= 0 || rows <= 0 || tileW <= 0 || tileH <= 0)
+        return fail(path + ": invalid map size");
+    if (infinite)
+    {
+        auto u8 = (utf8Path(root) / utf8Path(path)).u8string();
+        filePath.assign(reinterpret_cast<const char *>(u8.data()), u8.size());
+    }
+
+    const std::string dir = parentName(joinName("", path));
+    for (const XmlNode &element : map.children)
+    {
+        if (element.name == "tileset")
+        {
+            const uint32_t firstGid = static_cast<uint32_t>(element.intAttr("firstgid"));
+            if (firstGid == 0)
+                return fail(path + ": tileset without firstgid");
+            if (const std::string *source = element.attr("source"))
+            {
+                const std::string name = joinName(dir, *source);
+                XmlNode tileset;
+                if (!readXml(name, tileset))
+                    return false;
+                if (!loadTileset(parentName(name), tileset, firstGid, pack))
+                    return false;
+            }
+            else if (!loadTileset(dir, element, firstGid, pack))
+                return false;
+        }
+        else if (element.name == "layer")
+        {
+            if (!loadLayer(element))
+                return false;
+        }
+        // 对象层/图像层/图层组不参与绘制
+    }
+
+    // 无限地图的范围取所有 <chunk> 的包围盒
+    if (infinite)
+    {
+        int col0 = INT_MAX, row0 = INT_MAX, col1 = INT_MIN, row1 = INT_MIN;
+        for (const Layer &layer : layers)
+        {
+            for (const SourceChunk &src : layer.sources)
+            {
+                col0 = std::min(col0, src.col);
+                row0 = std::min(row0, src.row);
+                col1 = std::max(col1, src.col + layer.sourceCols);
+                row1 = std::max(row1, src.row + layer.sourceRows);
+            }
+        }
+        if (col0 > col1)
+            col0 = row0 = col1 = row1 = 0;
+        originCol = col0;
+        originRow = row0;
+        cols = col1 - col0;
+        rows = row1 - row0;
+    }
+
+    chunkX0 = floorDiv(left(), CHUNK_SIZE);
+    chunkY0 = floorDiv(top(), CHUNK_SIZE);
+    chunkX1 = ceilDiv(left() + width(), CHUNK_SIZE);
+    chunkY1 = ceilDiv(top() + height(), CHUNK_SIZE);
+    chunkStats.chunks = (chunkX1 - chunkX0) * (chunkY1 - chunkY0);
+    bakePool = std::make_unique<ThreadPool>(2);
+    loaded = true;
+    return true;
+}
+
+const CachedImage *Tilemap::bindImage(const std::string &name, const SpritePack &pack)
+{
+    const SpritePackEntry *entry = pack.find(name);
+    if (!entry)
+    {
+        fail("image not in sprite pack: " + name);
+        return nullptr;
+    }
+    auto img = std::make_unique<CachedImage>();
+    pack.bind(*entry, *img);
+    images.push_back(std::move(img));
+    return images.back().get();
+}
+
+bool Tilemap::loadTileset(const std::string &dir, const XmlNode &element, uint32_t firstGid, const SpritePack &pack)
+{
+    const int tw = element.intAttr("tilewidth");
+    const int th = element.intAttr("tileheight");
+    auto setTile = [&](int id, const Tile &t)
+    {
+        const size_t index = firstGid + (size_t)id;
+        if (index > GID_MASK)
+            return;
+        if (tiles.size() <= index)
+            tiles.resize(index + 1);
+        tiles[index] = t;
+    };
+
+    // 整张图切格的图块集
+    if (const XmlNode *image = element.child("image"))
+    {
+        const std::string *source = image->attr("source");
+        if (!source || tw <= 0 || th <= 0)
+            return fail("tileset in " + dir + ": missing image or tile size");
+        const CachedImage *img = bindImage(joinName(dir, *source), pack);
+        if (!img)
+            return false;
+        const int margin = element.intAttr("margin");
+        const int spacing = element.intAttr("spacing");
+        int columns = element.intAttr("columns");
+        if (columns <= 0)
+            columns = std::max(1, (img->width - 2 * margin + spacing) / (tw + spacing));
+        const int imageRows = std::max(1, (img->height - 2 * margin + spacing) / (th + spacing));
+        const int count = element.intAttr("tilecount", columns * imageRows);
+        for (int id = 0; id < count; ++id)
+        {
+            Tile t{img, margin + (id % columns) * (tw + spacing), margin + (id / columns) * (th + spacing), tw, th};
+            if (t.srcX + tw <= img->width && t.srcY + th <= img->height)
+                setTile(id, t);
+        }
+    }
+
+    // 图像集合: 每个图块一张图, 大小可以各不相同
+    for (const XmlNode &child : element.children)
+    {
+        if (child.name != "tile")
+            continue;
+        const XmlNode *image = child.child("image");
+        const std::string *source = image ? image->attr("source") : nullptr;
+        if (!source)
+            continue; // 只有属性/动画的图块
+        const CachedImage *img = bindImage(joinName(dir, *source), pack);
+        if (!img)
+            return false;
+        setTile(child.intAttr("id"), Tile{img, 0, 0, img->width, img->height});
+    }
+    return true;
+}
+
+bool Tilemap::loadLayer(const XmlNode &element)
+{
+    Layer layer;
+    if (const std::string *name = element.attr("name"))
+        layer.name = *name;
+    layer.visible = element.intAttr("visible", 1) != 0;
+    layer.opacity = static_cast<uint8_t>(std::clamp(element.floatAttr("opacity", 1.0), 0.0, 1.0) * 255 + 0.5);
+    layer.maxTileW = tileW;
+    layer.maxTileH = tileH;
+    if (const XmlNode *properties = element.child("properties"))
+    {
+        for (const XmlNode &property : properties->children)
+        {
+            const std::string *name = property.attr("name");
+            const std::string *value = property.attr("value");
+            if (name && value && *name == "collision")
+                layer.collision = *value == "true";
+        }
+    }
+
+    const XmlNode *data = element.child("data");
+    if (!data)
+        return fail("layer " + layer.name + ": missing data");
+    if (data->attr("compression"))
+        return fail("layer " + layer.name + ": compressed layer data is not supported, save the map as CSV or uncompressed Base64");
+    const std::string *encoding = data->attr("encoding");
+    if (encoding && *encoding != "csv" && *encoding != "base64")
+        return fail("layer " + layer.name + ": unknown encoding " + *encoding);
+    layer.base64 = encoding && *encoding == "base64";
+
+    // 记录本层用到的最大图块 (对角翻转后宽高互换)
+    auto measure = [&](const std::vector<uint32_t> &gids)
+    {
+        for (uint32_t id : gids)
+        {
+            if (const Tile *t = tile(id))
+            {
+                const bool diag = (id & FLIP_D) != 0;
+                layer.maxTileW = std::max(layer.maxTileW, diag ? t->h : t->w);
+                layer.maxTileH = std::max(layer.maxTileH, diag ? t->w : t->h);
+            }
+        }
+    };
+
+    if (infinite)
+    {
+        // 只记录每个 <chunk> 的位置; 这里解码一次用于校验和统计图块大小, 之后丢弃
+        std::vector<uint32_t> gids;
+        for (const XmlNode &chunk : data->children)
+        {
+            if (chunk.name != "chunk")
+                continue;
+            const int x = chunk.intAttr("x"), y = chunk.intAttr("y");
+            const int w = chunk.intAttr("width"), h = chunk.intAttr("height");
+            if (layer.sources.empty())
+            {
+                layer.sourceCols = w;
+                layer.sourceRows = h;
+            }
+            if (w <= 0 || h <= 0 || w != layer.sourceCols || h != layer.sourceRows ||
+                floorDiv(x, w) * w != x || floorDiv(y, h) * h != y)
+                return fail("layer " + layer.name + ": chunks must share one size and be aligned to it");
+            if (!decodeGids(chunk.text, layer.base64, gids) || gids.size() != (size_t)w * h)
+                return fail("layer " + layer.name + ": invalid chunk data at " + std::to_string(x) + "," + std::to_string(y));
+            measure(gids);
+            layer.sourceIndex[cellKey(floorDiv(x, w), floorDiv(y, h))] = static_cast<uint32_t>(layer.sources.size());
+            layer.sources.push_back({x, y, chunk.begin, chunk.end});
+        }
+        layers.push_back(std::move(layer));
+        return true;
+    }
+
+    if (element.intAttr("width") != cols || element.intAttr("height") != rows)
+        return fail("layer " + layer.name + ": size differs from map");
+    const size_t count = (size_t)cols * rows;
+    if (!encoding)
+    {
+        // 旧格式: 每格一个 <tile gid=".."/>
+        for (const XmlNode &t : data->children)
+        {
+            if (t.name == "tile")
+                layer.gids.push_back(static_cast<uint32_t>(std::strtoul(t.attr("gid") ? t.attr("gid")->c_str() : "0", nullptr, 10)));
+        }
+    }
+    else if (!decodeGids(data->text, layer.base64, layer.gids))
+        return fail("layer " + layer.name + ": invalid base64 data");
+    if (layer.gids.size() != count)
+        return fail("layer " + layer.name + ": expected " + std::to_string(count) + " tiles, got " + std::to_string(layer.gids.size()));
+    measure(layer.gids);
+    layers.push_back(std::move(layer));
+    return true;
+}
+
+const Tilemap::Tile *Tilemap::tile(uint32_t gid) const
+{
+    const uint32_t index = gid & GID_MASK;
+    if (index == 0 || index >= tiles.size() || !tiles[index].img)
+        return nullptr;
+    return &tiles[index];
+}
+
+int Tilemap::findLayer(std::string_view name) const
+{
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        if (layers[i].name == name)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+uint32_t Tilemap::gid(int layer, int col, int row) const
+{
+    if (infinite || layer < 0 || layer >= layerCount() || col < 0 || col >= cols || row < 0 || row >= rows)
+        return 0;
+    return layers[layer].gids[(size_t)row * cols + col];
+}
+
+void Tilemap::setCollisionLayer(int layer, bool solid)
+{
+    if (layer >= 0 && layer < layerCount())
+        layers[layer].collision = solid;
+}
+
+// 格子属于其左上角所在的块
+bool Tilemap::isResident(int col, int row) const
+{
+    const Chunk *chunk = findChunk(floorDiv(col * tileW, CHUNK_SIZE), floorDiv(row * tileH, CHUNK_SIZE));
+    return chunk && chunk->key != 0;
+}
+
+bool Tilemap::isSolid(int col, int row) const
+{
+    const Chunk *chunk = findChunk(floorDiv(col * tileW, CHUNK_SIZE), floorDiv(row * tileH, CHUNK_SIZE));
+    if (!chunk || chunk->key == 0)
+        return false;
+    const int c = col - chunk->solidCol, r = row - chunk->solidRow;
+    if (c < 0 || c >= chunk->solidCols || r < 0 || r >= chunk->solidRows)
+        return false;
+    const size_t bit = (size_t)r * chunk->solidCols + c;
+    return (chunk->solid[bit >> 6] >> (bit & 63)) & 1;
+}
+
+bool Tilemap::bakeCollision(TileCollision &out) const
+{
+    out.reset(originCol, originRow, cols, rows, tileW, tileH);
+    if (!loaded)
+        return false;
+    std::ifstream file;
+    if (infinite)
+        file.open(utf8Path(filePath), std::ios::binary);
+
+    // 无限地图按 <chunk> 的行高分段读取, 每个 <chunk> 只解码一次
+    std::vector<uint32_t> grid;
+    for (const Layer &layer : layers)
+    {
+        if (!layer.collision)
+            continue;
+        const int band = infinite ? layer.sourceRows : rows;
+        for (int row0 = originRow; row0 < originRow + rows; row0 += band)
+        {
+            const int h = std::min(band, originRow + rows - row0);
+            if (!readLayer(layer, infinite ? &file : nullptr, originCol, row0, cols, h, grid))
+            {
+                out.reset(originCol, originRow, 0, 0, tileW, tileH);
+                return false;
+            }
+            for (int r = 0; r < h; ++r)
+            {
+                const uint32_t *line = grid.data() + (size_t)r * cols;
+                for (int c = 0; c < cols; ++c)
+                {
+                    if (line[c] & GID_MASK)
+                        out.set(originCol + c, row0 + r);
+                }
+            }
+        }
+    }
+    out.finish();
+    return true;
+}
+
+Tilemap::Chunk *Tilemap::findChunk(int cx, int cy) const
+{
+    auto it = chunks.find(cellKey(cx, cy));
+    return it == chunks.end() ? nullptr : it->second.get();
+}
+
+// 取出 [col0, col0 + w) × [row0, row0 + h) 的 GID, 地图外为0
+// 无限地图从文件读取覆盖该范围的 <chunk> 再解码, 只在烘焙时调用
+bool Tilemap::readLayer(const Layer &layer, std::istream *file, int col0, int row0, int w, int h, std::vector<uint32_t> &out) const
+{
+    out.assign((size_t)w * h, 0);
+    if (!infinite)
+    {
+        for (int r = 0; r < h; ++r)
+        {
+            const uint32_t *src = layer.gids.data() + (size_t)(row0 + r - originRow) * cols + (col0 - originCol);
+            std::copy(src, src + w, out.begin() + (size_t)r * w);
+        }
+        return true;
+    }
+    if (!file || layer.sources.empty())
+        return false;
+
+    std::string text;
+    std::vector<uint32_t> gids;
+    const int sw = layer.sourceCols, sh = layer.sourceRows;
+    for (int sy = floorDiv(row0, sh); sy <= floorDiv(row0 + h - 1, sh); ++sy)
+    {
+        for (int sx = floorDiv(col0, sw); sx <= floorDiv(col0 + w - 1, sw); ++sx)
+        {
+            auto it = layer.sourceIndex.find(cellKey(sx, sy));
+            if (it == layer.sourceIndex.end())
+                continue;
+            const SourceChunk &src = layer.sources[it->second];
+            text.resize(src.end - src.begin);
+            file->clear();
+            file->seekg(static_cast<std::streamoff>(src.begin));
+            if (!file->read(text.data(), static_cast<std::streamsize>(text.size())) ||
+                !decodeGids(text, layer.base64, gids) || gids.size() != (size_t)sw * sh)
+                return false;
+            // 与请求范围的交集
+            const int c0 = std::max(col0, src.col), c1 = std::min(col0 + w, src.col + sw);
+            const int r0 = std::max(row0, src.row), r1 = std::min(row0 + h, src.row + sh);
+            for (int r = r0; r < r1; ++r)
+            {
+                const uint32_t *from = gids.data() + (size_t)(r - src.row) * sw + (c0 - src.col);
+                std::copy(from, from + (c1 - c0), out.begin() + (size_t)(r - row0) * w + (c0 - col0));
+            }
+        }
+    }
+    return true;
+}
+
+// 按 Tiled 的 right-down 顺序把各可见图层的图块合成到块图像上, 并记录碰撞层的实心格
+// 图块以格子左下角为锚点, 比格子大的图块向右上延伸, 所以要多看左边和下边几格
+// 在烘焙线程 (或 Block 策略下的主线程) 执行, 只读地图数据, 只写 chunk 中烘焙线程负责的字段
+void Tilemap::bake(Chunk &chunk) const
+{
+    const auto start = std::chrono::steady_clock::now();
+    const int x0 = chunk.cx * CHUNK_SIZE;
+    const int y0 = chunk.cy * CHUNK_SIZE;
+    // 块图像只覆盖地图范围内的部分
+    const int bx0 = std::max(x0, left()), bx1 = std::min(x0 + CHUNK_SIZE, left() + width());
+    const int by0 = std::max(y0, top()), by1 = std::min(y0 + CHUNK_SIZE, top() + height());
+    const int cw = bx1 - bx0;
+    const int ch = by1 - by0;
+
+    auto image = std::make_unique<CachedImage>();
+    uint32_t *dest = image->allocate(cw, ch); // 初始全透明
+    std::vector<uint32_t> scratch(cw);        // 一行源像素 (翻转/透明度处理后)
+    std::vector<uint32_t> grid;
+    bool drawn = false;
+
+    // 本块的碰撞格: 左上角落在块内的格子
+    chunk.solidCol = std::max(originCol, ceilDiv(x0, tileW));
+    chunk.solidRow = std::max(originRow, ceilDiv(y0, tileH));
+    chunk.solidCols = std::max(0, std::min(originCol + cols, ceilDiv(x0 + CHUNK_SIZE, tileW)) - chunk.solidCol);
+    chunk.solidRows = std::max(0, std::min(originRow + rows, ceilDiv(y0 + CHUNK_SIZE, tileH)) - chunk.solidRow);
+    chunk.solid.assign(((size_t)chunk.solidCols * chunk.solidRows + 63) / 64, 0);
+
+    std::ifstream file;
+    if (infinite)
+        file.open(utf8Path(filePath), std::ios::binary);
+
+    for (const Layer &layer : layers)
+    {
+        const bool visible = layer.visible && layer.opacity > 0;
+        if (!visible && !layer.collision)
+            continue;
+        const int col0 = std::max(originCol, floorDiv(bx0 - layer.maxTileW, tileW) + 1);
+        const int col1 = std::min(originCol + cols, ceilDiv(bx1, tileW));
+        const int row0 = std::max(originRow, floorDiv(by0, tileH));
+        const int row1 = std::min(originRow + rows, ceilDiv(by1 + layer.maxTileH, tileH) - 1);
+        if (col0 >= col1 || row0 >= row1)
+            continue;
+        const int gridW = col1 - col0;
+        if (!readLayer(layer, infinite ? &file : nullptr, col0, row0, gridW, row1 - row0, grid))
+            continue;
+
+        if (layer.collision)
+        {
+            for (int r = 0; r < chunk.solidRows; ++r)
+            {
+                for (int c = 0; c < chunk.solidCols; ++c)
+                {
+                    const int gc = chunk.solidCol + c - col0, gr = chunk.solidRow + r - row0;
+                    if (gc < 0 || gc >= gridW || gr < 0 || gr >= row1 - row0 || (grid[(size_t)gr * gridW + gc] & GID_MASK) == 0)
+                        continue;
+                    const size_t bit = (size_t)r * chunk.solidCols + c;
+                    chunk.solid[bit >> 6] |= 1ull << (bit & 63);
+                }
+            }
+        }
+        if (!visible)
+            continue;
+
+        for (int row = row0; row < row1; ++row)
+        {
+            const uint32_t *line = grid.data() + (size_t)(row - row0) * gridW - col0;
+            for (int col = col0; col < col1; ++col)
+            {
+                const uint32_t id = line[col];
+                const Tile *t = tile(id);
+                if (!t)
+                    continue;
+                const bool diag = (id & FLIP_D) != 0;
+                const int dw = diag ? t->h : t->w;
+                const int dh = diag ? t->w : t->h;
+                const int tx = col * tileW;
+                const int ty = (row + 1) * tileH - dh;
+                const int ix0 = std::max(tx, bx0), ix1 = std::min(tx + dw, bx1);
+                const int iy0 = std::max(ty, by0), iy1 = std::min(ty + dh, by1);
+                if (ix0 >= ix1 || iy0 >= iy1)
+                    continue;
+                drawn = true;
+
+                const CachedImage *img = t->img;
+                const bool plain = (id & (FLIP_H | FLIP_V | FLIP_D)) == 0 && layer.opacity == 255;
+                for (int y = iy0; y < iy1; ++y)
+                {
+                    const int v = y - ty;
+                    uint32_t *out = dest + (size_t)(y - by0) * cw + (ix0 - bx0);
+                    const uint32_t *src;
+                    if (plain)
+                        src = img->pixels + (size_t)(t->srcY + v) * img->width + t->srcX + (ix0 - tx);
+                    else
+                    {
+                        // Tiled 先对角翻转再水平/垂直翻转, 反过来求源像素
+                        for (int x = ix0; x < ix1; ++x)
+                        {
+                            int u = x - tx, w = v;
+                            if (id & FLIP_H)
+                                u = dw - 1 - u;
+                            if (id & FLIP_V)
+                                w = dh - 1 - w;
+                            if (diag)
+                                std::swap(u, w);
+                            uint32_t pixel = img->pixels[(size_t)(t->srcY + w) * img->width + t->srcX + u];
+                            scratch[x - ix0] = layer.opacity == 255 ? pixel : fade(pixel, layer.opacity);
+                        }
+                        src = scratch.data();
+                    }
+                    for (int i = 0; i < ix1 - ix0; ++i)
+                        out[i] = over(out[i], src[i]);
+                }
+            }
+        }
+    }
+
+    if (drawn)
+    {
+        image->buildSpans();
+        chunk.image = std::move(image);
+    }
+    chunk.bakeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 请求烘焙一个块, 烘焙任务持有块的引用计数, 块被取消或淘汰后任务仍可安全访问
+Tilemap::Chunk &Tilemap::request(int cx, int cy)
+{
+    auto chunk = std::make_shared<Chunk>();
+    chunk->cx = cx;
+    chunk->cy = cy;
+    chunk->requestedAt = std::chrono::steady_clock::now();
+    chunks.emplace(cellKey(cx, cy), chunk);
+    chunkStats.pending++;
+    bakePool->submit([this, chunk]
+                     {
+        // 主线程已代为烘焙或已取消
+        ChunkState expected = ChunkState::Queued;
+        if (!chunk->state.compare_exchange_strong(expected, ChunkState::Baking))
+            return;
+        bake(*chunk);
+        {
+            std::lock_guard<std::mutex> lock(bakeMutex);
+            chunk->state.store(ChunkState::Ready, std::memory_order_release);
+            finishedBakes.push_back(chunk.get());
+        }
+        bakeCv.notify_all(); });
+    return *chunk;
+}
+
+// 主线程汇总烘焙完成的块: 分配图像 key, 记录内存和延迟
+void Tilemap::collectBakes()
+{
+    std::vector<Chunk *> done;
+    {
+        std::lock_guard<std::mutex> lock(bakeMutex);
+        done.swap(finishedBakes);
+    }
+    const auto now = std::chrono::steady_clock::now();
+    for (Chunk *chunk : done)
+    {
+        chunk->key = GDI::newImageKey();
+        chunk->bytes = (chunk->image ? chunk->image->heapBytes() : 0) + chunk->solid.capacity() * sizeof(uint64_t);
+        chunkStats.bytes += chunk->bytes;
+        chunkStats.resident++;
+        chunkStats.pending--;
+        chunkStats.baked++;
+        chunkStats.bakeMs += chunk->bakeMs;
+        chunkStats.bakeMsMax = std::max<double>(chunkStats.bakeMsMax, chunk->bakeMs);
+        const double latency = std::chrono::duration<double, std::milli>(now - chunk->requestedAt).count();
+        chunkStats.latencyMsTotal += latency;
+        chunkStats.latencyMsMax = std::max(chunkStats.latencyMsMax, latency);
+    }
+}
+
+// 取消本帧不再需要、还没开始烘焙的请求; 超出预算时按LRU淘汰本帧没用到的块
+// 烘焙完成但还没汇总的块 (key 为0) 不淘汰, finishedBakes 中的指针保持有效
+void Tilemap::evict(size_t budget)
+{
+    std::vector<std::pair<uint64_t, uint64_t>> candidates;
+    for (auto it = chunks.begin(); it != chunks.end();)
+    {
+        Chunk &chunk = *it->second;
+        ChunkState expected = ChunkState::Queued;
+        if (chunk.lastUsed < frame && chunk.state.compare_exchange_strong(expected, ChunkState::Baking))
+        {
+            chunkStats.pending--;
+            chunkStats.cancelled++;
+            it = chunks.erase(it);
+            continue;
+        }
+        if (chunk.key != 0 && chunk.lastUsed < frame)
+            candidates.emplace_back(chunk.lastUsed, it->first);
+        ++it;
+    }
+    if (chunkStats.bytes <= budget)
+        return;
+
+    std::sort(candidates.begin(), candidates.end());
+    for (const auto &[lastUsed, key] : candidates)
+    {
+        if (chunkStats.bytes <= budget)
+            break;
+        auto it = chunks.find(key);
+        chunkStats.bytes -= it->second->bytes;
+        chunkStats.resident--;
+        chunkStats.evicted++;
+        chunks.erase(it);
+    }
+}
+
+void Tilemap::render(int viewX, int viewY, int viewW, int viewH)
+{
+    if (!loaded)
+        return;
+    frame++;
+    chunkStats.bakeMs = 0;
+    collectBakes();
+
+    const int cx0 = std::max(chunkX0, floorDiv(viewX, CHUNK_SIZE));
+    const int cy0 = std::max(chunkY0, floorDiv(viewY, CHUNK_SIZE));
+    const int cx1 = std::min(chunkX1, ceilDiv(viewX + viewW, CHUNK_SIZE));
+    const int cy1 = std::min(chunkY1, ceilDiv(viewY + viewH, CHUNK_SIZE));
+    bool stalled = false;
+    for (int cy = cy0; cy < cy1; ++cy)
+    {
+        for (int cx = cx0; cx < cx1; ++cx)
+        {
+            Chunk *chunk = findChunk(cx, cy);
+            if (!chunk)
+                chunk = &request(cx, cy);
+            chunk->lastUsed = frame;
+            if (chunk->key == 0)
+            {
+                if (missingPolicy == MissingPolicy::Skip)
+                {
+                    chunkStats.missedDraws++;
+                    continue;
+                }
+                // 还没开始的块直接在主线程烘焙, 正在烘焙的等它完成
+                const auto start = std::chrono::steady_clock::now();
+                ChunkState expected = ChunkState::Queued;
+                if (chunk->state.compare_exchange_strong(expected, ChunkState::Baking))
+                {
+                    bake(*chunk);
+                    std::lock_guard<std::mutex> lock(bakeMutex);
+                    chunk->state.store(ChunkState::Ready, std::memory_order_release);
+                    finishedBakes.push_back(chunk);
+                }
+                else
+                {
+                    std::unique_lock<std::mutex> lock(bakeMutex);
+                    bakeCv.wait(lock, [chunk]
+                                { return chunk->state.load(std::memory_order_acquire) == ChunkState::Ready; });
+                }
+                collectBakes();
+                chunkStats.stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                stalled = true;
+            }
+            if (chunk->image)
+                GDI::bitmapWorld(chunk->image.get(), chunk->key, std::max(cx * CHUNK_SIZE, left()), std::max(cy * CHUNK_SIZE, top()));
+        }
+    }
+    if (stalled)
+        chunkStats.stallFrames++;
+
+    // 视野外一圈的块按离视野中心由近到远请求, 平移时新进入视野的块多半已经烘焙好
+    const int ringX0 = std::max(chunkX0, cx0 - prefetchRadius), ringX1 = std::min(chunkX1, cx1 + prefetchRadius);
+    const int ringY0 = std::max(chunkY0, cy0 - prefetchRadius), ringY1 = std::min(chunkY1, cy1 + prefetchRadius);
+    const int centerX = viewX + viewW / 2, centerY = viewY + viewH / 2;
+    std::vector<std::pair<int64_t, uint64_t>> wanted;
+    for (int cy = ringY0; cy < ringY1; ++cy)
+    {
+        for (int cx = ringX0; cx < ringX1; ++cx)
+        {
+            if (Chunk *chunk = findChunk(cx, cy))
+            {
+                chunk->lastUsed = frame;
+                continue;
+            }
+            const int64_t dx = cx * CHUNK_SIZE + CHUNK_SIZE / 2 - centerX;
+            const int64_t dy = cy * CHUNK_SIZE + CHUNK_SIZE / 2 - centerY;
+            wanted.emplace_back(dx * dx + dy * dy, cellKey(cx, cy));
+        }
+    }
+    std::sort(wanted.begin(), wanted.end());
+
+    size_t budget = budgetBytes;
+    if (budget == 0)
+    {
+        const size_t across = ceilDiv(viewW, CHUNK_SIZE) + 1 + 2 * prefetchRadius;
+        const size_t down = ceilDiv(viewH, CHUNK_SIZE) + 1 + 2 * prefetchRadius;
+        budget = across * down * CHUNK_SIZE * CHUNK_SIZE * sizeof(uint32_t);
+    }
+    chunkStats.budgetBytes = budget;
+
+    // 先给要请求的块腾出空间, 未完成的请求按最坏情况 (整块图像) 估算
+    const size_t chunkBytes = (size_t)CHUNK_SIZE * CHUNK_SIZE * sizeof(uint32_t);
+    const size_t reserve = (wanted.size() + chunkStats.pending) * chunkBytes;
+    evict(budget > reserve ? budget - reserve : 0);
+    for (const auto &[distance, key] : wanted)
+    {
+        if (chunkStats.bytes + (chunkStats.pending + 1) * chunkBytes > budget)
+            break;
+        Chunk &chunk = request(static_cast<int32_t>(key & 0xFFFFFFFF), static_cast<int32_t>(key >> 32));
+        chunk.lastUsed = frame;
+    }
+}
@@ -0,0 +1,257 @@
+﻿#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include "CachedImage.h"
+#include "SpritePack.h"
+#include "ThreadPool.h"
+
+class TileCollision;
+
+// Tiled 地图 (.tmx, 正交)
+// 加载时解析地图和外部图块集 (.tsx), 图块集图像从资源包中按名字取 (资源包中的名字相对 tile/ 目录)。
+// 绘制时地图按 CHUNK_SIZE 像素切成烘焙块: 块进入视野附近时由后台线程把所有可见图层的图块合成到一张图像,
+// 同时生成该块的碰撞格, 之后每帧每块只是一次 1:1 绘制。
+// 只有视野附近的块常驻内存, 超出预算时按最近使用时间淘汰, 内存随视野大小而不是地图大小增长。
+// 无限地图 (infinite="1") 加载时只记录各 <chunk> 在文件中的位置, 图块数据在烘焙时才从文件读取解码。
+class Tilemap
+{
+public:
+    static const int CHUNK_SIZE = 256;
+
+    // Tiled GID 高位的翻转标记
+    static const uint32_t FLIP_H = 0x80000000;
+    static const uint32_t FLIP_V = 0x40000000;
+    static const uint32_t FLIP_D = 0x20000000; // 对角翻转 (沿主对角线转置)
+    static const uint32_t GID_MASK = 0x0FFFFFFF;
+
+    // 视野内的块还没烘焙好时如何处理
+    enum class MissingPolicy : uint8_t
+    {
+        Block, // 等待烘焙完成, 还没开始烘焙的块在主线程直接烘焙 (计入卡顿)
+        Skip,  // 本帧不画该块
+    };
+
+    struct Stats
+    {
+        int chunks = 0;          // 地图范围内的块数
+        int resident = 0;        // 当前已烘焙并常驻的块数
+        int pending = 0;         // 已请求, 尚未烘焙完成的块数
+        int baked = 0;           // 累计烘焙次数
+        int evicted = 0;         // 累计淘汰次数
+        int cancelled = 0;       // 还没开始烘焙就离开预取范围而取消的请求
+        size_t bytes = 0;        // 常驻块占用的内存 (像素+游程表+碰撞格)
+        size_t budgetBytes = 0;  // 当前生效的预算
+        double bakeMs = 0;       // 本帧完成的烘焙耗时之和
+        double bakeMsMax = 0;
+        double latencyMsMax = 0; // 从请求到烘焙完成的最长时间
+        double latencyMsTotal = 0;
+        int stallFrames = 0;     // 等待烘焙而卡住的帧数 (Block)
+        double stallMs = 0;      // 主线程累计等待/代为烘焙的时间
+        int missedDraws = 0;     // 因未烘焙完成而没画的块 (Skip)
+    };
+
+    Tilemap() = default;
+    ~Tilemap();
+
+    Tilemap(const Tilemap &) = delete;
+    Tilemap &operator=(const Tilemap &) = delete;
+
+    // root 为 tile/ 目录 (UTF-8), path 为相对 root 的 .tmx 路径; pack 须已打开且在地图使用期间保持打开
+    // 失败时返回 false, 原因见 error()
+    bool load(const std::string &root, const std::string &path, const SpritePack &pack);
+    void clear();
+
+    bool isLoaded() const
+    {
+        return loaded;
+    }
+    bool isInfinite() const
+    {
+        return infinite;
+    }
+    const std::string &error() const
+    {
+        return lastError;
+    }
+
+    // 地图范围 (像素); 无限地图为所有 <chunk> 的包围盒, 左上角可以是负数
+    int left() const
+    {
+        return originCol * tileW;
+    }
+    int top() const
+    {
+        return originRow * tileH;
+    }
+    int width() const
+    {
+        return cols * tileW;
+    }
+    int height() const
+    {
+        return rows * tileH;
+    }
+    int tileWidth() const
+    {
+        return tileW;
+    }
+    int tileHeight() const
+    {
+        return tileH;
+    }
+
+    // 绘制与视野 (世界坐标) 相交的块, 并请求视野外 prefetchRadius 圈内的块
+    void render(int viewX, int viewY, int viewW, int viewH);
+
+    void setMissingPolicy(MissingPolicy policy)
+    {
+        missingPolicy = policy;
+    }
+    // 常驻块的内存预算, 0 为按视野自动计算 (视野和预取圈内的块数)
+    void setMemoryBudget(size_t bytes)
+    {
+        budgetBytes = bytes;
+    }
+    // 视野外预先烘焙的圈数
+    void setPrefetchRadius(int chunks)
+    {
+        prefetchRadius = chunks < 0 ? 0 : chunks;
+    }
+    const Stats &stats() const
+    {
+        return chunkStats;
+    }
+
+    // 图层查询
+    int layerCount() const
+    {
+        return static_cast<int>(layers.size());
+    }
+    int findLayer(std::string_view name) const;
+    const std::string &layerName(int layer) const
+    {
+        return layers[layer].name;
+    }
+    // gid 含翻转标记, 越界为0; 无限地图的图块数据不常驻, 总是返回0
+    uint32_t gid(int layer, int col, int row) const;
+
+    // 碰撞层: 其中非空的格子为实心。图层属性 collision=true 的层加载时自动标记,
+    // 其余用 setCollisionLayer 指定, 须在第一次 render 之前调用 (已烘焙的块不会更新)
+    void setCollisionLayer(int layer, bool solid);
+    // 格子是否实心, 所在块未常驻时返回 false
+    bool isSolid(int col, int row) const;
+    bool isResident(int col, int row) const;
+    // 把所有碰撞层的实心格烘焙成整张地图的静态碰撞 (每格1位), 与块是否常驻无关
+    // 无限地图从文件按 <chunk> 逐段读取; 读取失败时返回 false, out 为空
+    bool bakeCollision(TileCollision &out) const;
+
+private:
+    // 一个 GID 对应的源图像区域, img 为空表示没有图像
+    struct Tile
+    {
+        const CachedImage *img = nullptr;
+        int srcX = 0, srcY = 0;
+        int w = 0, h = 0;
+    };
+
+    // 无限地图的一个 <chunk>: 图块数据在文件中的字节范围, 烘焙时才读取
+    struct SourceChunk
+    {
+        int col, row; // 左上角格子
+        size_t begin, end;
+    };
+
+    struct Layer
+    {
+        std::string name;
+        bool visible = true;
+        bool collision = false;
+        uint8_t opacity = 255;
+        bool base64 = false; // 无限地图 <chunk> 的编码, 否则为 CSV
+        int maxTileW = 0;    // 本层用到的最大图块, 决定烘焙时向左/向下多看几格
+        int maxTileH = 0;
+        std::vector<uint32_t> gids; // 有限地图: 整层数据
+        // 无限地图: Tiled 按固定大小对齐切分 <chunk>, 按 (格子坐标 / chunk 大小) 索引
+        std::vector<SourceChunk> sources;
+        std::unordered_map<uint64_t, uint32_t> sourceIndex;
+        int sourceCols = 0, sourceRows = 0;
+    };
+
+    enum class ChunkState : uint8_t
+    {
+        Queued, // 已提交给烘焙线程, 尚未开始
+        Baking,
+        Ready,
+    };
+
+    // 烘焙线程只写 image/solid/bakeMs, 写完后把 state 置为 Ready
+    struct Chunk
+    {
+        int cx = 0, cy = 0;
+        std::atomic<ChunkState> state{ChunkState::Queued};
+        std::unique_ptr<CachedImage> image; // 全透明的块不保留图像
+        std::vector<uint64_t> solid;        // 本块格子的实心位, 按行排列
+        int solidCol = 0, solidRow = 0;     // 本块第一个格子
+        int solidCols = 0, solidRows = 0;
+        float bakeMs = 0;
+
+        // 以下只由主线程访问
+        int key = 0;
+        uint64_t lastUsed = 0;
+        std::chrono::steady_clock::time_point requestedAt;
+        size_t bytes = 0;
+    };
+
+    struct XmlNode; // 只在 Tilemap.cpp 中定义的最小 XML 树
+
+    bool fail(std::string message);
+    bool loadTileset(const std::string &dir, const XmlNode &element, uint32_t firstGid, const SpritePack &pack);
+    bool loadLayer(const XmlNode &element);
+    const CachedImage *bindImage(const std::string &name, const SpritePack &pack);
+    const Tile *tile(uint32_t gid) const;
+
+    static uint64_t cellKey(int x, int y)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(y)) << 32) | static_cast<uint32_t>(x);
+    }
+    Chunk *findChunk(int cx, int cy) const;
+    Chunk &request(int cx, int cy);
+    void bake(Chunk &chunk) const;
+    bool readLayer(const Layer &layer, std::istream *file, int col0, int row0, int cols, int rows, std::vector<uint32_t> &out) const;
+    void collectBakes();
+    void evict(size_t budget);
+
+    bool loaded = false;
+    bool infinite = false;
+    std::string lastError;
+    std::string filePath; // 无限地图烘焙时从这里读取图块数据
+    int originCol = 0, originRow = 0;
+    int cols = 0, rows = 0;
+    int tileW = 0, tileH = 0;
+    std::vector<Layer> layers;
+    std::vector<Tile> tiles; // 按去掉翻转标记的 GID 索引
+    std::vector<std::unique_ptr<CachedImage>> images;
+
+    int chunkX0 = 0, chunkY0 = 0, chunkX1 = 0, chunkY1 = 0; // 地图范围内的块 [x0, x1) × [y0, y1)
+    std::unordered_map<uint64_t, std::shared_ptr<Chunk>> chunks; // 烘焙任务也持有, 淘汰/取消后由任务释放
+    MissingPolicy missingPolicy = MissingPolicy::Block;
+    size_t budgetBytes = 0;
+    int prefetchRadius = 1;
+    uint64_t frame = 0;
+    Stats chunkStats;
+
+    std::mutex bakeMutex;
+    std::condition_variable bakeCv;
+    std::vector<Chunk *> finishedBakes; // 由 bakeMutex 保护
+    // 一个后台烘焙线程, 最后声明以便最先析构 (析构时等正在烘焙的块完成)
+    std::unique_ptr<ThreadPool> bakePool;
+};
@@ -1,84 +1,86 @@
-﻿#include "PC.h"
-#include "GDI.h"
-#include <chrono>
-#include "Camera.h"
-#include "Scene.h"
-#include "scene/StartScene.hpp"
-#include "scene/GameScene.hpp"
-#include "Input.h"
-#include <iostream>
-
-extern int GAME_WIDTH;
-extern int GAME_HEIGHT;
-extern int GAME_LINE;
-extern int GAME_OFFSET_X;
-extern int GAME_OFFSET_Y;
-
-// 使用 steady_clock（单调时钟，不受系统时间调整影响）
-using Clock = std::chrono::high_resolution_clock; // 或 steady_clock
-using TimePoint = std::chrono::time_point<Clock>;
-
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
-{
-    PC pc(hInstance, GAME_WIDTH, GAME_HEIGHT, "Hammer");
-    pc.show();
-
-    Input::Initialize(pc.window());
-    GDI::init(pc.window());
-
-    TimePoint prev_time = Clock::now();
-
-    int tickCount = 0;
-    int fps = 0;
-    float secondsFps = 1.0;
-    bool running = true;
-    std::wstring fpsText = L"0";
-
-    QuadTree::WORLD = std::make_unique<QuadTree>(QuadTreeRect(-100, -100, WORLD_RIGHT * 1.5, GAME_HEIGHT * 1.5), 4);
-
-    // 设置碰撞回调
-
-    Scene::change(std::make_unique<GameScene>());
-    while (running)
-    {
-        if (!pc.tick())
-            break;
-        TimePoint current_time = Clock::now();
-        // 计算帧间隔 dt（秒，浮点型）
-        float dt = std::chrono::duration<float>(current_time - prev_time).count();
-        prev_time = current_time;
-
-        secondsFps -= dt;
-        tickCount++;
-        if (secondsFps <= 0)
-        {
-            secondsFps = 1;
-            fpsText = L" FPS:" + std::to_wstring(fps);
-            fps = tickCount;
-            tickCount = 0;
-        }
-        if (dt > 0.33)
-        {
-            dt = 0.33;
-        }
-        QuadTree::WORLD->tick(dt);
-        Input::Update();
-        Scene::curScene->tick(dt);
-        GDI::begin(dt);
-        GAME_OFFSET_X = Camera::getOffsetX();
-        GAME_OFFSET_Y = Camera::getOffsetY();
-        GDI::setCamera(GAME_OFFSET_X, GAME_OFFSET_Y);
-        Scene::curScene->render();
-        GDI::tick(dt);
-
-        GDI::setCamera(0, 0);
-        Scene::curScene->renderGlobal();
-        GDI::text(fpsText, 10, 10);
-        GDI::flush(dt);
-    }
-    // 保证场景内对象清理在tree之前
-    Scene::change(nullptr);
-    GDI::end();
-    Input::Shutdown();
-    return 0;
+﻿#include "PC.h"
+#include "GDI.h"
+#include <chrono>
+#include "Camera.h"
+#include "Scene.h"
+#include "scene/StartScene.hpp"
+#include "scene/GameScene.hpp"
+#include "Input.h"
+#include <iostream>
+
+extern double GAME_SCALE;
+extern int GAME_WIDTH;
+extern int GAME_HEIGHT;
+extern int GAME_LINE;
+extern int GAME_OFFSET_X;
+extern int GAME_OFFSET_Y;
+
+// 使用 steady_clock（单调时钟，不受系统时间调整影响）
+using Clock = std::chrono::high_resolution_clock; // 或 steady_clock
+using TimePoint = std::chrono::time_point<Clock>;
+
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
+{
+    // 游戏固定按 GAME_WIDTH x GAME_HEIGHT 渲染, 窗口按 GAME_SCALE 放大
+    PC pc(hInstance, static_cast<int>(GAME_WIDTH * GAME_SCALE), static_cast<int>(GAME_HEIGHT * GAME_SCALE), "Hammer");
+    pc.show();
+
+    Input::Initialize(pc.window());
+    GDI::init(pc.window(), GAME_WIDTH, GAME_HEIGHT);
+    // 解码后的图像最多常驻 256MB, 超出后淘汰最久未绘制的图像 (当前场景固定的图像除外)
+    GDI::setImageBudget(256ull * 1024 * 1024);
+
+    TimePoint prev_time = Clock::now();
+
+    int tickCount = 0;
+    int fps = 0;
+    float secondsFps = 1.0;
+    bool running = true;
+    int fpsShown = 0;
+
+    // 碰撞世界 (Broadphase::WORLD) 由场景切换时按场景创建
+    Scene::change(std::make_unique<GameScene>());
+    while (running)
+    {
+        if (!pc.tick())
+            break;
+        TimePoint current_time = Clock::now();
+        // 计算帧间隔 dt（秒，浮点型）
+        float dt = std::chrono::duration<float>(current_time - prev_time).count();
+        prev_time = current_time;
+
+        secondsFps -= dt;
+        tickCount++;
+        if (secondsFps <= 0)
+        {
+            secondsFps = 1;
+            fpsShown = fps;
+            fps = tickCount;
+            tickCount = 0;
+        }
+        if (dt > 0.33)
+        {
+            dt = 0.33;
+        }
+        Broadphase::WORLD->tick(dt);
+        Input::Update();
+        Scene::curScene->tick(dt);
+        GDI::begin(dt);
+        GAME_OFFSET_X = Camera::getOffsetX();
+        GAME_OFFSET_Y = Camera::getOffsetY();
+        GDI::setCamera(GAME_OFFSET_X, GAME_OFFSET_Y);
+        Scene::curScene->render();
+        GDI::tick(dt);
+
+        GDI::setCamera(0, 0);
+        Scene::curScene->renderGlobal();
+        // 格式化到栈上缓冲区, 每帧不分配字符串
+        GDI::textf(10, 10, 12.0f, Gdiplus::Color::White, L" FPS:%d", fpsShown);
+        GDI::flush(dt);
+    }
+    // 保证场景内对象清理在tree之前
+    Scene::change(nullptr);
+    GDI::end();
+    Input::Shutdown();
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,469 @@
+﻿#include "Broadphase.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+std::unique_ptr<Broadphase> Broadphase::WORLD = nullptr;
+
+bool Broadphase::insert(QuadTreeRect *val)
+{
+    val->update();
+    if (!val->updateFlag)
+    {
+        val->updateFlag = true;
+        updates.push_back(val);
+    }
+    cache[val->id] = val;
+    return add(val);
+}
+
+std::unordered_set<QuadTreeRect *> Broadphase::query(QuadTreeRect *range)
+{
+    // 不用 hits, 碰撞回调里也可以调用
+    std::vector<QuadTreeRect *> found;
+    query(range, found);
+    std::unordered_set<QuadTreeRect *> result(found.begin(), found.end());
+    return result; // 返回值（C++11的RVO会优化这个过程，避免拷贝开销）
+}
+
+bool Broadphase::raycast(float x0, float y0, float x1, float y1, RayHit &hit, const QuadTreeRect *self) const
+{
+    // 通用实现: 取线段包围盒内的条目逐个求交, 保留最近的
+    struct State
+    {
+        Filter filter;
+        float x0, y0, dx, dy;
+        QuadTreeRect *best;
+        float t;
+    } state{Filter(self), x0, y0, x1 - x0, y1 - y0, nullptr, 1};
+    QuadTreeRect range(std::min(x0, x1), std::min(y0, y1), std::abs(x1 - x0), std::abs(y1 - y0));
+    range.category = state.filter.category;
+    range.mask = state.filter.mask;
+    visit(&range, [](void *context, QuadTreeRect *item)
+          {
+              auto &s = *static_cast<State *>(context);
+              float enter;
+              if (item != s.filter.self &&
+                  segment(s.x0, s.y0, s.dx, s.dy, item->x, item->y, item->x + item->w, item->y + item->h, s.t, enter) &&
+                  (!s.best || enter < s.t || item->id < s.best->id))
+              {
+                  s.best = item;
+                  s.t = enter;
+              } }, &state);
+    if (!state.best)
+    {
+        return false;
+    }
+    hit.item = state.best;
+    hit.t = state.t;
+    hit.x = x0 + state.dx * state.t;
+    hit.y = y0 + state.dy * state.t;
+    return true;
+}
+
+void Broadphase::queryCircle(float x, float y, float radius, std::vector<QuadTreeRect *> &result, const QuadTreeRect *self) const
+{
+    struct State
+    {
+        Filter filter;
+        float x, y, radius2;
+        std::vector<QuadTreeRect *> &result;
+    } state{Filter(self), x, y, radius * radius, result};
+    QuadTreeRect range(x - radius, y - radius, radius * 2, radius * 2);
+    range.category = state.filter.category;
+    range.mask = state.filter.mask;
+    visit(&range, [](void *context, QuadTreeRect *item)
+          {
+              auto &s = *static_cast<State *>(context);
+              if (item != s.filter.self && distance2(s.x, s.y, item->x, item->y, item->x + item->w, item->y + item->h) <= s.radius2)
+              {
+                  s.result.push_back(item);
+              } }, &state);
+}
+
+void Broadphase::queryPoint(float x, float y, std::vector<QuadTreeRect *> &result, const QuadTreeRect *self) const
+{
+    struct State
+    {
+        const QuadTreeRect *self;
+        std::vector<QuadTreeRect *> &result;
+    } state{self, result};
+    // 范围查询的边界是闭区间, 零大小的范围就是点查询
+    const Filter filter(self);
+    QuadTreeRect range(x, y, 0, 0);
+    range.category = filter.category;
+    range.mask = filter.mask;
+    visit(&range, [](void *context, QuadTreeRect *item)
+          {
+              auto &s = *static_cast<State *>(context);
+              if (item != s.self)
+              {
+                  s.result.push_back(item);
+              } }, &state);
+}
+
+bool Broadphase::segment(float x0, float y0, float dx, float dy, float left, float top, float right, float bottom, float tMax, float &enter)
+{
+    // 分别求线段在 x、y 两个区间内的 t 范围再取交集
+    float tMin = 0;
+    if (dx == 0)
+    {
+        if (x0 < left || x0 > right)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        float t0 = (left - x0) / dx, t1 = (right - x0) / dx;
+        if (t0 > t1)
+        {
+            std::swap(t0, t1);
+        }
+        tMin = std::max(tMin, t0);
+        tMax = std::min(tMax, t1);
+        if (tMin > tMax)
+        {
+            return false;
+        }
+    }
+    if (dy == 0)
+    {
+        if (y0 < top || y0 > bottom)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        float t0 = (top - y0) / dy, t1 = (bottom - y0) / dy;
+        if (t0 > t1)
+        {
+            std::swap(t0, t1);
+        }
+        tMin = std::max(tMin, t0);
+        tMax = std::min(tMax, t1);
+        if (tMin > tMax)
+        {
+            return false;
+        }
+    }
+    enter = tMin;
+    return true;
+}
+
+bool Broadphase::nearer(const Neighbor &a, const Neighbor &b)
+{
+    return a.dist2 != b.dist2 ? a.dist2 < b.dist2 : contactLess(a.item, b.item);
+}
+
+void Broadphase::offer(std::vector<Neighbor> &heap, int k, QuadTreeRect *item, float dist2)
+{
+    const Neighbor n{item, dist2};
+    if (heap.size() < static_cast<size_t>(k))
+    {
+        heap.push_back(n);
+        std::push_heap(heap.begin(), heap.end(), nearer);
+    }
+    else if (nearer(n, heap.front()))
+    {
+        std::pop_heap(heap.begin(), heap.end(), nearer);
+        heap.back() = n;
+        std::push_heap(heap.begin(), heap.end(), nearer);
+    }
+}
+
+float Broadphase::farthest(const std::vector<Neighbor> &heap, int k)
+{
+    return heap.size() < static_cast<size_t>(k) ? std::numeric_limits<float>::infinity() : heap.front().dist2;
+}
+
+// 真正需要移除时调用,会清理碰撞缓存,如果只是移动更新的,不需要此接口,走节点删除和插入,并更新
+bool Broadphase::remove(int id)
+{
+    auto found = cache.find(id);
+    if (found == cache.end())
+    {
+        return false;
+    }
+    auto it = found->second;
+    drop(it);
+    for (auto other : it->contacts)
+    {
+        dropContact(other, it);
+        collisionCache.erase(QuadTreePairs::pairId(it->id, other->id));
+    }
+    it->contacts.clear();
+    cache.erase(id);
+    if (it->updateFlag)
+    {
+        it->updateFlag = false;
+        updates.erase(std::find(updates.begin(), updates.end(), it));
+    }
+    return true;
+}
+
+void Broadphase::update(QuadTreeRect *val)
+{
+    // 索引中的包围盒每次都同步, 未达到阈值的小位移也不会让查询用到旧位置
+    bool moved = val->update();
+    refresh(val);
+
+    // 不需要更新,没达到阈值
+    if (!moved)
+    {
+        return;
+    }
+    if (!val->updateFlag)
+    {
+        val->updateFlag = true;
+        updates.push_back(val);
+    }
+}
+
+void Broadphase::setThreadCount(int threads)
+{
+    if (threads <= 0)
+        threads = ThreadPool::hardwareThreads();
+    if (threads == threadCount())
+        return;
+    pool = threads > 1 ? std::make_unique<ThreadPool>(threads) : nullptr;
+    probeTick = 0;
+    parallelWins = false;
+}
+
+int Broadphase::threadCount() const
+{
+    return pool ? pool->size() : 1;
+}
+
+// 排除自身, 按 id 排序, 之后才能与上次的碰撞列表归并比较
+void Broadphase::prune(std::vector<QuadTreeRect *> &list, size_t from, const QuadTreeRect *val)
+{
+    list.erase(std::remove(list.begin() + from, list.end(), val), list.end());
+    std::sort(list.begin() + from, list.end(), contactLess);
+}
+
+// 查询 updates[begin, end) 各自的碰撞, 排除自身并按 id 排序; 只读索引、对象和碰撞对表, 只写 batch
+void Broadphase::collect(Batch &batch, size_t begin, size_t end) const
+{
+    batch.hits.clear();
+    batch.hints.clear();
+    batch.ends.clear();
+    for (size_t i = begin; i < end; ++i)
+    {
+        QuadTreeRect *val = updates[i];
+        const size_t from = batch.hits.size();
+        query(val, batch.hits);
+        prune(batch.hits, from, val);
+        // 上次就在碰撞的, 先在这里查好碰撞对的位置, 串行阶段大多不用再查表
+        auto pre = val->contacts.begin();
+        const auto preEnd = val->contacts.end();
+        for (size_t h = from; h < batch.hits.size(); ++h)
+        {
+            QuadTreeRect *other = batch.hits[h];
+            while (pre != preEnd && contactLess(*pre, other))
+            {
+                ++pre;
+            }
+            // 对方在 updates 中排在前面时, 这对碰撞已由对方处理, 串行阶段不会用到
+            const bool persist = pre != preEnd && *pre == other;
+            const bool earlier = other->updateFlag && other->updateIndex < val->updateIndex;
+            batch.hints.push_back(persist && !earlier ? collisionCache.indexOf(QuadTreePairs::pairId(val->id, other->id)) : -1);
+        }
+        batch.ends.push_back(batch.hits.size());
+    }
+}
+
+void Broadphase::setFilter(QuadTreeRect *val, uint32_t category, uint32_t mask)
+{
+    val->category = category;
+    val->mask = mask;
+    refresh(val);
+    if (!val->updateFlag)
+    {
+        val->updateFlag = true;
+        updates.push_back(val);
+    }
+}
+
+void Broadphase::tick([[maybe_unused]] double dt)
+{
+    prepare();
+
+    // 处理完的对象打上本次的 tickMark, 两个都在更新的对象之间的碰撞由先处理的一方负责
+    tickMark++;
+    const size_t count = updates.size();
+    bool parallel = pool && count >= PARALLEL_MIN;
+    bool probing = false;
+    if (parallel)
+    {
+        const int phase = probeTick++ % PROBE_PERIOD;
+        if (phase == 0)
+        {
+            serialNs = 0;
+            parallelNs = 0;
+        }
+        probing = phase < PROBE_TICKS * 2;
+        parallel = probing ? (phase & 1) != 0 : parallelWins;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    if (!parallel)
+    {
+        // 不并行 (对象少时分发的开销比查询还大, 或实测并行不比串行快) 时查一个处理一个
+        for (auto val : updates)
+        {
+            hits.clear();
+            query(val, hits);
+            prune(hits, 0, val);
+            settle(val, nullptr);
+        }
+    }
+    else
+    {
+        // 并行阶段: updates 切成若干段, 各段的查询结果写进各自的 Batch, 不改动任何共享状态
+        for (size_t i = 0; i < count; ++i)
+        {
+            updates[i]->updateIndex = static_cast<uint32_t>(i);
+        }
+        const int blocks = pool->size() * 4;
+        if (batches.size() < static_cast<size_t>(blocks))
+        {
+            batches.resize(blocks);
+        }
+        pool->parallelFor(blocks, [this, count, blocks](int b)
+                          { collect(batches[b], count * b / blocks, count * (b + 1) / blocks); });
+
+        // 串行阶段: 按 updates 的顺序逐个与上次的碰撞列表归并并派发回调, 顺序与线程数无关
+        size_t index = 0;
+        for (int b = 0; b < blocks; ++b)
+        {
+            const Batch &batch = batches[b];
+            size_t from = 0;
+            for (size_t end : batch.ends)
+            {
+                hits.assign(batch.hits.begin() + from, batch.hits.begin() + end);
+                settle(updates[index++], batch.hints.data() + from);
+                from = end;
+            }
+        }
+    }
+    if (probing)
+    {
+        // 两种方式派发的回调和顺序相同, 只比耗时
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+        (parallel ? parallelNs : serialNs) += ns;
+        if (probeTick % PROBE_PERIOD == PROBE_TICKS * 2)
+            parallelWins = parallelNs < serialNs * 0.9;
+    }
+
+    for (auto &info : collisionCache)
+    {
+        info.from->onCollisioningCallBack(info.to, info.dir, true);
+        info.to->onCollisioningCallBack(info.from, info.dir, false);
+    }
+
+    for (auto val : updates)
+    {
+        val->updateFlag = false;
+    }
+    updates.clear();
+}
+
+// hits 为 val 本次的碰撞 (按 id 排序), 与上次的碰撞列表归并比较, 派发开始/结束回调
+// hints 与 hits 一一对应, 为碰撞对在 collisionCache 中的大致位置, 可以为空
+void Broadphase::settle(QuadTreeRect *val, const int *hints)
+{
+    ended.clear();
+    auto pre = val->contacts.begin();
+    const auto preEnd = val->contacts.end();
+    size_t kept = 0;
+    for (size_t i = 0, count = hits.size(); i < count; ++i)
+    {
+        QuadTreeRect *other = hits[i];
+        // 上次有, 这次没有: 碰撞失效, 在新碰撞之后统一处理
+        while (pre != preEnd && contactLess(*pre, other))
+        {
+            ended.push_back(*pre++);
+        }
+        const bool persist = pre != preEnd && *pre == other;
+        if (persist)
+        {
+            ++pre;
+        }
+        // 已处理过的对象; 对方没查到自己 (如对方不在树中) 时不算碰撞
+        if (other->tickMark == tickMark)
+        {
+            if (persist)
+                hits[kept++] = other;
+            continue;
+        }
+        hits[kept++] = other;
+        uint64_t pairId = QuadTreePairs::pairId(val->id, other->id);
+        // 这里做个优化,变化后先遍历的碰撞则是主动碰撞,另外个是被动碰撞
+        if (!persist)
+        {
+            //  新碰撞
+            // int dir = val->getDir(other);
+            int dir = 0;
+            auto &info = collisionCache.add(pairId);
+            info.from = val;
+            info.to = other;
+            info.dir = dir;
+
+            val->onCollisionCallBack(other, dir, true);
+            other->onCollisionCallBack(val, dir, false);
+
+            addContact(other, val);
+        }
+        else
+        {
+            // 旧碰撞,将主动方更新
+            auto info = hints ? collisionCache.find(pairId, hints[i]) : collisionCache.find(pairId);
+            info->from = val;
+            info->to = other;
+            info->dir = val->getDir(other);
+        }
+    }
+    ended.insert(ended.end(), pre, preEnd);
+
+    // 留下的查询结果就是新的碰撞列表; 复制而不是交换, 各自的容量留给下次复用
+    // (交换会把碰撞少的对象的小数组换给查询结果, 碰撞多的对象下次查询时又要重新分配)
+    val->contacts.assign(hits.begin(), hits.begin() + kept);
+
+    // 碰撞失效检查
+    for (auto other : ended)
+    {
+        uint64_t pairId = QuadTreePairs::pairId(val->id, other->id);
+        bool from = collisionCache.find(pairId)->from == val;
+        dropContact(other, val);
+
+        val->onCollisionOutCallBack(other, from);
+        other->onCollisionOutCallBack(val, !from);
+
+        collisionCache.erase(pairId);
+    }
+    val->tickMark = tickMark;
+}
+
+bool Broadphase::contactLess(const QuadTreeRect *a, const QuadTreeRect *b)
+{
+    return a->id != b->id ? a->id < b->id : a < b;
+}
+
+void Broadphase::addContact(QuadTreeRect *val, QuadTreeRect *other)
+{
+    auto &list = val->contacts;
+    list.insert(std::lower_bound(list.begin(), list.end(), other, contactLess), other);
+}
+
+void Broadphase::dropContact(QuadTreeRect *val, QuadTreeRect *other)
+{
+    auto &list = val->contacts;
+    auto it = std::lower_bound(list.begin(), list.end(), other, contactLess);
+    if (it != list.end() && *it == other)
+    {
+        list.erase(it);
+    }
+}
@@ -0,0 +1,166 @@
+﻿#pragma once
+#include "QuadTreeRect.h"
+#include "QuadTreePairs.h"
+#include "../ThreadPool.h"
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+// 宽相位 (粗略碰撞检测) 的公共部分
+// 对外的插入/更新/删除/查询/tick 和碰撞回调都在这里, 碰撞对表和每个对象的碰撞列表也由这里维护;
+// 子类只负责空间索引: 条目加入/移出、包围盒变化、tick 前整理, 以及按范围查询;
+// 射线/圆/点查询在这里有基于范围查询的通用实现, 子类可以按自己的结构改写; 最近邻查询由子类实现。
+// 现有三种实现: QuadTree (松散四叉树), SweepAndPrune (按 x 排序), SpatialHash (均匀网格)
+class Broadphase
+{
+public:
+    // 当前场景的碰撞世界, 由 Scene::change 按场景的 createWorld 创建
+    static std::unique_ptr<Broadphase> WORLD;
+    virtual ~Broadphase() = default;
+
+    // 插入, 不在索引范围内时返回 false (仍会记录, 之后移入范围时加入)
+    bool insert(QuadTreeRect *val);
+
+    // 查询
+    std::unordered_set<QuadTreeRect *> query(QuadTreeRect *range);
+    // 查询, 结果追加到 result 末尾 (不清空, 包含 range 自身); result 由调用方复用, 容量足够时不分配内存
+    virtual void query(const QuadTreeRect *range, std::vector<QuadTreeRect *> &result) const = 0;
+
+    // 线段检测的结果, 命中点 (x, y) = 起点 + t * (终点 - 起点)
+    struct RayHit
+    {
+        QuadTreeRect *item = nullptr;
+        float t = 0;
+        float x = 0, y = 0;
+    };
+    // 最近邻查询的结果, dist2 为点到包围盒距离的平方 (点在包围盒内为 0)
+    struct Neighbor
+    {
+        QuadTreeRect *item;
+        float dist2;
+    };
+    // 以下几何查询不修改索引, 也不分配内存 (result 容量足够时), 碰撞回调中也可以调用
+    // self 为发起查询的对象: 结果中不含它, 并且只返回与它满足碰撞过滤条件的条目; 为空时按 QuadTreeRect 默认的 category/mask
+    // 线段 (x0, y0) -> (x1, y1) 最先碰到的条目, 起点在包围盒内时 t 为 0, t 相同时取 id 小的; 射线取足够远的终点
+    virtual bool raycast(float x0, float y0, float x1, float y1, RayHit &hit, const QuadTreeRect *self = nullptr) const;
+    // 与圆相交的条目, 追加到 result 末尾
+    virtual void queryCircle(float x, float y, float radius, std::vector<QuadTreeRect *> &result, const QuadTreeRect *self = nullptr) const;
+    // 包含该点的条目 (含边界), 追加到 result 末尾
+    virtual void queryPoint(float x, float y, std::vector<QuadTreeRect *> &result, const QuadTreeRect *self = nullptr) const;
+    // 离该点最近的 k 个条目, 由近到远写入 result (先清空), 距离相同时 id 小的在前
+    // 没有通用实现: 用范围查询逐步扩大来找, 在条目稀少或被过滤掉时范围会扩得很大, 要由子类按自己的结构实现
+    virtual void nearest(float x, float y, int k, std::vector<Neighbor> &result, const QuadTreeRect *self = nullptr) const = 0;
+
+    // 物体位置大小变化时会手动调用
+    void update(QuadTreeRect *val);
+
+    // 修改碰撞过滤, 下次 tick 重新检查该对象的碰撞 (不再满足过滤条件的碰撞会结束)
+    void setFilter(QuadTreeRect *val, uint32_t category, uint32_t mask);
+
+    // 删除
+    bool remove(int id);
+
+    // 每帧检查需要更新的对象并触发已碰撞对象的碰撞中接口
+    // 先在线程池上并行查询各对象的碰撞, 再按 updates 的顺序串行派发回调, 结果与线程数无关;
+    // 回调中不能增删条目或调用 update (查询结果已经算好)
+    void tick(double dt);
+    // tick 并行查询的线程数 (包含调用线程), <= 0 时取硬件线程数, 默认为 1 (不并行)
+    // 开启后仍会定期实测串行和并行的耗时, 并行没有更快时退回串行
+    void setThreadCount(int threads);
+    int threadCount() const;
+    // 最近一次实测后 tick 是否走并行查询
+    bool parallelActive() const
+    {
+        return pool && parallelWins;
+    }
+    // 记录两两碰撞时的来源方; 每个对象当前碰撞中的对象见 QuadTreeRect::contacts
+    QuadTreePairs collisionCache;
+    std::unordered_map<int, QuadTreeRect *> cache;
+    // 本帧需要检查碰撞的对象, 按加入顺序, 用 QuadTreeRect::updateFlag 去重
+    std::vector<QuadTreeRect *> updates;
+
+protected:
+    // 加入索引, 不在范围内返回 false
+    virtual bool add(QuadTreeRect *val) = 0;
+    // 移出索引 (不在索引中时什么也不做)
+    virtual void drop(QuadTreeRect *val) = 0;
+    // 包围盒变了 (每次 update 都会调用, 位移可能还没达到更新阈值)
+    virtual void refresh(QuadTreeRect *val) = 0;
+    // tick 查询碰撞之前, 可以在这里集中处理本帧移动过的对象 (updates)
+    virtual void prepare() {}
+    // 对与 range 相交并满足其过滤条件的每个条目调用 fn(context, item), 基类的几何查询都建立在它上面
+    virtual void visit(const QuadTreeRect *range, void (*fn)(void *, QuadTreeRect *), void *context) const = 0;
+
+    // 几何查询的过滤条件, 取自发起查询的对象
+    struct Filter
+    {
+        const QuadTreeRect *self;
+        uint32_t category, mask;
+        explicit Filter(const QuadTreeRect *self)
+            : self(self), category(self ? self->category : 1), mask(self ? self->mask : ~0u)
+        {
+        }
+        // 子树的 category / mask 并集中有没有可能满足的条目
+        bool any(uint32_t anyCategory, uint32_t anyMask) const
+        {
+            return (anyCategory & mask) && (anyMask & category);
+        }
+        bool accepts(const QuadTreeRect *item, uint32_t itemCategory, uint32_t itemMask) const
+        {
+            return item != self && (itemCategory & mask) && (itemMask & category);
+        }
+    };
+    // 点到矩形距离的平方
+    static float distance2(float x, float y, float left, float top, float right, float bottom)
+    {
+        const float dx = std::max(std::max(left - x, x - right), 0.0f);
+        const float dy = std::max(std::max(top - y, y - bottom), 0.0f);
+        return dx * dx + dy * dy;
+    }
+    // 线段 (x0, y0) + t * (dx, dy) 在 [0, tMax] 内是否进入矩形, 是则 enter 为进入时的 t
+    static bool segment(float x0, float y0, float dx, float dy, float left, float top, float right, float bottom, float tMax, float &enter);
+    // 最近邻的有界优先队列: result 是最多 k 个的大顶堆, 堆顶为目前第 k 近的
+    static bool nearer(const Neighbor &a, const Neighbor &b);
+    static void offer(std::vector<Neighbor> &heap, int k, QuadTreeRect *item, float dist2);
+    // 堆满之前为无穷大, 比它远的不用再看
+    static float farthest(const std::vector<Neighbor> &heap, int k);
+
+private:
+    // 一段连续的更新对象的查询结果 (已排除自身并按 id 排序), 由一个线程填写, 帧间复用
+    struct Batch
+    {
+        std::vector<QuadTreeRect *> hits;
+        // 与 hits 一一对应: 上次就在碰撞的为碰撞对在 collisionCache 中的下标, 否则为 -1
+        std::vector<int> hints;
+        // 每个对象的结果在 hits 中的结束位置
+        std::vector<size_t> ends;
+    };
+    // 更新对象少于这个数时不分发到线程池
+    static constexpr size_t PARALLEL_MIN = 64;
+    // 每 PROBE_PERIOD 次可以并行的 tick, 开头的 PROBE_TICKS * 2 次串行/并行交替执行并计时,
+    // 按每个对象的平均耗时比较, 并行快 10% 以上才在这一周期内使用 (单核机器上线程池只有开销)
+    static constexpr int PROBE_TICKS = 8;
+    static constexpr int PROBE_PERIOD = 600;
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<Batch> batches;
+    int probeTick = 0;
+    double serialNs = 0;
+    double parallelNs = 0;
+    bool parallelWins = false;
+
+    // tick 中复用的查询结果和失效的碰撞
+    std::vector<QuadTreeRect *> hits;
+    std::vector<QuadTreeRect *> ended;
+    // tick 批次, 写进 QuadTreeRect::tickMark
+    uint32_t tickMark = 0;
+
+    static void prune(std::vector<QuadTreeRect *> &list, size_t from, const QuadTreeRect *val);
+    void collect(Batch &batch, size_t begin, size_t end) const;
+    void settle(QuadTreeRect *val, const int *hints);
+
+    // 碰撞列表按 id 有序
+    static bool contactLess(const QuadTreeRect *a, const QuadTreeRect *b);
+    static void addContact(QuadTreeRect *val, QuadTreeRect *other);
+    static void dropContact(QuadTreeRect *val, QuadTreeRect *other);
+};
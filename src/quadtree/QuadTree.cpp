@@ -1,146 +1,448 @@
-﻿#include "QuadTree.h"
-#include <iostream>
-
-std::unique_ptr<QuadTree> QuadTree::WORLD = nullptr;
-
-QuadTree::QuadTree(QuadTreeRect bound, int capacity, int depth)
-{
-    root = std::make_unique<QuadTreeNode>(bound, capacity, depth);
-}
-
-bool QuadTree::insert(QuadTreeRect *val)
-{
-    val->update();
-    curUpdates[val->id] = val;
-    cache[val->id] = val;
-    return root->insert(val);
-}
-
-std::unordered_set<QuadTreeRect *> QuadTree::query(QuadTreeRect *range)
-{
-    std::unordered_set<QuadTreeRect *> result;
-    root->query(range, result);
-    return result; // 返回值（C++11的RVO会优化这个过程，避免拷贝开销）
-}
-
-// 真正需要移除时调用,会清理碰撞缓存,如果只是移动更新的,不需要此接口,走节点删除和插入,并更新
-bool QuadTree::remove(int id)
-{
-    auto it = cache[id];
-    auto list = collisionListCache[it];
-    for (auto &item : list)
-    {
-        collisionListCache[item].erase(it);
-    }
-    cache.erase(id);
-    collisionListCache.erase(it);
-    curUpdates.erase(id);
-    reinserts.erase(it);
-    return true;
-}
-
-void QuadTree::update(QuadTreeRect *val)
-{
-
-    // 不需要更新,没达到阈值
-    if (!val->update())
-    {
-        return;
-    }
-    if (val->needReInsert())
-    {
-        reinserts.emplace(val);
-    }
-    else
-    {
-        curUpdates[val->id] = val;
-    }
-}
-
-void QuadTree::tick(double dt)
-{
-    for (auto item : reinserts)
-    {
-        root->remove(item);
-        root->insert(item);
-        curUpdates[item->id] = item;
-    }
-
-    for (auto const &[id, val] : curUpdates)
-    {
-        auto preCollision = collisionListCache[val];
-        auto newCollisions = query(val);
-        // 排除自身
-        newCollisions.erase(val);
-        // 新碰撞检查
-        for (auto other : newCollisions)
-        {
-            uint64_t pairId = (val->id < other->id)
-                                  ? (static_cast<uint64_t>(val->id) << 32) | other->id
-                                  : (static_cast<uint64_t>(other->id) << 32) | val->id;
-            if (processedPairs.count(pairId))
-                continue;
-            processedPairs.emplace(pairId);
-            // 这里做个优化,变化后先遍历的碰撞则是主动碰撞,另外个是被动碰撞
-            if (preCollision.find(other) == preCollision.end())
-            {
-                //  新碰撞
-                // int dir = val->getDir(other);
-                int dir = 0;
-                auto newInfo = std::make_unique<QuadTreeCollisionInfo>();
-                auto info = newInfo.get();
-                collisionCache[pairId] = std::move(newInfo);
-                info->from = val;
-                info->to = other;
-                info->dir = dir;
-
-                val->onCollisionCallBack(other, dir, true);
-                other->onCollisionCallBack(val, dir, false);
-
-                collisionListCache[val].emplace(other);
-                collisionListCache[other].emplace(val);
-            }
-            else
-            {
-                // 旧碰撞,将主动方更新
-                auto info = collisionCache.find(pairId)->second.get();
-                info->from = val;
-                info->to = other;
-                info->dir = val->getDir(other);
-            }
-        }
-
-        // 碰撞失效检查
-        for (auto other : preCollision)
-        {
-            if (newCollisions.find(other) == newCollisions.end())
-            {
-
-                uint64_t pairId = (val->id < other->id)
-                                      ? (static_cast<uint64_t>(val->id) << 32) | other->id
-                                      : (static_cast<uint64_t>(other->id) << 32) | val->id;
-                auto info = collisionCache.find(pairId)->second.get();
-
-                collisionListCache[val].erase(other);
-                collisionListCache[other].erase(val);
-                bool from = info->from == val;
-
-                val->onCollisionOutCallBack(other, from);
-                other->onCollisionOutCallBack(val, !from);
-
-                collisionCache.erase(pairId);
-            }
-        }
-        collisionListCache[val] = newCollisions;
-    }
-
-    for (auto const &[pairId, info] : collisionCache)
-    {
-        info->from->onCollisioningCallBack(info->to, info->dir, true);
-        info->to->onCollisioningCallBack(info->from, info->dir, false);
-    }
-
-    processedPairs.clear();
-    reinserts.clear();
-    curUpdates.clear();
-}
+﻿#include "QuadTree.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+QuadTree::QuadTree(QuadTreeRect bound, int capacity, int depth) : capacity(capacity), mergeCount(capacity / 2)
+{
+    QuadTreeNode &root = nodes.emplace_back();
+    root.x = bound.x;
+    root.y = bound.y;
+    root.w = bound.w;
+    root.h = bound.h;
+    root.depth = depth;
+}
+
+bool QuadTree::add(QuadTreeRect *val)
+{
+    maxHalfW = std::max(maxHalfW, val->w / 2);
+    maxHalfH = std::max(maxHalfH, val->h / 2);
+    // 不在范围
+    if (!nodes[0].inBound(val->centerX, val->centerY))
+    {
+        return false;
+    }
+    place(0, val);
+    return true;
+}
+
+// 从 node 向下找到叶子放入, 路过的节点条目数加一; 叶子满了且未到最大深度时分裂后继续向下
+void QuadTree::place(int node, QuadTreeRect *val)
+{
+    while (true)
+    {
+        QuadTreeNode &n = nodes[node];
+        n.count++;
+        n.anyCategory |= val->category;
+        n.anyMask |= val->mask;
+        if (n.isLeaf())
+        {
+            if (static_cast<int>(n.items.size()) < capacity || n.depth >= QuadTreeNode::MAX_DEPTH)
+            {
+                n.add(val);
+                val->node = node;
+                return;
+            }
+            split(node);
+        }
+        node = childFor(node, val->centerX, val->centerY);
+    }
+}
+
+// 按西北/东北/西南/东南的顺序取第一个包含中心点的子节点; 浮点误差落在缝里时按象限取
+int QuadTree::childFor(int node, float centerX, float centerY) const
+{
+    const QuadTreeNode &n = nodes[node];
+    for (int i = 0; i < 4; ++i)
+    {
+        if (nodes[n.child + i].inBound(centerX, centerY))
+            return n.child + i;
+    }
+    return n.child + (centerX < n.x + n.w / 2 ? 0 : 1) + (centerY < n.y + n.h / 2 ? 0 : 2);
+}
+
+void QuadTree::split(int node)
+{
+    // 优先复用回收的子节点组
+    int first;
+    if (!freeChildren.empty())
+    {
+        first = freeChildren.back();
+        freeChildren.pop_back();
+    }
+    else
+    {
+        first = static_cast<int>(nodes.size());
+        nodes.resize(nodes.size() + 4);
+    }
+
+    QuadTreeNode &n = nodes[node];
+    float x = n.x;
+    float y = n.y;
+    float w = n.w / 2;
+    float h = n.h / 2;
+
+    const float looseFactor = QuadTreeNode::LOOSE_FACTOR;
+    float looseW = w * (1 + looseFactor);
+    float looseH = h * (1 + looseFactor);
+
+    float centerX = x + w;
+    float centerY = y + h;
+    const float childX[4] = {x - w * looseFactor, centerX - w * looseFactor, x - w * looseFactor, centerX - w * looseFactor};
+    const float childY[4] = {y - h * looseFactor, y - h * looseFactor, centerY - h * looseFactor, centerY - h * looseFactor};
+    for (int i = 0; i < 4; ++i)
+    {
+        QuadTreeNode &c = nodes[first + i];
+        c.x = childX[i];
+        c.y = childY[i];
+        c.w = looseW;
+        c.h = looseH;
+        c.depth = n.depth + 1;
+        c.parent = node;
+        c.child = -1;
+        c.count = 0;
+        c.anyCategory = 0;
+        c.anyMask = 0;
+        c.clearItems();
+        // 新节点一次备足容量, 之后反复复用不再分配
+        c.reserve(capacity);
+    }
+    n.child = first;
+
+    // 将本节点内容移入子节点 (本节点的条目数不变)
+    splitting.assign(n.items.begin(), n.items.end());
+    n.clearItems();
+    for (QuadTreeRect *item : splitting)
+    {
+        place(childFor(node, item->centerX, item->centerY), item);
+    }
+}
+
+// 从所在叶子移除, 并沿父节点向上减条目数、重算过滤并集; 最上面一个降到合并阈值的节点把整棵子树收回为叶子
+void QuadTree::detach(QuadTreeRect *val)
+{
+    const int leaf = val->node;
+    if (leaf < 0)
+    {
+        return;
+    }
+    nodes[leaf].erase(val->slot);
+    val->node = -1;
+    val->slot = -1;
+
+    int top = -1;
+    for (int node = leaf; node >= 0; node = nodes[node].parent)
+    {
+        QuadTreeNode &n = nodes[node];
+        n.count--;
+        if (!n.isLeaf() && n.count <= mergeCount)
+        {
+            top = node;
+        }
+    }
+    regather(leaf);
+    if (top >= 0)
+    {
+        merge(top);
+    }
+}
+
+// 从叶子向上重算各节点的过滤并集, 到 stop (不含) 为止; 合并不改变并集
+void QuadTree::regather(int leaf, int stop)
+{
+    nodes[leaf].gather();
+    for (int node = nodes[leaf].parent; node != stop; node = nodes[node].parent)
+    {
+        QuadTreeNode &n = nodes[node];
+        n.anyCategory = 0;
+        n.anyMask = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            n.anyCategory |= nodes[n.child + i].anyCategory;
+            n.anyMask |= nodes[n.child + i].anyMask;
+        }
+    }
+}
+
+void QuadTree::merge(int node)
+{
+    const int first = nodes[node].child;
+    nodes[node].child = -1;
+    for (int i = 0; i < 4; ++i)
+    {
+        const int c = first + i;
+        if (!nodes[c].isLeaf())
+        {
+            merge(c);
+        }
+        for (QuadTreeRect *item : nodes[c].items)
+        {
+            nodes[node].add(item);
+            item->node = node;
+        }
+        nodes[c].clearItems();
+        nodes[c].count = 0;
+    }
+    freeChildren.push_back(first);
+}
+
+void QuadTree::query(const QuadTreeRect *range, std::vector<QuadTreeRect *> &result) const
+{
+    query(range, [&](QuadTreeRect *item)
+          { result.push_back(item); });
+}
+
+void QuadTree::visit(const QuadTreeRect *range, void (*fn)(void *, QuadTreeRect *), void *context) const
+{
+    query(range, [&](QuadTreeRect *item)
+          { fn(context, item); });
+}
+
+void QuadTree::queryPoint(float x, float y, std::vector<QuadTreeRect *> &result, const QuadTreeRect *self) const
+{
+    descend(Filter(self), [&](float l, float t, float r, float b)
+            { return l <= x && x <= r && t <= y && y <= b; },
+            [&](const QuadTreeNode &n, size_t i)
+            {
+                if (n.minX[i] <= x && x <= n.maxX[i] && n.minY[i] <= y && y <= n.maxY[i])
+                {
+                    result.push_back(n.items[i]);
+                }
+            });
+}
+
+void QuadTree::queryCircle(float x, float y, float radius, std::vector<QuadTreeRect *> &result, const QuadTreeRect *self) const
+{
+    const float radius2 = radius * radius;
+    descend(Filter(self), [&](float l, float t, float r, float b)
+            { return distance2(x, y, l, t, r, b) <= radius2; },
+            [&](const QuadTreeNode &n, size_t i)
+            {
+                if (distance2(x, y, n.minX[i], n.minY[i], n.maxX[i], n.maxY[i]) <= radius2)
+                {
+                    result.push_back(n.items[i]);
+                }
+            });
+}
+
+bool QuadTree::raycast(float x0, float y0, float x1, float y1, RayHit &hit, const QuadTreeRect *self) const
+{
+    const Filter filter(self);
+    const float dx = x1 - x0, dy = y1 - y0;
+    QuadTreeRect *best = nullptr;
+    float bestT = 1;
+
+    // 深度优先, 栈中为待访问的节点和线段进入它的 t; 子节点按 t 从远到近入栈, 先出栈的是最先进入的
+    Pending stack[4 * (QuadTreeNode::MAX_DEPTH + 1)];
+    int size = 0;
+    float l, t, r, b, enter;
+    reach(nodes[0], l, t, r, b);
+    if (segment(x0, y0, dx, dy, l, t, r, b, bestT, enter))
+    {
+        stack[size++] = {0, enter};
+    }
+    while (size > 0)
+    {
+        const Pending top = stack[--size];
+        // 进入得比已找到的命中还晚, 子树中不会有更早的命中 (相等时还要比 id)
+        if (best && top.key > bestT)
+        {
+            continue;
+        }
+        const QuadTreeNode &n = nodes[top.node];
+        if (!filter.any(n.anyCategory, n.anyMask))
+        {
+            continue;
+        }
+        if (n.isLeaf())
+        {
+            for (size_t i = 0; i < n.items.size(); ++i)
+            {
+                if (filter.accepts(n.items[i], n.category[i], n.mask[i]) &&
+                    segment(x0, y0, dx, dy, n.minX[i], n.minY[i], n.maxX[i], n.maxY[i], bestT, enter) &&
+                    (!best || enter < bestT || n.items[i]->id < best->id))
+                {
+                    best = n.items[i];
+                    bestT = enter;
+                }
+            }
+            continue;
+        }
+        Pending children[4];
+        int count = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            reach(nodes[n.child + i], l, t, r, b);
+            if (segment(x0, y0, dx, dy, l, t, r, b, bestT, enter))
+            {
+                // 插入排序, 按 t 从大到小
+                int j = count++;
+                for (; j > 0 && children[j - 1].key < enter; --j)
+                {
+                    children[j] = children[j - 1];
+                }
+                children[j] = {n.child + i, enter};
+            }
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            stack[size++] = children[i];
+        }
+    }
+    if (!best)
+    {
+        return false;
+    }
+    hit.item = best;
+    hit.t = bestT;
+    hit.x = x0 + dx * bestT;
+    hit.y = y0 + dy * bestT;
+    return true;
+}
+
+void QuadTree::nearest(float x, float y, int k, std::vector<Neighbor> &result, const QuadTreeRect *self) const
+{
+    result.clear();
+    if (k <= 0)
+    {
+        return;
+    }
+    const Filter filter(self);
+    // 条目不多时优先队列和节点距离的开销比逐个比较还大, 直接扫所有叶子 (回收的节点和内部节点没有条目)
+    if (nodes[0].count < NEAREST_SCAN_COUNT)
+    {
+        for (const QuadTreeNode &n : nodes)
+        {
+            for (size_t i = 0; i < n.items.size(); ++i)
+            {
+                if (filter.accepts(n.items[i], n.category[i], n.mask[i]))
+                {
+                    offer(result, k, n.items[i], distance2(x, y, n.minX[i], n.minY[i], n.maxX[i], n.maxY[i]));
+                }
+            }
+        }
+        std::sort_heap(result.begin(), result.end(), nearer);
+        return;
+    }
+    // 按节点范围到该点的距离从近到远访问
+    frontier.clear();
+    float l, t, r, b;
+    reach(nodes[0], l, t, r, b);
+    frontier.push_back({0, distance2(x, y, l, t, r, b)});
+    while (!frontier.empty())
+    {
+        std::pop_heap(frontier.begin(), frontier.end(), Later());
+        const Pending top = frontier.back();
+        frontier.pop_back();
+        // 剩下的节点都比目前第 k 近的远; 相等时仍要进入, 其中可能有距离相同而 id 更小的条目
+        if (top.key > farthest(result, k))
+        {
+            break;
+        }
+        const QuadTreeNode &n = nodes[top.node];
+        if (!filter.any(n.anyCategory, n.anyMask))
+        {
+            continue;
+        }
+        if (n.isLeaf())
+        {
+            for (size_t i = 0; i < n.items.size(); ++i)
+            {
+                if (filter.accepts(n.items[i], n.category[i], n.mask[i]))
+                {
+                    offer(result, k, n.items[i], distance2(x, y, n.minX[i], n.minY[i], n.maxX[i], n.maxY[i]));
+                }
+            }
+            continue;
+        }
+        const float limit = farthest(result, k);
+        for (int i = 0; i < 4; ++i)
+        {
+            reach(nodes[n.child + i], l, t, r, b);
+            const float d2 = distance2(x, y, l, t, r, b);
+            if (d2 <= limit)
+            {
+                frontier.push_back({n.child + i, d2});
+                std::push_heap(frontier.begin(), frontier.end(), Later());
+            }
+        }
+    }
+    std::sort_heap(result.begin(), result.end(), nearer);
+}
+
+void QuadTree::drop(QuadTreeRect *val)
+{
+    detach(val);
+}
+
+void QuadTree::refresh(QuadTreeRect *val)
+{
+    if (val->node >= 0 && nodes[val->node].refresh(val->slot))
+    {
+        regather(val->node);
+    }
+    maxHalfW = std::max(maxHalfW, val->w / 2);
+    maxHalfH = std::max(maxHalfH, val->h / 2);
+}
+
+// 中心离开所在叶子的重新归属, 不在树中的移入范围后加入
+void QuadTree::prepare()
+{
+    const auto start = std::chrono::steady_clock::now();
+    relocateStats = {};
+    for (auto item : updates)
+    {
+        if (item->node < 0)
+        {
+            if (nodes[0].inBound(item->centerX, item->centerY))
+            {
+                place(0, item);
+            }
+            continue;
+        }
+        if (!nodes[item->node].inBound(item->centerX, item->centerY))
+        {
+            relocate(item);
+        }
+    }
+    relocateStats.relocateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 向上找到最近的包含新中心的祖先, 只在它的子树内移走再放入: 祖先及以上的条目数和过滤并集都不变
+// 帧间位移很小, 通常只上一两层; 离开整棵树时同 detach
+void QuadTree::relocate(QuadTreeRect *val)
+{
+    const int leaf = val->node;
+    int target = nodes[leaf].parent;
+    while (target >= 0 && !nodes[target].inBound(val->centerX, val->centerY))
+    {
+        target = nodes[target].parent;
+        relocateStats.levels++;
+    }
+    relocateStats.relocated++;
+    if (target < 0)
+    {
+        detach(val);
+        return;
+    }
+
+    nodes[leaf].erase(val->slot);
+    // 祖先的条目数先减一, 放入时再加回来; 祖先自己不参与合并
+    int top = -1;
+    for (int node = leaf; node != target; node = nodes[node].parent)
+    {
+        QuadTreeNode &n = nodes[node];
+        n.count--;
+        if (!n.isLeaf() && n.count <= mergeCount)
+        {
+            top = node;
+        }
+    }
+    nodes[target].count--;
+    regather(leaf, target);
+    if (top >= 0)
+    {
+        merge(top);
+    }
+    place(target, val);
+}
@@ -1,36 +1,174 @@
-﻿#pragma once
-#include "QuadTreeNode.h"
-#include <unordered_map>
-#include <unordered_set>
-class QuadTree
-{
-public:
-    static std::unique_ptr<QuadTree> WORLD;
-    QuadTree(QuadTreeRect bound, int capacity, int depth = 0);
-
-    // 根节点
-    std::unique_ptr<QuadTreeNode> root;
-
-    // 插入
-    bool insert(QuadTreeRect *val);
-
-    // 查询
-    std::unordered_set<QuadTreeRect *> query(QuadTreeRect *range);
-
-    // 物体位置大小变化时会手动调用
-    void update(QuadTreeRect *val);
-
-    // 删除
-    bool remove(int id);
-
-    // 每帧检查需要更新的对象并触发已碰撞对象的碰撞中接口
-    void tick(double dt);
-    // 记录两两碰撞时的来源方
-    std::unordered_map<uint64_t, std::unique_ptr<QuadTreeCollisionInfo>> collisionCache;
-    std::unordered_map<QuadTreeRect *, std::unordered_set<QuadTreeRect *>> collisionListCache;
-    std::unordered_map<int, QuadTreeRect *> cache;
-    std::unordered_map<int, QuadTreeRect *> curUpdates;
-    std::unordered_set<QuadTreeRect *> reinserts;
-    std::unordered_set<uint64_t> processedPairs;
-private:
-};
\ No newline at end of file
+﻿#pragma once
+#include "Broadphase.h"
+#include "QuadTreeNode.h"
+// 松散四叉树: 条目按中心归属叶子, 适合在两个方向上都分散的场景
+class QuadTree : public Broadphase
+{
+public:
+    QuadTree(QuadTreeRect bound, int capacity, int depth = 0);
+
+    // 节点池, 0 为根节点
+    std::vector<QuadTreeNode> nodes;
+
+    using Broadphase::query;
+    void query(const QuadTreeRect *range, std::vector<QuadTreeRect *> &result) const override;
+    // 查询, 对每个相交的条目调用 visit(QuadTreeRect *); 遍历期间不能增删条目
+    template <typename Visit>
+    void query(const QuadTreeRect *range, Visit &&visit) const;
+
+    // 射线深度优先, 子节点按线段进入的先后访问, 比已找到的命中进入得晚的子树不再进入
+    bool raycast(float x0, float y0, float x1, float y1, RayHit &hit, const QuadTreeRect *self = nullptr) const override;
+    void queryCircle(float x, float y, float radius, std::vector<QuadTreeRect *> &result, const QuadTreeRect *self = nullptr) const override;
+    void queryPoint(float x, float y, std::vector<QuadTreeRect *> &result, const QuadTreeRect *self = nullptr) const override;
+    // 最近一次 tick 中重新归属叶子的统计
+    struct Stats
+    {
+        int relocated = 0;       // 中心离开所在叶子的条目数
+        int levels = 0;          // 找包含新中心的祖先时, 在父节点之上多走的层数之和
+        double relocateMs = 0;   // prepare 的耗时
+    };
+    const Stats &stats() const
+    {
+        return relocateStats;
+    }
+
+    // 按节点范围离该点的远近依次访问 (优先队列), 比目前第 k 近的更远的节点不再访问; 条目少时直接扫所有叶子;
+    // 优先队列是成员, 不能在多个线程中同时调用
+    // 大量条目互相重叠时 (横版关卡挤在一条线上) 距离为 0 的节点都要进入比较 id, 比扫描还慢, 这类场景用 SweepAndPrune
+    void nearest(float x, float y, int k, std::vector<Neighbor> &result, const QuadTreeRect *self = nullptr) const override;
+
+protected:
+    bool add(QuadTreeRect *val) override;
+    void drop(QuadTreeRect *val) override;
+    void refresh(QuadTreeRect *val) override;
+    void prepare() override;
+    void visit(const QuadTreeRect *range, void (*fn)(void *, QuadTreeRect *), void *context) const override;
+
+private:
+    // 叶子超过容量时分裂; 子树条目数降到 mergeCount 以下才合并, 两个阈值错开, 在容量附近来回进出不会反复分裂合并
+    int capacity;
+    int mergeCount;
+    // 已回收的子节点组 (第一个子节点下标)
+    std::vector<int> freeChildren;
+    // 分裂时暂存被移走的条目
+    std::vector<QuadTreeRect *> splitting;
+    // raycast / nearest 待访问的节点, key 为线段进入节点的 t 或节点范围到查询点距离的平方
+    struct Pending
+    {
+        int node;
+        float key;
+    };
+    // 条目数少于这个数时 nearest 直接扫所有叶子; 实测平面散布约 550 个、横版约 1200 个以下扫描更快, 取两者中小的
+    static constexpr int NEAREST_SCAN_COUNT = 512;
+    // nearest 的优先队列, 按 key 的小顶堆, 帧间复用
+    mutable std::vector<Pending> frontier;
+    struct Later
+    {
+        bool operator()(const Pending &a, const Pending &b) const
+        {
+            return a.key > b.key;
+        }
+    };
+    Stats relocateStats;
+    // 条目的最大半宽高; 条目只按中心归属节点, 查询剪枝时节点范围要向外扩这么多才不会漏掉伸出节点的条目
+    float maxHalfW = 0, maxHalfH = 0;
+
+    // 子树中条目包围盒可能覆盖的范围: 条目中心在子孙节点的松散范围内 (可能还有未触发更新的小位移), 再外扩条目最大半宽高
+    void reach(const QuadTreeNode &n, float &left, float &top, float &right, float &bottom) const
+    {
+        const float padW = maxHalfW + QuadTreeRect::UPDATE_THRESHOLD;
+        const float padH = maxHalfH + QuadTreeRect::UPDATE_THRESHOLD;
+        left = n.x - n.w * QuadTreeNode::LOOSE_REACH - padW;
+        top = n.y - n.h * QuadTreeNode::LOOSE_REACH - padH;
+        right = n.x + n.w + padW;
+        bottom = n.y + n.h + padH;
+    }
+    // 深度优先遍历: enter(left, top, right, bottom) 决定是否进入子树的范围, 叶子中满足过滤条件的条目交给 leaf(n, i)
+    template <typename Enter, typename Leaf>
+    void descend(const Filter &filter, Enter &&enter, Leaf &&leaf) const;
+
+    void place(int node, QuadTreeRect *val);
+    int childFor(int node, float centerX, float centerY) const;
+    void split(int node);
+    void detach(QuadTreeRect *val);
+    void relocate(QuadTreeRect *val);
+    void regather(int leaf, int stop = -1);
+    void merge(int node);
+};
+
+template <typename Visit>
+void QuadTree::query(const QuadTreeRect *range, Visit &&visit) const
+{
+    const float left = range->x, right = range->x + range->w;
+    const float top = range->y, bottom = range->y + range->h;
+    const uint32_t category = range->category, mask = range->mask;
+
+    // 深度有限, 用定长栈代替递归; 子节点逆序入栈, 按西北/东北/西南/东南的顺序访问
+    int stack[4 * (QuadTreeNode::MAX_DEPTH + 1)];
+    int size = 0;
+    stack[size++] = 0;
+    while (size > 0)
+    {
+        const QuadTreeNode &n = nodes[stack[--size]];
+        // 子树中没有能与查询范围碰撞的分类
+        if (!(n.anyCategory & mask) || !(n.anyMask & category))
+        {
+            continue;
+        }
+        float l, t, r, b;
+        reach(n, l, t, r, b);
+        if (right < l || left > r || bottom < t || top > b)
+        {
+            continue;
+        }
+        if (n.isLeaf())
+        {
+            for (size_t i = 0; i < n.items.size(); ++i)
+            {
+                if ((n.category[i] & mask) && (n.mask[i] & category) &&
+                    !(right < n.minX[i] || left > n.maxX[i] || bottom < n.minY[i] || top > n.maxY[i]))
+                {
+                    visit(n.items[i]);
+                }
+            }
+            continue;
+        }
+        for (int i = 3; i >= 0; --i)
+        {
+            stack[size++] = n.child + i;
+        }
+    }
+}
+
+template <typename Enter, typename Leaf>
+void QuadTree::descend(const Filter &filter, Enter &&enter, Leaf &&leaf) const
+{
+    int stack[4 * (QuadTreeNode::MAX_DEPTH + 1)];
+    int size = 0;
+    stack[size++] = 0;
+    while (size > 0)
+    {
+        const QuadTreeNode &n = nodes[stack[--size]];
+        float l, t, r, b;
+        reach(n, l, t, r, b);
+        if (!filter.any(n.anyCategory, n.anyMask) || !enter(l, t, r, b))
+        {
+            continue;
+        }
+        if (n.isLeaf())
+        {
+            for (size_t i = 0; i < n.items.size(); ++i)
+            {
+                if (filter.accepts(n.items[i], n.category[i], n.mask[i]))
+                {
+                    leaf(n, i);
+                }
+            }
+            continue;
+        }
+        for (int i = 3; i >= 0; --i)
+        {
+            stack[size++] = n.child + i;
+        }
+    }
+}
@@ -1,10 +1,13 @@
-﻿#pragma once
-class QuadTreeRect;
-
-class QuadTreeCollisionInfo
-{
-public:
-    QuadTreeRect *from;
-    QuadTreeRect *to;
-    int dir;
+﻿#pragma once
+#include <cstdint>
+class QuadTreeRect;
+
+class QuadTreeCollisionInfo
+{
+public:
+    // 碰撞对 id, 见 QuadTreePairs::pairId
+    uint64_t id;
+    QuadTreeRect *from;
+    QuadTreeRect *to;
+    int dir;
 };
\ No newline at end of file
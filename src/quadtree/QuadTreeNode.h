@@ -1,46 +1,55 @@
-﻿#pragma once
-#include <vector>
-#include <memory>
-#include <unordered_set>
-
-#include "QuadTreeRect.h"
-class QuadTreeNode
-{
-public:
- // 最大深度,达到后不再分裂
- static const int MAX_DEPTH = 7;
-    QuadTreeNode(QuadTreeRect rect, int capacity, int depth = 0);
-
-    // 范围
-    QuadTreeRect bound;
-    // 数据
-    std::vector<QuadTreeRect *> vals;
-    // 分裂
-    bool isSub = false;
-    // 容量
-    int capacity;
-    // 深度
-    int depth;
-    // 西北
-    std::unique_ptr<QuadTreeNode> nw;
-    // 东北
-    std::unique_ptr<QuadTreeNode> ne;
-    // 西南
-    std::unique_ptr<QuadTreeNode> sw;
-    // 东南
-    std::unique_ptr<QuadTreeNode> se;
-
-    // 插入
-    bool insert(QuadTreeRect *val);
-
-    // 查找
-    void query(QuadTreeRect *range, std::unordered_set<QuadTreeRect *> &result);
-
-    // 删除
-    bool remove(QuadTreeRect *val);
-    // 分裂
-    void sub();
-
-private:
-    bool tryMergeChildren();
-};
\ No newline at end of file
+﻿#pragma once
+#include <vector>
+
+#include "QuadTreeRect.h"
+// 四叉树节点, 统一存放在 QuadTree::nodes 节点池中, 用下标互相引用
+// 四个子节点是池中连续的一组, 合并后整组回收到空闲表, 下次分裂时连同条目数组的容量一起复用
+class QuadTreeNode
+{
+public:
+    // 最大深度,达到后不再分裂
+    static const int MAX_DEPTH = 7;
+    // 松散因子,使用松散边界，扩大每个子节点的范围,解决节点矩形超出节点本身范围的问题
+    // 子节点只向左上方超出父节点, 逐层累加后整棵子树最多超出本节点宽高的 LOOSE_FACTOR / (1 - LOOSE_FACTOR)
+    static constexpr float LOOSE_FACTOR = 0.35f;
+    static constexpr float LOOSE_REACH = LOOSE_FACTOR / (1 - LOOSE_FACTOR);
+
+    // 松散范围, 条目按中心点归属
+    float x = 0, y = 0, w = 0, h = 0;
+    // 深度
+    int depth = 0;
+    // 父节点, 根为 -1
+    int parent = -1;
+    // 第一个子节点, 依次为西北/东北/西南/东南; -1 为叶子
+    int child = -1;
+    // 子树内的条目数
+    int count = 0;
+    // 子树内条目 category / mask 的并集, 查询时与查询范围的过滤条件不相容的整棵子树直接跳过
+    uint32_t anyCategory = 0, anyMask = 0;
+
+    // 条目只存放在叶子中, 包围盒按 SoA 排列, 查询时只扫这几组连续的浮点数
+    std::vector<QuadTreeRect *> items;
+    std::vector<float> minX, minY, maxX, maxY;
+    std::vector<uint32_t> category, mask;
+
+    bool isLeaf() const
+    {
+        return child < 0;
+    }
+    bool inBound(float centerX, float centerY) const
+    {
+        return x <= centerX && centerX <= x + w && y <= centerY && centerY <= y + h;
+    }
+
+    // 追加条目, 下标记在 QuadTreeRect::slot
+    void add(QuadTreeRect *val);
+    // 用最后一个条目填补空位, 并更新它的 slot
+    void erase(int slot);
+    // 更新条目的包围盒和过滤条件, 返回过滤条件是否变了
+    bool refresh(int slot);
+    // 按叶子中的条目重新计算 anyCategory / anyMask
+    void gather();
+    // 清空条目, 保留数组容量
+    void clearItems();
+    void reserve(int size);
+};
@@ -0,0 +1,126 @@
+﻿#include "QuadTreePairs.h"
+
+size_t QuadTreePairs::home(uint64_t id) const
+{
+    // splitmix64 的末段, 打散相邻的 id
+    id ^= id >> 30;
+    id *= 0xbf58476d1ce4e5b9ull;
+    id ^= id >> 27;
+    id *= 0x94d049bb133111ebull;
+    id ^= id >> 31;
+    return static_cast<size_t>(id) & (keys.size() - 1);
+}
+
+// 返回 id 所在的槽, 不在表中时返回它应该放入的空槽
+size_t QuadTreePairs::slotOf(uint64_t id) const
+{
+    size_t slot = home(id);
+    while (keys[slot] != EMPTY && keys[slot] != id)
+    {
+        slot = (slot + 1) & (keys.size() - 1);
+    }
+    return slot;
+}
+
+QuadTreeCollisionInfo *QuadTreePairs::find(uint64_t id)
+{
+    if (keys.empty())
+    {
+        return nullptr;
+    }
+    size_t slot = slotOf(id);
+    return keys[slot] == EMPTY ? nullptr : &infos[index[slot]];
+}
+
+QuadTreeCollisionInfo *QuadTreePairs::find(uint64_t id, int hint)
+{
+    if (hint >= 0 && hint < static_cast<int>(infos.size()) && infos[hint].id == id)
+    {
+        return &infos[hint];
+    }
+    return find(id);
+}
+
+int QuadTreePairs::indexOf(uint64_t id) const
+{
+    if (keys.empty())
+    {
+        return -1;
+    }
+    size_t slot = slotOf(id);
+    return keys[slot] == EMPTY ? -1 : index[slot];
+}
+
+QuadTreeCollisionInfo &QuadTreePairs::add(uint64_t id)
+{
+    if ((infos.size() + 1) * 2 > keys.size())
+    {
+        grow();
+    }
+    size_t slot = slotOf(id);
+    keys[slot] = id;
+    index[slot] = static_cast<int>(infos.size());
+    QuadTreeCollisionInfo &info = infos.emplace_back();
+    info.id = id;
+    return info;
+}
+
+bool QuadTreePairs::erase(uint64_t id)
+{
+    if (keys.empty())
+    {
+        return false;
+    }
+    const size_t mask = keys.size() - 1;
+    size_t slot = slotOf(id);
+    if (keys[slot] == EMPTY)
+    {
+        return false;
+    }
+
+    // 最后一个碰撞信息移到空位
+    const int pos = index[slot];
+    const int last = static_cast<int>(infos.size()) - 1;
+    if (pos != last)
+    {
+        infos[pos] = infos[last];
+        index[slotOf(infos[pos].id)] = pos;
+    }
+    infos.pop_back();
+
+    // 后移删除: 把后面探测链上能放回空位的 key 前移
+    size_t hole = slot;
+    size_t next = (hole + 1) & mask;
+    while (keys[next] != EMPTY)
+    {
+        const size_t want = home(keys[next]);
+        // want 不在 (hole, next] 之间时, next 可以移到 hole
+        if (((next - want) & mask) >= ((next - hole) & mask))
+        {
+            keys[hole] = keys[next];
+            index[hole] = index[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    keys[hole] = EMPTY;
+    return true;
+}
+
+void QuadTreePairs::clear()
+{
+    infos.clear();
+    keys.assign(keys.size(), EMPTY);
+}
+
+void QuadTreePairs::grow()
+{
+    keys.assign(keys.empty() ? 64 : keys.size() * 2, EMPTY);
+    index.assign(keys.size(), 0);
+    for (size_t i = 0; i < infos.size(); ++i)
+    {
+        size_t slot = slotOf(infos[i].id);
+        keys[slot] = infos[i].id;
+        index[slot] = static_cast<int>(i);
+    }
+}
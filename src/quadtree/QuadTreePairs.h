@@ -0,0 +1,54 @@
+﻿#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "QuadTreeCollisionInfo.h"
+// 碰撞对表
+// 碰撞信息按值连续存放, 每帧遍历只扫一段连续内存; 另有一张开放寻址 (线性探测) 的表按碰撞对 id 找下标。
+// 删除时用最后一个碰撞信息填补空位, 探测表用后移删除, 不留墓碑。容量只在碰撞对变多时翻倍增长。
+class QuadTreePairs
+{
+public:
+    // 两个 id 组成的碰撞对 id, 小的在高位
+    static uint64_t pairId(int a, int b)
+    {
+        return a < b ? (static_cast<uint64_t>(a) << 32) | static_cast<uint32_t>(b)
+                     : (static_cast<uint64_t>(b) << 32) | static_cast<uint32_t>(a);
+    }
+
+    QuadTreeCollisionInfo *find(uint64_t id);
+    // 先看 hint 处 (之前 indexOf 的结果, 之后可能因删除被移走), 不是再查表
+    QuadTreeCollisionInfo *find(uint64_t id, int hint);
+    // 在 begin() 起的下标, 不在表中为 -1; 只读, 表不变时可以多线程同时调用
+    int indexOf(uint64_t id) const;
+    // id 须不在表中
+    QuadTreeCollisionInfo &add(uint64_t id);
+    bool erase(uint64_t id);
+    void clear();
+
+    size_t size() const
+    {
+        return infos.size();
+    }
+    std::vector<QuadTreeCollisionInfo>::iterator begin()
+    {
+        return infos.begin();
+    }
+    std::vector<QuadTreeCollisionInfo>::iterator end()
+    {
+        return infos.end();
+    }
+
+private:
+    static constexpr uint64_t EMPTY = ~0ull;
+
+    size_t home(uint64_t id) const;
+    size_t slotOf(uint64_t id) const;
+    void grow();
+
+    std::vector<QuadTreeCollisionInfo> infos;
+    // 探测表, 容量为 2 的幂, 装载率不超过一半
+    std::vector<uint64_t> keys;
+    std::vector<int> index;
+};
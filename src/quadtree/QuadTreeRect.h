@@ -1,30 +1,45 @@
-﻿#pragma once
-#include <unordered_set>
-#include <unordered_map>
-#include <functional>
-
-#include "QuadTreeCollisionInfo.h"
-
-class QuadTreeRect
-{
-public:
-    QuadTreeRect(float x, float y, float w, float h, int id = 0, void *val = nullptr);
-    QuadTreeRect(const QuadTreeRect &other);
-    int id;
-    float x, y, w, h, centerX, centerY;
-    float lastUpdateX, lastUpdateY;
-    bool updateFlag = false;
-    static const float UPDATE_THRESHOLD;
-    QuadTreeRect *parent;
-    void *val;
-
-    std::function<void(void *, int, bool)> onCollisionCallBack;
-    std::function<void(void *, int, bool)> onCollisioningCallBack;
-    std::function<void(void *, bool)> onCollisionOutCallBack;
-    bool contains(QuadTreeRect *other);
-
-    bool inBound(float centerX, float centerY);
-    bool needReInsert();
-    bool update();
-    int getDir(QuadTreeRect *other);
+﻿#pragma once
+#include <unordered_set>
+#include <unordered_map>
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+#include "QuadTreeCollisionInfo.h"
+
+class QuadTreeRect
+{
+public:
+    QuadTreeRect(float x, float y, float w, float h, int id = 0, void *val = nullptr);
+    QuadTreeRect(const QuadTreeRect &other);
+    int id;
+    float x, y, w, h, centerX, centerY;
+    float lastUpdateX, lastUpdateY;
+    // 已在 Broadphase::updates 中
+    bool updateFlag = false;
+    // 在 Broadphase::updates 中的下标, 只在 tick 中有效
+    uint32_t updateIndex = 0;
+    // Broadphase::tick 用的批次标记: 哪次 tick 已处理过
+    uint32_t tickMark = 0;
+    // 碰撞过滤: 双方的 category 都在对方的 mask 中才会碰撞; 查询只返回与查询范围满足同样条件的条目
+    // 加入碰撞世界后要通过 Broadphase::setFilter 修改, 索引中的副本才会同步
+    uint32_t category = 1;
+    uint32_t mask = ~0u;
+    // 当前碰撞中的对象, 按 id 排序
+    std::vector<QuadTreeRect *> contacts;
+    static const float UPDATE_THRESHOLD;
+    // 所在的叶子节点 (QuadTree::nodes 下标), 不在树中为 -1
+    int node = -1;
+    // 在所在叶子 / SweepAndPrune / SpatialHash 中的条目下标, 不在其中为 -1
+    int slot = -1;
+    void *val;
+
+    std::function<void(void *, int, bool)> onCollisionCallBack;
+    std::function<void(void *, int, bool)> onCollisioningCallBack;
+    std::function<void(void *, bool)> onCollisionOutCallBack;
+    bool contains(QuadTreeRect *other);
+
+    bool inBound(float centerX, float centerY);
+    bool update();
+    int getDir(QuadTreeRect *other);
 };
\ No newline at end of file
@@ -1,201 +1,477 @@
-﻿#pragma once
-#include <iostream>
-#include <random>
-#include <chrono>
-#include <vector>
-#include <conio.h>
-#include "QuadTree.h"
-
-using namespace std;
-using namespace std::chrono;
-
-// 生成随机浮点数
-float randomFloat(float min, float max)
-{
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> dis(min, max);
-    return dis(gen);
-}
-
-int test()
-{
-    // 四叉树边界 (0,0) 到 (1000,1000)
-    QuadTreeRect bound(0, 0, 1000, 1000);
-    QuadTree tree(bound, 4); // 容量4，最大深度8
-
-    const int OBJECT_COUNT = 1000; // 物体数量
-    const int FRAMES = 1000;       // 测试帧数
-
-    // 创建物体
-    vector<QuadTreeRect *> objects;
-    for (int i = 0; i < OBJECT_COUNT; ++i)
-    {
-        float x = randomFloat(0, 900);
-        float y = randomFloat(0, 900);
-        float w = randomFloat(10, 50);
-        float h = randomFloat(10, 50);
-
-        auto *obj = new QuadTreeRect(x, y, w, h, i);
-        tree.insert(obj);
-        objects.push_back(obj);
-    }
-
-    // 为每个物体设置随机速度
-    vector<pair<float, float>> velocities;
-    for (int i = 0; i < OBJECT_COUNT; ++i)
-    {
-        velocities.emplace_back(randomFloat(-5, 5), randomFloat(-5, 5));
-    }
-
-    // 开始性能测试
-    auto start = high_resolution_clock::now();
-
-    for (int frame = 0; frame < FRAMES; ++frame)
-    {
-        // 更新所有物体位置
-        for (int i = 0; i < OBJECT_COUNT; ++i)
-        {
-            auto *obj = objects[i];
-            auto &vel = velocities[i];
-
-            // 移动物体
-            obj->x += vel.first;
-            obj->y += vel.second;
-
-            // 边界反弹
-            if (obj->x < 0 || obj->x + obj->w > 1000)
-            {
-                vel.first = -vel.first;
-                obj->x += vel.first * 2; // 防止卡在边界
-            }
-            if (obj->y < 0 || obj->y + obj->h > 1000)
-            {
-                vel.second = -vel.second;
-                obj->y += vel.second * 2;
-            }
-
-            // 更新四叉树
-            tree.update(obj);
-        }
-
-        // 执行碰撞检测
-        tree.tick(1.0 / 60.0); // 假设60FPS
-
-        for (auto obj : objects)
-        {
-            // if (obj->collisioning.size() > 0 || obj->collisionDir.size() > 0)
-            // {
-            //     cout << "obj info: " << obj->id << " collisioning size: " << obj->collisioning.size() << " dir size: " << obj->collisionDir.size() << endl;
-            // }
-            // if (obj->collisionDir.size() != obj->collisioning.size())
-            // {
-            //     cout << "err obj info: " << obj->id << " collisioning size: " << obj->collisioning.size() << " dir size: " << obj->collisionDir.size() << endl;
-            // }
-        }
-    }
-
-    auto end = high_resolution_clock::now();
-    auto duration = duration_cast<milliseconds>(end - start);
-
-    // 输出性能结果
-    cout << "test suc!" << endl;
-    cout << "num: " << OBJECT_COUNT << endl;
-    cout << "fps: " << FRAMES << endl;
-    cout << "time: " << duration.count() << "ms" << endl;
-    cout << "each tick time: " << duration.count() / (double)FRAMES << "ms" << endl;
-    cout << "each fps: " << FRAMES / (duration.count() / 1000.0) << endl;
-
-    cout << "each fps: " << FRAMES / (duration.count() / 1000.0) << endl;
-    // 清理内存
-    for (auto obj : objects)
-    {
-        // cout << "obj info: " << obj->id << " collisioning size: " << obj->collisioning.size() << " dir size: " << obj->collisionDir.size() << endl;
-        delete obj;
-    }
-    return 0;
-}
-
-void test1()
-{
-    // 四叉树边界 (0,0) 到 (1000,1000)
-    QuadTreeRect bound(0, 0, 1000, 1000);
-    QuadTree tree(bound, 4); // 容量4，最大深度8
-
-    QuadTreeRect *rect1 = new QuadTreeRect(0, 100, 10, 10, 1);
-    QuadTreeRect *rect2 = new QuadTreeRect(100, 100, 100, 100, 2);
-
-    // 插入矩形到四叉树
-    tree.insert(rect1);
-    tree.insert(rect2);
-
-    cout << "QuadTree Debug Test" << endl;
-    cout << "Commands: w (up), s (down), a (left), d (right), q (quit)" << endl;
-
-    string command;
-    while (true)
-    {
-        cout << "Enter command: ";
-        getline(cin, command);
-
-        if (command.empty())
-            continue;
-
-        char key = tolower(command[0]);
-        float moveAmount = 10.0f;
-
-        switch (key)
-        {
-        case 'w': // 上移
-            rect1->y -= moveAmount;
-            break;
-        case 's': // 下移
-            rect1->y += moveAmount;
-            break;
-        case 'a': // 左移
-            rect1->x -= moveAmount;
-            break;
-        case 'd': // 右移
-            rect1->x += moveAmount;
-            break;
-        case 'q': // 退出
-            goto exit_loop;
-        default:
-            cout << "Invalid command. Use w, a, s, d, or q." << endl;
-            continue;
-        }
-
-        // 边界检查
-        if (rect1->x < 0)
-            rect1->x = 0;
-        if (rect1->x + rect1->w > 1000)
-            rect1->x = 1000 - rect1->w;
-        if (rect1->y < 0)
-            rect1->y = 0;
-        if (rect1->y + rect1->h > 1000)
-            rect1->y = 1000 - rect1->h;
-
-        // 更新四叉树中的rect1位置
-        tree.update(rect1);
-
-        // 执行碰撞检测
-        tree.tick(1.0 / 60.0);
-
-        // 显示当前位置
-        cout << "Rect1 position: (" << rect1->x << ", " << rect1->y << ")" << endl;
-
-        // 查询与rect1碰撞的所有对象
-        auto collisions = tree.query(rect1);
-        cout << "Collisions with Rect1: " << collisions.size() << endl;
-        for (auto obj : collisions)
-        {
-            if (obj != rect1) // 跳过自己
-                cout << "  - Rect" << obj->id << endl;
-        }
-    }
-exit_loop:
-
-    // 清理内存
-    delete rect1;
-    delete rect2;
+﻿#pragma once
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <vector>
+#include <conio.h>
+#include "QuadTree.h"
+#include "SweepAndPrune.h"
+#include "SpatialHash.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// 生成随机浮点数
+float randomFloat(float min, float max)
+{
+    static std::random_device rd;
+    static std::mt19937 gen(rd());
+    std::uniform_real_distribution<float> dis(min, max);
+    return dis(gen);
+}
+
+int test()
+{
+    // 四叉树边界 (0,0) 到 (1000,1000)
+    QuadTreeRect bound(0, 0, 1000, 1000);
+    QuadTree tree(bound, 4); // 容量4，最大深度8
+
+    const int OBJECT_COUNT = 1000; // 物体数量
+    const int FRAMES = 1000;       // 测试帧数
+
+    // 创建物体
+    vector<QuadTreeRect *> objects;
+    for (int i = 0; i < OBJECT_COUNT; ++i)
+    {
+        float x = randomFloat(0, 900);
+        float y = randomFloat(0, 900);
+        float w = randomFloat(10, 50);
+        float h = randomFloat(10, 50);
+
+        auto *obj = new QuadTreeRect(x, y, w, h, i);
+        // 碰撞回调不能为空
+        obj->onCollisionCallBack = [](void *, int, bool) {};
+        obj->onCollisioningCallBack = [](void *, int, bool) {};
+        obj->onCollisionOutCallBack = [](void *, bool) {};
+        tree.insert(obj);
+        objects.push_back(obj);
+    }
+
+    // 为每个物体设置随机速度
+    vector<pair<float, float>> velocities;
+    for (int i = 0; i < OBJECT_COUNT; ++i)
+    {
+        velocities.emplace_back(randomFloat(-5, 5), randomFloat(-5, 5));
+    }
+
+    // 开始性能测试
+    auto start = high_resolution_clock::now();
+    double relocateMs = 0; // 每帧 prepare 中重新放置移动物体的耗时之和
+    long long relocated = 0, levels = 0;
+
+    for (int frame = 0; frame < FRAMES; ++frame)
+    {
+        // 更新所有物体位置
+        for (int i = 0; i < OBJECT_COUNT; ++i)
+        {
+            auto *obj = objects[i];
+            auto &vel = velocities[i];
+
+            // 移动物体
+            obj->x += vel.first;
+            obj->y += vel.second;
+
+            // 边界反弹
+            if (obj->x < 0 || obj->x + obj->w > 1000)
+            {
+                vel.first = -vel.first;
+                obj->x += vel.first * 2; // 防止卡在边界
+            }
+            if (obj->y < 0 || obj->y + obj->h > 1000)
+            {
+                vel.second = -vel.second;
+                obj->y += vel.second * 2;
+            }
+
+            // 更新四叉树
+            tree.update(obj);
+        }
+
+        // 执行碰撞检测
+        tree.tick(1.0 / 60.0); // 假设60FPS
+        relocateMs += tree.stats().relocateMs;
+        relocated += tree.stats().relocated;
+        levels += tree.stats().levels;
+    }
+
+    auto end = high_resolution_clock::now();
+    auto duration = duration_cast<milliseconds>(end - start);
+
+    // 输出性能结果
+    cout << "test suc!" << endl;
+    cout << "num: " << OBJECT_COUNT << endl;
+    cout << "fps: " << FRAMES << endl;
+    cout << "time: " << duration.count() << "ms" << endl;
+    cout << "each tick time: " << duration.count() / (double)FRAMES << "ms" << endl;
+    cout << "each fps: " << FRAMES / (duration.count() / 1000.0) << endl;
+
+    cout << "nodes: " << tree.nodes.size() << endl;
+    cout << "reinsert time: " << relocateMs / FRAMES << "ms/frame, relocated: " << relocated / (double)FRAMES << "/frame, levels above parent: " << (relocated ? levels / (double)relocated : 0) << endl;
+    // 清理内存
+    for (auto obj : objects)
+    {
+        // cout << "obj info: " << obj->id << " collisioning size: " << obj->collisioning.size() << " dir size: " << obj->collisionDir.size() << endl;
+        delete obj;
+    }
+    return 0;
+}
+
+// 宽相位后端对比: 同一场景 (相同的随机种子) 分别跑三种后端
+// side 为横版场景: 物体分布在 1920 宽的一条地面附近, 几乎只沿 x 移动; 否则为 1000x1000 内各方向移动
+// zombies 为 true 时每 100 个物体中只有一个是玩家, 其余是互相不碰撞的僵尸
+double benchBroadphase(Broadphase &world, bool side, int count, int frames, bool zombies = false)
+{
+    const float width = side ? 1920.0f : 1000.0f;
+    std::mt19937 gen(12345);
+    auto random = [&](float min, float max)
+    { return std::uniform_real_distribution<float>(min, max)(gen); };
+
+    vector<QuadTreeRect *> objects;
+    vector<pair<float, float>> velocities;
+    for (int i = 0; i < count; ++i)
+    {
+        auto *obj = side ? new QuadTreeRect(random(0, width - 100), random(180, 220), random(40, 80), random(80, 120), i)
+                         : new QuadTreeRect(random(0, width - 100), random(0, width - 100), random(10, 50), random(10, 50), i);
+        obj->onCollisionCallBack = [](void *, int, bool) {};
+        obj->onCollisioningCallBack = [](void *, int, bool) {};
+        obj->onCollisionOutCallBack = [](void *, bool) {};
+        world.insert(obj);
+        if (zombies && i % 100 != 0)
+        {
+            world.setFilter(obj, 2, ~2u);
+        }
+        objects.push_back(obj);
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        velocities.emplace_back(side ? random(-3, 3) : random(-5, 5), side ? random(-0.3f, 0.3f) : random(-5, 5));
+    }
+
+    double ms = 0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            auto *obj = objects[i];
+            auto &vel = velocities[i];
+            obj->x += vel.first;
+            obj->y += vel.second;
+            if (obj->x < 0 || obj->x + obj->w > width)
+            {
+                vel.first = -vel.first;
+                obj->x += vel.first * 2;
+            }
+            if (side ? (obj->y < 170 || obj->y > 230) : (obj->y < 0 || obj->y + obj->h > width))
+            {
+                vel.second = -vel.second;
+                obj->y += vel.second * 2;
+            }
+        }
+        auto start = high_resolution_clock::now();
+        for (auto obj : objects)
+        {
+            world.update(obj);
+        }
+        world.tick(1.0 / 60.0);
+        ms += duration<double, milli>(high_resolution_clock::now() - start).count();
+    }
+    for (auto obj : objects)
+    {
+        world.remove(obj->id);
+        delete obj;
+    }
+    return ms / frames;
+}
+
+void testBroadphase()
+{
+    struct Scenario
+    {
+        bool side;
+        int count, frames;
+    };
+    for (auto [side, count, frames] : {Scenario{false, 1000, 1000}, Scenario{true, 300, 1000}, Scenario{true, 2000, 300}, Scenario{false, 3000, 300}})
+    {
+        const float width = side ? 1920.0f : 1000.0f, height = side ? 336.0f : 1000.0f;
+        QuadTree tree(QuadTreeRect(-100, -100, width * 1.5f, height * 1.5f), 4);
+        SweepAndPrune sweep;
+        SpatialHash grid(side ? 128.0f : 64.0f);
+        cout << (side ? "side " : "box ") << count << ":"
+             << " quadtree " << benchBroadphase(tree, side, count, frames) << "ms"
+             << " sweep " << benchBroadphase(sweep, side, count, frames) << "ms"
+             << " hash " << benchBroadphase(grid, side, count, frames) << "ms" << endl;
+    }
+}
+
+// tick 并行查询的线程数对比: 横版场景 5000 个僵尸挤在一起, 回调的顺序和结果与线程数无关
+// parallel 为 0 表示实测并行没有更快, 已退回串行
+void testParallelTick()
+{
+    for (int threads : {1, 2, 4, ThreadPool::hardwareThreads()})
+    {
+        SweepAndPrune sweep;
+        sweep.setThreadCount(threads);
+        double ms = benchBroadphase(sweep, true, 5000, 60, true);
+        cout << "threads " << threads << ": " << ms << "ms parallel " << sweep.parallelActive() << endl;
+    }
+}
+
+// 2000 个僵尸挤在一起: 僵尸之间碰撞与不碰撞的对比
+void testZombieFilter()
+{
+    for (bool zombies : {false, true})
+    {
+        QuadTree tree(QuadTreeRect(-100, -100, 1920 * 1.5f, 336 * 1.5f), 4);
+        SweepAndPrune sweep;
+        SpatialHash grid(128.0f);
+        cout << (zombies ? "zombie filter on:" : "zombie filter off:")
+             << " quadtree " << benchBroadphase(tree, true, 2000, 300, zombies) << "ms"
+             << " sweep " << benchBroadphase(sweep, true, 2000, 300, zombies) << "ms"
+             << " hash " << benchBroadphase(grid, true, 2000, 300, zombies) << "ms" << endl;
+    }
+}
+
+// 射线/圆/点/最近邻查询的耗时 (微秒/次); world 为空时是逐个遍历所有对象的暴力查找, 作为对照
+void benchQueries(Broadphase *world, const vector<QuadTreeRect *> &objects, float width, float height, int queries)
+{
+    std::mt19937 gen(54321);
+    auto random = [&](float min, float max)
+    { return std::uniform_real_distribution<float>(min, max)(gen); };
+    vector<QuadTreeRect *> result;
+    result.reserve(objects.size());
+    vector<Broadphase::Neighbor> neighbors;
+    neighbors.reserve(8);
+    size_t found = 0; // 防止被优化掉
+
+    auto timed = [&](const char *name, auto &&run)
+    {
+        auto start = high_resolution_clock::now();
+        for (int i = 0; i < queries; ++i)
+        {
+            run();
+        }
+        cout << " " << name << " " << duration<double, micro>(high_resolution_clock::now() - start).count() / queries << "us";
+    };
+    // 子弹: 水平 300 像素的线段
+    timed("ray", [&]()
+          {
+              const float x = random(0, width), y = random(0, height);
+              Broadphase::RayHit hit;
+              if (world)
+              {
+                  found += world->raycast(x, y, x + 300, y, hit);
+                  return;
+              }
+              QuadTreeRect *best = nullptr;
+              for (auto obj : objects)
+              {
+                  if (obj->y <= y && y <= obj->y + obj->h && obj->x + obj->w >= x && obj->x <= x + 300 &&
+                      (!best || std::max(obj->x, x) < std::max(best->x, x)))
+                  {
+                      best = obj;
+                  }
+              }
+              found += best != nullptr; });
+    // 近战: 半径 60 的圆
+    timed("circle", [&]()
+          {
+              const float x = random(0, width), y = random(0, height);
+              result.clear();
+              if (world)
+              {
+                  world->queryCircle(x, y, 60, result);
+              }
+              else
+              {
+                  for (auto obj : objects)
+                  {
+                      const float dx = std::max({obj->x - x, x - obj->x - obj->w, 0.0f});
+                      const float dy = std::max({obj->y - y, y - obj->y - obj->h, 0.0f});
+                      if (dx * dx + dy * dy <= 3600)
+                      {
+                          result.push_back(obj);
+                      }
+                  }
+              }
+              found += result.size(); });
+    timed("point", [&]()
+          {
+              const float x = random(0, width), y = random(0, height);
+              result.clear();
+              if (world)
+              {
+                  world->queryPoint(x, y, result);
+              }
+              else
+              {
+                  for (auto obj : objects)
+                  {
+                      if (obj->x <= x && x <= obj->x + obj->w && obj->y <= y && y <= obj->y + obj->h)
+                      {
+                          result.push_back(obj);
+                      }
+                  }
+              }
+              found += result.size(); });
+    // AI: 最近的 4 个
+    timed("nearest4", [&]()
+          {
+              const float x = random(0, width), y = random(0, height);
+              neighbors.clear();
+              if (world)
+              {
+                  world->nearest(x, y, 4, neighbors);
+              }
+              else
+              {
+                  for (auto obj : objects)
+                  {
+                      const float dx = std::max({obj->x - x, x - obj->x - obj->w, 0.0f});
+                      const float dy = std::max({obj->y - y, y - obj->y - obj->h, 0.0f});
+                      const float dist2 = dx * dx + dy * dy;
+                      if (neighbors.size() < 4 || dist2 < neighbors.back().dist2)
+                      {
+                          if (neighbors.size() == 4)
+                          {
+                              neighbors.pop_back();
+                          }
+                          auto at = std::find_if(neighbors.begin(), neighbors.end(), [&](const Broadphase::Neighbor &n)
+                                                 { return n.dist2 > dist2; });
+                          neighbors.insert(at, {obj, dist2});
+                      }
+                  }
+              }
+              found += neighbors.size(); });
+    cout << " (" << found << ")" << endl;
+}
+
+// 几何查询: 横版场景和平面散布场景各 2000 个静止对象
+void testSpatialQueries()
+{
+    for (bool side : {true, false})
+    {
+        const float width = side ? 1920.0f : 1000.0f, height = side ? 336.0f : 1000.0f;
+        std::mt19937 gen(12345);
+        auto random = [&](float min, float max)
+        { return std::uniform_real_distribution<float>(min, max)(gen); };
+        vector<QuadTreeRect *> objects;
+        for (int i = 0; i < 2000; ++i)
+        {
+            objects.push_back(side ? new QuadTreeRect(random(0, width - 100), random(180, 220), random(40, 80), random(80, 120), i)
+                                   : new QuadTreeRect(random(0, width - 100), random(0, height - 100), random(10, 50), random(10, 50), i));
+        }
+
+        QuadTree tree(QuadTreeRect(-100, -100, width * 1.5f, height * 1.5f), 4);
+        SweepAndPrune sweep;
+        SpatialHash grid(side ? 128.0f : 64.0f);
+        std::pair<const char *, Broadphase *> worlds[] = {{"scan", nullptr}, {"quadtree", &tree}, {"sweep", &sweep}, {"hash", &grid}};
+        cout << (side ? "side:" : "box:") << endl;
+        for (auto &[name, world] : worlds)
+        {
+            if (world)
+            {
+                for (auto obj : objects)
+                {
+                    world->insert(obj);
+                }
+            }
+            cout << "  " << name << ":";
+            benchQueries(world, objects, width, height, 20000);
+            if (world)
+            {
+                for (auto obj : objects)
+                {
+                    world->remove(obj->id);
+                }
+            }
+        }
+        for (auto obj : objects)
+        {
+            delete obj;
+        }
+    }
+}
+
+void test1()
+{
+    // 四叉树边界 (0,0) 到 (1000,1000)
+    QuadTreeRect bound(0, 0, 1000, 1000);
+    QuadTree tree(bound, 4); // 容量4，最大深度8
+
+    QuadTreeRect *rect1 = new QuadTreeRect(0, 100, 10, 10, 1);
+    QuadTreeRect *rect2 = new QuadTreeRect(100, 100, 100, 100, 2);
+
+    // 插入矩形到四叉树
+    tree.insert(rect1);
+    tree.insert(rect2);
+
+    cout << "QuadTree Debug Test" << endl;
+    cout << "Commands: w (up), s (down), a (left), d (right), q (quit)" << endl;
+
+    string command;
+    while (true)
+    {
+        cout << "Enter command: ";
+        getline(cin, command);
+
+        if (command.empty())
+            continue;
+
+        char key = tolower(command[0]);
+        float moveAmount = 10.0f;
+
+        switch (key)
+        {
+        case 'w': // 上移
+            rect1->y -= moveAmount;
+            break;
+        case 's': // 下移
+            rect1->y += moveAmount;
+            break;
+        case 'a': // 左移
+            rect1->x -= moveAmount;
+            break;
+        case 'd': // 右移
+            rect1->x += moveAmount;
+            break;
+        case 'q': // 退出
+            goto exit_loop;
+        default:
+            cout << "Invalid command. Use w, a, s, d, or q." << endl;
+            continue;
+        }
+
+        // 边界检查
+        if (rect1->x < 0)
+            rect1->x = 0;
+        if (rect1->x + rect1->w > 1000)
+            rect1->x = 1000 - rect1->w;
+        if (rect1->y < 0)
+            rect1->y = 0;
+        if (rect1->y + rect1->h > 1000)
+            rect1->y = 1000 - rect1->h;
+
+        // 更新四叉树中的rect1位置
+        tree.update(rect1);
+
+        // 执行碰撞检测
+        tree.tick(1.0 / 60.0);
+
+        // 显示当前位置
+        cout << "Rect1 position: (" << rect1->x << ", " << rect1->y << ")" << endl;
+
+        // 查询与rect1碰撞的所有对象
+        auto collisions = tree.query(rect1);
+        cout << "Collisions with Rect1: " << collisions.size() << endl;
+        for (auto obj : collisions)
+        {
+            if (obj != rect1) // 跳过自己
+                cout << "  - Rect" << obj->id << endl;
+        }
+    }
+exit_loop:
+
+    // 清理内存
+    delete rect1;
+    delete rect2;
 }
\ No newline at end of file
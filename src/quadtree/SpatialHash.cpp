@@ -0,0 +1,270 @@
+﻿#include "SpatialHash.h"
+#include <algorithm>
+#include <limits>
+
+SpatialHash::SpatialHash(float cellSize, int bucketBits)
+    : cellSize(cellSize), invCell(1.0f / cellSize), mask((1u << bucketBits) - 1), buckets(size_t(1) << bucketBits)
+{
+}
+
+SpatialHash::Span SpatialHash::spanOf(QuadTreeRect *val) const
+{
+    return {val, cell(val->x), cell(val->y), cell(val->x + val->w), cell(val->y + val->h)};
+}
+
+void SpatialHash::link(const Span &span)
+{
+    const QuadTreeRect *val = span.item;
+    if (maxCx < minCx)
+    {
+        minCx = span.x0;
+        minCy = span.y0;
+        maxCx = span.x1;
+        maxCy = span.y1;
+    }
+    minCx = std::min(minCx, span.x0);
+    minCy = std::min(minCy, span.y0);
+    maxCx = std::max(maxCx, span.x1);
+    maxCy = std::max(maxCy, span.y1);
+    for (int cy = span.y0; cy <= span.y1; ++cy)
+    {
+        for (int cx = span.x0; cx <= span.x1; ++cx)
+        {
+            bucket(cx, cy).push_back({cx, cy, val->x, val->y, val->x + val->w, val->y + val->h, val->category, val->mask, span.item});
+        }
+    }
+}
+
+void SpatialHash::unlink(const Span &span)
+{
+    for (int cy = span.y0; cy <= span.y1; ++cy)
+    {
+        for (int cx = span.x0; cx <= span.x1; ++cx)
+        {
+            auto &list = bucket(cx, cy);
+            for (size_t i = 0; i < list.size(); ++i)
+            {
+                if (list[i].item == span.item && list[i].cx == cx && list[i].cy == cy)
+                {
+                    list[i] = list.back();
+                    list.pop_back();
+                    break;
+                }
+            }
+        }
+    }
+}
+
+bool SpatialHash::add(QuadTreeRect *val)
+{
+    val->slot = static_cast<int>(spans.size());
+    spans.push_back(spanOf(val));
+    link(spans.back());
+    return true;
+}
+
+void SpatialHash::drop(QuadTreeRect *val)
+{
+    if (val->slot < 0)
+    {
+        return;
+    }
+    unlink(spans[val->slot]);
+    spans[val->slot] = spans.back();
+    spans[val->slot].item->slot = val->slot;
+    spans.pop_back();
+    val->slot = -1;
+}
+
+void SpatialHash::refresh(QuadTreeRect *val)
+{
+    if (val->slot < 0)
+    {
+        return;
+    }
+    Span &span = spans[val->slot];
+    const Span next = spanOf(val);
+    if (next.x0 != span.x0 || next.y0 != span.y0 || next.x1 != span.x1 || next.y1 != span.y1)
+    {
+        unlink(span);
+        span = next;
+        link(span);
+        return;
+    }
+    // 还在原来的格子中, 只更新包围盒和过滤条件
+    for (int cy = span.y0; cy <= span.y1; ++cy)
+    {
+        for (int cx = span.x0; cx <= span.x1; ++cx)
+        {
+            for (Entry &e : bucket(cx, cy))
+            {
+                if (e.item == val && e.cx == cx && e.cy == cy)
+                {
+                    e.minX = val->x;
+                    e.minY = val->y;
+                    e.maxX = val->x + val->w;
+                    e.maxY = val->y + val->h;
+                    e.category = val->category;
+                    e.mask = val->mask;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void SpatialHash::query(const QuadTreeRect *range, std::vector<QuadTreeRect *> &result) const
+{
+    query(range, [&](QuadTreeRect *item)
+          { result.push_back(item); });
+}
+
+void SpatialHash::visit(const QuadTreeRect *range, void (*fn)(void *, QuadTreeRect *), void *context) const
+{
+    query(range, [&](QuadTreeRect *item)
+          { fn(context, item); });
+}
+
+bool SpatialHash::raycast(float x0, float y0, float x1, float y1, RayHit &hit, const QuadTreeRect *self) const
+{
+    const Filter filter(self);
+    const float dx = x1 - x0, dy = y1 - y0;
+    // 先把线段裁到登记过条目的范围内
+    float enter;
+    if (maxCx < minCx || !segment(x0, y0, dx, dy, minCx * cellSize, minCy * cellSize, (maxCx + 1) * cellSize, (maxCy + 1) * cellSize, 1, enter))
+    {
+        return false;
+    }
+    int cx = std::clamp(cell(x0 + dx * enter), minCx, maxCx);
+    int cy = std::clamp(cell(y0 + dy * enter), minCy, maxCy);
+    const int stepX = dx > 0 ? 1 : -1, stepY = dy > 0 ? 1 : -1;
+    const float inf = std::numeric_limits<float>::infinity();
+    // 线段离开当前格子 x / y 边界时的 t; 每次按边界坐标重新计算而不是累加增量, 与条目的求交结果一致
+    auto boundX = [&](int cx)
+    { return dx == 0 ? inf : ((cx + (dx > 0)) * cellSize - x0) / dx; };
+    auto boundY = [&](int cy)
+    { return dy == 0 ? inf : ((cy + (dy > 0)) * cellSize - y0) / dy; };
+    float nextX = boundX(cx), nextY = boundY(cy);
+
+    QuadTreeRect *best = nullptr;
+    float bestT = 1;
+    auto scan = [&](int cx, int cy)
+    {
+        for (const Entry &e : bucket(cx, cy))
+        {
+            if (e.cx == cx && e.cy == cy && filter.accepts(e.item, e.category, e.mask) &&
+                segment(x0, y0, dx, dy, e.minX, e.minY, e.maxX, e.maxY, bestT, enter) &&
+                (!best || enter < bestT || e.item->id < best->id))
+            {
+                best = e.item;
+                bestT = enter;
+            }
+        }
+    };
+    while (true)
+    {
+        scan(cx, cy);
+        // 后面格子里的条目最早也在离开这一格时才碰到 (相等时还要比 id)
+        const float leave = std::min(nextX, nextY);
+        if ((best && bestT < leave) || leave > 1)
+        {
+            break;
+        }
+        if (nextX < nextY)
+        {
+            cx += stepX;
+            nextX = boundX(cx);
+        }
+        else if (nextY < nextX)
+        {
+            cy += stepY;
+            nextY = boundY(cy);
+        }
+        else
+        {
+            // 正好穿过格子的角: 角上相邻的两格也可能有只碰到这一点的条目
+            if (cx + stepX >= minCx && cx + stepX <= maxCx)
+            {
+                scan(cx + stepX, cy);
+            }
+            if (cy + stepY >= minCy && cy + stepY <= maxCy)
+            {
+                scan(cx, cy + stepY);
+            }
+            cx += stepX;
+            cy += stepY;
+            nextX = boundX(cx);
+            nextY = boundY(cy);
+        }
+        if (cx < minCx || cx > maxCx || cy < minCy || cy > maxCy)
+        {
+            break;
+        }
+    }
+    if (!best)
+    {
+        return false;
+    }
+    hit.item = best;
+    hit.t = bestT;
+    hit.x = x0 + dx * bestT;
+    hit.y = y0 + dy * bestT;
+    return true;
+}
+
+void SpatialHash::nearest(float x, float y, int k, std::vector<Neighbor> &result, const QuadTreeRect *self) const
+{
+    result.clear();
+    if (k <= 0 || maxCx < minCx)
+    {
+        return;
+    }
+    const Filter filter(self);
+    const int px = cell(x), py = cell(y);
+    // 跨多格的条目只在包围盒上离该点最近的那一点所在的格子处理, 不会重复
+    auto scan = [&](int cx, int cy)
+    {
+        for (const Entry &e : bucket(cx, cy))
+        {
+            if (e.cx == cx && e.cy == cy && filter.accepts(e.item, e.category, e.mask) &&
+                cell(std::clamp(x, e.minX, e.maxX)) == cx && cell(std::clamp(y, e.minY, e.maxY)) == cy)
+            {
+                offer(result, k, e.item, distance2(x, y, e.minX, e.minY, e.maxX, e.maxY));
+            }
+        }
+    };
+    // 与该点所在格子的切比雪夫距离为 r 的一圈; 登记范围之外的圈是空的, 从碰到范围的那一圈开始
+    int r = std::max({minCx - px, px - maxCx, minCy - py, py - maxCy, 0});
+    for (;; ++r)
+    {
+        const int x0 = std::max(px - r, minCx), x1 = std::min(px + r, maxCx);
+        const int y0 = std::max(py - r, minCy), y1 = std::min(py + r, maxCy);
+        for (int cy = y0; cy <= y1; ++cy)
+        {
+            if (cy == py - r || cy == py + r)
+            {
+                for (int cx = x0; cx <= x1; ++cx)
+                {
+                    scan(cx, cy);
+                }
+                continue;
+            }
+            if (px - r >= minCx)
+            {
+                scan(px - r, cy);
+            }
+            if (r > 0 && px + r <= maxCx)
+            {
+                scan(px + r, cy);
+            }
+        }
+        // 还没看过的条目都在更外面的圈, 离该点至少 r 格
+        const float reach = r * cellSize;
+        if (farthest(result, k) <= reach * reach ||
+            (px - r <= minCx && px + r >= maxCx && py - r <= minCy && py + r >= maxCy))
+        {
+            break;
+        }
+    }
+    std::sort_heap(result.begin(), result.end(), nearer);
+}
@@ -0,0 +1,96 @@
+﻿#pragma once
+#include "Broadphase.h"
+#include <algorithm>
+#include <cmath>
+// 均匀网格空间哈希: 世界按 cellSize 切成方格, 条目登记在包围盒覆盖的每一格中
+// 格子坐标哈希到固定数量的桶, 不需要预先知道世界范围; 物体大小与格子相当时, 查询和更新都只涉及几格。
+// 条目在桶中记录所在格子, 哈希冲突的其他格子的条目查询时跳过; 跨多格的条目只在
+// 它与查询范围相交部分的左上角所在的那一格报告, 不需要去重。没有范围限制, insert 总是成功。
+class SpatialHash : public Broadphase
+{
+public:
+    // 桶数为 2 的 bucketBits 次方
+    explicit SpatialHash(float cellSize, int bucketBits = 12);
+
+    using Broadphase::query;
+    void query(const QuadTreeRect *range, std::vector<QuadTreeRect *> &result) const override;
+    // 查询, 对每个相交的条目调用 visit(QuadTreeRect *); 遍历期间不能增删条目
+    template <typename Visit>
+    void query(const QuadTreeRect *range, Visit &&visit) const;
+
+    // 沿线段逐格前进 (DDA), 已找到的命中早于下一格时停止
+    bool raycast(float x0, float y0, float x1, float y1, RayHit &hit, const QuadTreeRect *self = nullptr) const override;
+    // 从该点所在的格子一圈圈向外找, 目前第 k 近的比下一圈还近时停止
+    void nearest(float x, float y, int k, std::vector<Neighbor> &result, const QuadTreeRect *self = nullptr) const override;
+
+protected:
+    bool add(QuadTreeRect *val) override;
+    void drop(QuadTreeRect *val) override;
+    void refresh(QuadTreeRect *val) override;
+    void visit(const QuadTreeRect *range, void (*fn)(void *, QuadTreeRect *), void *context) const override;
+
+private:
+    // 条目在一个格子中的登记
+    struct Entry
+    {
+        int cx, cy;
+        float minX, minY, maxX, maxY;
+        uint32_t category, mask;
+        QuadTreeRect *item;
+    };
+    // 条目覆盖的格子范围 [x0, x1] × [y0, y1], 按 QuadTreeRect::slot 索引
+    struct Span
+    {
+        QuadTreeRect *item;
+        int x0, y0, x1, y1;
+    };
+
+    float cellSize, invCell;
+    uint32_t mask;
+    std::vector<std::vector<Entry>> buckets;
+    std::vector<Span> spans;
+    // 登记过条目的格子范围 (只增不减), 射线和最近邻查询不走出这个范围
+    int minCx = 0, minCy = 0, maxCx = -1, maxCy = -1;
+
+    int cell(float v) const
+    {
+        return static_cast<int>(std::floor(v * invCell));
+    }
+    const std::vector<Entry> &bucket(int cx, int cy) const
+    {
+        return buckets[(static_cast<uint32_t>(cx) * 73856093u ^ static_cast<uint32_t>(cy) * 19349663u) & mask];
+    }
+    std::vector<Entry> &bucket(int cx, int cy)
+    {
+        return buckets[(static_cast<uint32_t>(cx) * 73856093u ^ static_cast<uint32_t>(cy) * 19349663u) & mask];
+    }
+    Span spanOf(QuadTreeRect *val) const;
+    void link(const Span &span);
+    void unlink(const Span &span);
+};
+
+template <typename Visit>
+void SpatialHash::query(const QuadTreeRect *range, Visit &&visit) const
+{
+    const float left = range->x, right = range->x + range->w;
+    const float top = range->y, bottom = range->y + range->h;
+    const uint32_t category = range->category, mask = range->mask;
+    const int x0 = cell(left), x1 = cell(right), y0 = cell(top), y1 = cell(bottom);
+    for (int cy = y0; cy <= y1; ++cy)
+    {
+        for (int cx = x0; cx <= x1; ++cx)
+        {
+            for (const Entry &e : bucket(cx, cy))
+            {
+                if (e.cx != cx || e.cy != cy || !(e.category & mask) || !(e.mask & category) || right < e.minX || left > e.maxX || bottom < e.minY || top > e.maxY)
+                {
+                    continue;
+                }
+                if (cell(std::max(e.minX, left)) == cx && cell(std::max(e.minY, top)) == cy)
+                {
+                    visit(e.item);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,124 @@
+﻿#include "SweepAndPrune.h"
+#include <algorithm>
+
+void SweepAndPrune::sync(Entry &e, const QuadTreeRect *val)
+{
+    e.minX = val->x;
+    e.maxX = val->x + val->w;
+    e.minY = val->y;
+    e.maxY = val->y + val->h;
+    e.category = val->category;
+    e.mask = val->mask;
+}
+
+bool SweepAndPrune::add(QuadTreeRect *val)
+{
+    Entry &e = entries.emplace_back();
+    sync(e, val);
+    e.item = val;
+    maxW = std::max(maxW, val->w);
+    sift(static_cast<int>(entries.size()) - 1);
+    return true;
+}
+
+void SweepAndPrune::drop(QuadTreeRect *val)
+{
+    if (val->slot < 0)
+    {
+        return;
+    }
+    // 保持有序, 后面的条目整体前移
+    entries.erase(entries.begin() + val->slot);
+    for (int i = val->slot; i < static_cast<int>(entries.size()); ++i)
+    {
+        entries[i].item->slot = i;
+    }
+    val->slot = -1;
+}
+
+void SweepAndPrune::refresh(QuadTreeRect *val)
+{
+    if (val->slot < 0)
+    {
+        return;
+    }
+    sync(entries[val->slot], val);
+    maxW = std::max(maxW, val->w);
+    sift(val->slot);
+}
+
+void SweepAndPrune::sift(int slot)
+{
+    const Entry e = entries[slot];
+    int i = slot;
+    while (i > 0 && entries[i - 1].minX > e.minX)
+    {
+        entries[i] = entries[i - 1];
+        entries[i].item->slot = i;
+        --i;
+    }
+    if (i == slot)
+    {
+        while (i + 1 < static_cast<int>(entries.size()) && entries[i + 1].minX < e.minX)
+        {
+            entries[i] = entries[i + 1];
+            entries[i].item->slot = i;
+            ++i;
+        }
+    }
+    entries[i] = e;
+    e.item->slot = i;
+}
+
+void SweepAndPrune::query(const QuadTreeRect *range, std::vector<QuadTreeRect *> &result) const
+{
+    query(range, [&](QuadTreeRect *item)
+          { result.push_back(item); });
+}
+
+void SweepAndPrune::visit(const QuadTreeRect *range, void (*fn)(void *, QuadTreeRect *), void *context) const
+{
+    query(range, [&](QuadTreeRect *item)
+          { fn(context, item); });
+}
+
+void SweepAndPrune::nearest(float x, float y, int k, std::vector<Neighbor> &result, const QuadTreeRect *self) const
+{
+    result.clear();
+    if (k <= 0)
+    {
+        return;
+    }
+    const Filter filter(self);
+    auto consider = [&](const Entry &e)
+    {
+        if (filter.accepts(e.item, e.category, e.mask))
+        {
+            offer(result, k, e.item, distance2(x, y, e.minX, e.minY, e.maxX, e.maxY));
+        }
+    };
+    const size_t split = std::lower_bound(entries.begin(), entries.end(), x, [](const Entry &e, float v)
+                                          { return e.minX < v; }) -
+                         entries.begin();
+    // 右边的条目左边都不小于 x, 距离至少是 minX - x
+    for (size_t i = split; i < entries.size(); ++i)
+    {
+        const float gap = entries[i].minX - x;
+        if (gap * gap > farthest(result, k))
+        {
+            break;
+        }
+        consider(entries[i]);
+    }
+    // 左边的条目右边不超过 minX + maxW, 距离至少是 x - (minX + maxW)
+    for (size_t i = split; i-- > 0;)
+    {
+        const float gap = x - (entries[i].minX + maxW);
+        if (gap > 0 && gap * gap > farthest(result, k))
+        {
+            break;
+        }
+        consider(entries[i]);
+    }
+    std::sort_heap(result.begin(), result.end(), nearer);
+}
@@ -0,0 +1,59 @@
+﻿#pragma once
+#include "Broadphase.h"
+#include <algorithm>
+// 一维扫掠剪枝 (sweep and prune): 条目按包围盒左边 (minX) 排序存放在一个数组中
+// 查询时二分找到左边可能相交的一段, 再逐个比较完整的包围盒; 横版场景物体几乎只沿 x 分布, 这一段很短。
+// 包围盒变化时条目就地向左或向右挪到有序的位置 (插入排序), 帧间位移很小, 通常只挪0~1格。
+// 没有范围限制, insert 总是成功。
+class SweepAndPrune : public Broadphase
+{
+public:
+    using Broadphase::query;
+    void query(const QuadTreeRect *range, std::vector<QuadTreeRect *> &result) const override;
+    // 查询, 对每个相交的条目调用 visit(QuadTreeRect *); 遍历期间不能增删条目
+    template <typename Visit>
+    void query(const QuadTreeRect *range, Visit &&visit) const;
+
+    // 从该点的 x 处向右、向左扫, x 方向的距离超过目前第 k 近的就停
+    void nearest(float x, float y, int k, std::vector<Neighbor> &result, const QuadTreeRect *self = nullptr) const override;
+
+protected:
+    bool add(QuadTreeRect *val) override;
+    void drop(QuadTreeRect *val) override;
+    void refresh(QuadTreeRect *val) override;
+    void visit(const QuadTreeRect *range, void (*fn)(void *, QuadTreeRect *), void *context) const override;
+
+private:
+    struct Entry
+    {
+        float minX, maxX, minY, maxY;
+        uint32_t category, mask;
+        QuadTreeRect *item;
+    };
+    // 按 minX 升序, 条目下标记在 QuadTreeRect::slot
+    std::vector<Entry> entries;
+    // 条目的最大宽度 (只增不减); 左边比查询范围左边小这么多以上的条目不可能相交
+    float maxW = 0;
+
+    // 复制包围盒和过滤条件
+    static void sync(Entry &e, const QuadTreeRect *val);
+    // 把 slot 处的条目挪到有序的位置
+    void sift(int slot);
+};
+
+template <typename Visit>
+void SweepAndPrune::query(const QuadTreeRect *range, Visit &&visit) const
+{
+    const float left = range->x, right = range->x + range->w;
+    const float top = range->y, bottom = range->y + range->h;
+    const uint32_t category = range->category, mask = range->mask;
+    auto it = std::lower_bound(entries.begin(), entries.end(), left - maxW, [](const Entry &e, float v)
+                               { return e.minX < v; });
+    for (; it != entries.end() && it->minX <= right; ++it)
+    {
+        if ((it->category & mask) && (it->mask & category) && !(left > it->maxX || bottom < it->minY || top > it->maxY))
+        {
+            visit(it->item);
+        }
+    }
+}
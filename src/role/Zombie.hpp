@@ -11,6 +11,8 @@ public:
     Zombie(int x, int y) : LaoA(x, y)
     {
         speed = rand() % 50 + 10;
+        // 僵尸之间不碰撞, 成群出现时不产生僵尸对僵尸的碰撞对和回调
+        Broadphase::WORLD->setFilter(rect.get(), LAYER_ZOMBIE, ~static_cast<uint32_t>(LAYER_ZOMBIE));
     }
     void tick(double deltaTime) override
     {
@@ -1,123 +1,143 @@
-﻿#pragma once
-#include "../Scene.h"
-#include "../GDI.h"
-#include <vector>
-#include <memory>
-#include "../Role.h"
-#include "../Camera.h"
-#include <ctime>
-#include "../Audios.h"
-#include "../KV.h"
-#include "../Input.h"
-#include "../role/LaoA.hpp"
-#include "../role/Zombie.hpp"
-#include "../role/MountKnight.hpp"
-#include "../role/PlatForm.hpp"
-
-extern int GAME_WIDTH;
-extern int GAME_HEIGHT;
-extern int GAME_OFFSET_X;
-extern int GAME_LINE;
-extern int WORLD_LEFT;
-extern int WORLD_RIGHT;
-class GameScene : public Scene
-{
-
-protected:
-    std::vector<std::unique_ptr<Role>> roleVec;
-    Role *role;
-    int floorX = 0;
-
-    double zombieTime = 0;
-    int max = 0;
-
-public:
-    void beforeEnter() override
-    {
-        Audios::bg(301);
-
-        roleVec.emplace_back(std::make_unique<MountKnight>(150, GAME_LINE - 200));
-        role = roleVec.back().get();
-        roleVec.emplace_back(std::make_unique<LaoA>(150, GAME_LINE));
-        Camera::setTarget(role);
-    }
-
-    void onKeyDown(int key) override
-    {
-
-        if (role->ground && Input::IsKeyDown(' '))
-        {
-            role->jump();
-        }
-        else if (Input::IsKeyDown('R'))
-        {
-            max = 10;
-        }
-    }
-
-    void enter() override
-    {
-    }
-
-    void exit() override
-    {
-    }
-
-    void render() override
-    {
-
-        GDI::imageWorld(101, 0, 0);
-        // auto collisionList = QuadTree::WORLD->collisionListCache[role->rect.get()];
-        // int count = 0;
-        // for (auto &info : collisionList)
-        // {
-        //     count++;
-        //     uint64_t pairId = (role->id < info->id)
-        //                           ? (static_cast<uint64_t>(role->id) << 32) | info->id
-        //                           : (static_cast<uint64_t>(info->id) << 32) | role->id;
-        //     auto each = QuadTree::WORLD->collisionCache[pairId].get();
-        //     GDI::text(L"from " + std::to_wstring(each->dir), GAME_OFFSET_X + 120, count * 40);
-        // }
-        GDI::text(L"flag " + std::to_wstring(role->flag), 60, 60);
-        for (auto &role : roleVec)
-        {
-            role->render();
-        }
-        // int testId = 24;
-        // auto testRect = QuadTree::WORLD->cache[testId];
-        // GDI::text(L"debugRect " + std::to_wstring(testRect->x) + L"," + std::to_wstring(testRect->y) + L"," + std::to_wstring(testRect->w) + L"," + std::to_wstring(testRect->h), GAME_OFFSET_X + 120, 100);
-        // GDI::text(L"myRect " + std::to_wstring(role->rect->x) + L"," + std::to_wstring(role->rect->y) + L"," + std::to_wstring(role->rect->w) + L"," + std::to_wstring(role->rect->h), GAME_OFFSET_X + 120, 130);
-        // GDI::text(L"ground " + std::to_wstring(role->ground), GAME_OFFSET_X + 120, 130);
-    }
-
-    void renderGlobal() override
-    {
-    }
-
-    void tick(double deltaTime) override
-    {
-        if (Input::IsKeyDown('A'))
-        {
-            role->handVec->k -= 100;
-        }
-        else if (Input::IsKeyDown('D'))
-        {
-            role->handVec->k += 100;
-        }
-
-        zombieTime -= deltaTime;
-
-        if (zombieTime <= 0 && max > 0)
-        {
-            max--;
-            roleVec.emplace_back(std::make_unique<Zombie>(role->x, GAME_LINE));
-            zombieTime = 0.5;
-        }
-
-        for (auto &role : roleVec)
-        {
-
-            role->tick(deltaTime);
-        }
-    }
-};
+﻿#pragma once
+#include "../Scene.h"
+#include "../GDI.h"
+#include <vector>
+#include <memory>
+#include "../Role.h"
+#include "../Camera.h"
+#include <ctime>
+#include "../Audios.h"
+#include "../KV.h"
+#include "../Input.h"
+#include "../Tilemap.h"
+#include "../TileCollision.h"
+#include "../quadtree/SweepAndPrune.h"
+#include "../role/LaoA.hpp"
+#include "../role/Zombie.hpp"
+#include "../role/MountKnight.hpp"
+
+extern int GAME_WIDTH;
+extern int GAME_HEIGHT;
+extern int GAME_OFFSET_X;
+extern int GAME_OFFSET_Y;
+extern int GAME_LINE;
+extern int WORLD_LEFT;
+extern int WORLD_RIGHT;
+class GameScene : public Scene
+{
+
+protected:
+    std::vector<std::unique_ptr<Role>> roleVec;
+    Tilemap map;
+    Role *role;
+    int floorX = 0;
+
+    double zombieTime = 0;
+    int max = 0;
+
+public:
+    // 横版关卡, 角色几乎只沿 x 分布和移动, 按 x 排序的扫掠剪枝比四叉树快
+    // 碰撞查询保持串行: 并行查询还没有在多核机器上实测过收益, 需要时用 setThreadCount 开启
+    std::unique_ptr<Broadphase> createWorld() override
+    {
+        return std::make_unique<SweepAndPrune>();
+    }
+
+    void beforeEnter() override
+    {
+        // 地图直接按 Tiled 工程分块绘制, 读不到地图 (如没有资源包) 时退回整张背景图
+        if (!map.load(GDI::resourceDir() + "/tile", "project/战斗女仆地图.tmx", GDI::sprites()))
+            pinImages({101});
+        // 地形碰撞由地图的碰撞层烘焙, 不经过 Broadphase::WORLD; 没有地图时角色落在 GAME_LINE
+        TileCollision::WORLD = std::make_unique<TileCollision>();
+        if (!map.bakeCollision(*TileCollision::WORLD))
+            TileCollision::WORLD.reset();
+        // 角色图像, 标题画面已预取过时这里不会重复解码
+        pinImages({201, 202});
+        Audios::bg(301);
+
+        roleVec.emplace_back(std::make_unique<MountKnight>(150, GAME_LINE - 200));
+        role = roleVec.back().get();
+        roleVec.emplace_back(std::make_unique<LaoA>(150, GAME_LINE));
+        Camera::setTarget(role);
+    }
+
+    void onKeyDown(int key) override
+    {
+
+        if (role->ground && Input::IsKeyDown(' '))
+        {
+            role->jump();
+        }
+        else if (Input::IsKeyDown('R'))
+        {
+            max = 10;
+        }
+    }
+
+    void enter() override
+    {
+    }
+
+    void exit() override
+    {
+    }
+
+    void render() override
+    {
+
+        if (map.isLoaded())
+            map.render(GAME_OFFSET_X, GAME_OFFSET_Y, GAME_WIDTH, GAME_HEIGHT);
+        else
+            GDI::imageWorld(101, 0, 0);
+        // auto &collisionList = role->rect->contacts;
+        // int count = 0;
+        // for (auto &info : collisionList)
+        // {
+        //     count++;
+        //     auto each = Broadphase::WORLD->collisionCache.find(QuadTreePairs::pairId(role->id, info->id));
+        //     GDI::text(L"from " + std::to_wstring(each->dir), GAME_OFFSET_X + 120, count * 40);
+        // }
+        GDI::textf(60, 60, 12.0f, Gdiplus::Color::White, L"flag %d", role->flag);
+        for (auto &role : roleVec)
+        {
+            role->render();
+        }
+        // int testId = 24;
+        // auto testRect = Broadphase::WORLD->cache[testId];
+        // GDI::text(L"debugRect " + std::to_wstring(testRect->x) + L"," + std::to_wstring(testRect->y) + L"," + std::to_wstring(testRect->w) + L"," + std::to_wstring(testRect->h), GAME_OFFSET_X + 120, 100);
+        // GDI::text(L"myRect " + std::to_wstring(role->rect->x) + L"," + std::to_wstring(role->rect->y) + L"," + std::to_wstring(role->rect->w) + L"," + std::to_wstring(role->rect->h), GAME_OFFSET_X + 120, 130);
+        // GDI::text(L"ground " + std::to_wstring(role->ground), GAME_OFFSET_X + 120, 130);
+    }
+
+    void renderGlobal() override
+    {
+    }
+
+    void tick(double deltaTime) override
+    {
+        if (Input::IsKeyDown('A'))
+        {
+            role->handVec->k -= 100;
+        }
+        else if (Input::IsKeyDown('D'))
+        {
+            role->handVec->k += 100;
+        }
+
+        zombieTime -= deltaTime;
+
+        if (zombieTime <= 0 && max > 0)
+        {
+            max--;
+            roleVec.emplace_back(std::make_unique<Zombie>(role->x, GAME_LINE));
+            zombieTime = 0.5;
+        }
+
+        for (auto &role : roleVec)
+        {
+
+            role->tick(deltaTime);
+        }
+    }
+};
@@ -0,0 +1,517 @@
+﻿#include "Png.h"
+#include <cstring>
+
+namespace
+{
+    // --- inflate (RFC 1951), 按 puff 的规范霍夫曼码方式解码 ---
+
+    struct BitReader
+    {
+        const uint8_t *data;
+        size_t size;
+        size_t pos = 0;
+        uint32_t bitBuf = 0;
+        int bitCount = 0;
+        bool overrun = false;
+
+        int bits(int need)
+        {
+            uint32_t val = bitBuf;
+            while (bitCount < need)
+            {
+                if (pos >= size)
+                {
+                    overrun = true;
+                    return 0;
+                }
+                val |= static_cast<uint32_t>(data[pos++]) << bitCount;
+                bitCount += 8;
+            }
+            bitBuf = val >> need;
+            bitCount -= need;
+            return static_cast<int>(val & ((1u << need) - 1));
+        }
+    };
+
+    constexpr int MAX_BITS = 15;
+
+    struct Huffman
+    {
+        uint16_t count[MAX_BITS + 1];
+        uint16_t symbol[288];
+    };
+
+    // 由码长构造规范霍夫曼表, 码长不完整(只有一个码)也允许
+    bool buildHuffman(Huffman &h, const uint8_t *lengths, int n)
+    {
+        memset(h.count, 0, sizeof(h.count));
+        for (int i = 0; i < n; ++i)
+            h.count[lengths[i]]++;
+        if (h.count[0] == n)
+            return true;
+
+        int left = 1;
+        for (int len = 1; len <= MAX_BITS; ++len)
+        {
+            left <<= 1;
+            left -= h.count[len];
+            if (left < 0)
+                return false;
+        }
+
+        uint16_t offs[MAX_BITS + 1];
+        offs[1] = 0;
+        for (int len = 1; len < MAX_BITS; ++len)
+            offs[len + 1] = offs[len] + h.count[len];
+        for (int i = 0; i < n; ++i)
+        {
+            if (lengths[i] != 0)
+                h.symbol[offs[lengths[i]]++] = static_cast<uint16_t>(i);
+        }
+        return true;
+    }
+
+    int decodeSymbol(BitReader &br, const Huffman &h)
+    {
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len <= MAX_BITS; ++len)
+        {
+            code |= br.bits(1);
+            if (br.overrun)
+                return -1;
+            int count = h.count[len];
+            if (code - count < first)
+                return h.symbol[index + (code - first)];
+            index += count;
+            first += count;
+            first <<= 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+    const uint16_t LEN_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                   35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    const uint8_t LEN_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                   3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    const uint16_t DIST_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    bool inflateCodes(BitReader &br, std::vector<uint8_t> &out, const Huffman &lencode, const Huffman &distcode)
+    {
+        while (true)
+        {
+            int sym = decodeSymbol(br, lencode);
+            if (sym < 0)
+                return false;
+            if (sym < 256)
+            {
+                out.push_back(static_cast<uint8_t>(sym));
+                continue;
+            }
+            if (sym == 256)
+                return true;
+
+            sym -= 257;
+            if (sym >= 29)
+                return false;
+            int len = LEN_BASE[sym] + br.bits(LEN_EXTRA[sym]);
+            int dsym = decodeSymbol(br, distcode);
+            if (dsym < 0 || dsym >= 30)
+                return false;
+            size_t dist = DIST_BASE[dsym] + br.bits(DIST_EXTRA[dsym]);
+            if (br.overrun || dist > out.size())
+                return false;
+            size_t from = out.size() - dist;
+            for (int i = 0; i < len; ++i)
+                out.push_back(out[from + i]);
+        }
+    }
+
+    bool inflateFixed(BitReader &br, std::vector<uint8_t> &out)
+    {
+        static Huffman lencode, distcode;
+        static bool built = false;
+        if (!built)
+        {
+            uint8_t lengths[288];
+            int i = 0;
+            for (; i < 144; ++i)
+                lengths[i] = 8;
+            for (; i < 256; ++i)
+                lengths[i] = 9;
+            for (; i < 280; ++i)
+                lengths[i] = 7;
+            for (; i < 288; ++i)
+                lengths[i] = 8;
+            buildHuffman(lencode, lengths, 288);
+            for (i = 0; i < 30; ++i)
+                lengths[i] = 5;
+            buildHuffman(distcode, lengths, 30);
+            built = true;
+        }
+        return inflateCodes(br, out, lencode, distcode);
+    }
+
+    bool inflateDynamic(BitReader &br, std::vector<uint8_t> &out)
+    {
+        static const uint8_t ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        int nlen = br.bits(5) + 257;
+        int ndist = br.bits(5) + 1;
+        int ncode = br.bits(4) + 4;
+        if (br.overrun || nlen > 286 || ndist > 30)
+            return false;
+
+        uint8_t lengths[320] = {};
+        for (int i = 0; i < ncode; ++i)
+            lengths[ORDER[i]] = static_cast<uint8_t>(br.bits(3));
+        Huffman lencode, distcode;
+        if (!buildHuffman(lencode, lengths, 19))
+            return false;
+
+        int index = 0;
+        while (index < nlen + ndist)
+        {
+            int sym = decodeSymbol(br, lencode);
+            if (sym < 0)
+                return false;
+            if (sym < 16)
+            {
+                lengths[index++] = static_cast<uint8_t>(sym);
+                continue;
+            }
+            uint8_t len = 0;
+            int repeat;
+            if (sym == 16)
+            {
+                if (index == 0)
+                    return false;
+                len = lengths[index - 1];
+                repeat = 3 + br.bits(2);
+            }
+            else if (sym == 17)
+                repeat = 3 + br.bits(3);
+            else
+                repeat = 11 + br.bits(7);
+            if (index + repeat > nlen + ndist)
+                return false;
+            while (repeat--)
+                lengths[index++] = len;
+        }
+        if (lengths[256] == 0)
+            return false;
+        if (!buildHuffman(lencode, lengths, nlen) || !buildHuffman(distcode, lengths + nlen, ndist))
+            return false;
+        return inflateCodes(br, out, lencode, distcode);
+    }
+
+    uint32_t readBE32(const uint8_t *p)
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+    }
+
+    uint8_t paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = p > a ? p - a : a - p;
+        int pb = p > b ? p - b : b - p;
+        int pc = p > c ? p - c : c - p;
+        if (pa <= pb && pa <= pc)
+            return static_cast<uint8_t>(a);
+        if (pb <= pc)
+            return static_cast<uint8_t>(b);
+        return static_cast<uint8_t>(c);
+    }
+
+    // 预乘, 四舍五入; 半透明像素与 GDI+ 的 PARGB 转换可能差 1, 见 SpritePack.h
+    inline uint32_t premultiply(uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+    {
+        if (a == 255)
+            return (a << 24) | (r << 16) | (g << 8) | b;
+        r = (r * a + 127) / 255;
+        g = (g * a + 127) / 255;
+        b = (b * a + 127) / 255;
+        return (a << 24) | (r << 16) | (g << 8) | b;
+    }
+}
+
+bool Png::inflate(const uint8_t *data, size_t size, std::vector<uint8_t> &out)
+{
+    // zlib 头: CM=8, 不支持预设字典
+    if (size < 2 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20))
+        return false;
+
+    BitReader br{data + 2, size - 2};
+    int last;
+    do
+    {
+        last = br.bits(1);
+        int type = br.bits(2);
+        if (br.overrun)
+            return false;
+        bool ok;
+        if (type == 0)
+        { // 存储块: 丢弃到字节边界
+            br.bitBuf = 0;
+            br.bitCount = 0;
+            if (br.pos + 4 > br.size)
+                return false;
+            unsigned len = br.data[br.pos] | (br.data[br.pos + 1] << 8);
+            unsigned nlen = br.data[br.pos + 2] | (br.data[br.pos + 3] << 8);
+            br.pos += 4;
+            if (len != (~nlen & 0xFFFF) || br.pos + len > br.size)
+                return false;
+            out.insert(out.end(), br.data + br.pos, br.data + br.pos + len);
+            br.pos += len;
+            ok = true;
+        }
+        else if (type == 1)
+            ok = inflateFixed(br, out);
+        else if (type == 2)
+            ok = inflateDynamic(br, out);
+        else
+            ok = false;
+        if (!ok)
+            return false;
+    } while (!last);
+    return true;
+}
+
+bool Png::decode(const std::vector<uint8_t> &file, Image &out, std::string &error)
+{
+    static const uint8_t SIGNATURE[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    if (file.size() < 8 || memcmp(file.data(), SIGNATURE, 8) != 0)
+    {
+        error = "not a PNG file";
+        return false;
+    }
+
+    uint32_t width = 0, height = 0;
+    int depth = 0, colorType = -1, interlace = 0;
+    std::vector<uint8_t> idat;
+    uint32_t palette[256] = {};
+    int paletteSize = 0;
+    // tRNS: 调色板alpha, 或灰度/RGB的透明色键
+    uint8_t paletteAlpha[256];
+    memset(paletteAlpha, 255, sizeof(paletteAlpha));
+    bool hasKey = false;
+    uint16_t key[3] = {};
+
+    size_t pos = 8;
+    while (pos + 8 <= file.size())
+    {
+        uint32_t len = readBE32(&file[pos]);
+        const uint8_t *type = &file[pos + 4];
+        const uint8_t *body = &file[pos + 8];
+        if (len > file.size() - pos - 8 || file.size() - pos - 8 - len < 4)
+        {
+            error = "truncated chunk";
+            return false;
+        }
+        if (!memcmp(type, "IHDR", 4) && len >= 13)
+        {
+            width = readBE32(body);
+            height = readBE32(body + 4);
+            depth = body[8];
+            colorType = body[9];
+            interlace = body[12];
+        }
+        else if (!memcmp(type, "PLTE", 4))
+        {
+            paletteSize = static_cast<int>(len / 3 > 256 ? 256 : len / 3);
+            for (int i = 0; i < paletteSize; ++i)
+                palette[i] = (uint32_t(body[i * 3]) << 16) | (uint32_t(body[i * 3 + 1]) << 8) | body[i * 3 + 2];
+        }
+        else if (!memcmp(type, "tRNS", 4))
+        {
+            if (colorType == 3)
+            {
+                for (uint32_t i = 0; i < len && i < 256; ++i)
+                    paletteAlpha[i] = body[i];
+            }
+            else if (colorType == 0 && len >= 2)
+            {
+                hasKey = true;
+                key[0] = static_cast<uint16_t>((body[0] << 8) | body[1]);
+            }
+            else if (colorType == 2 && len >= 6)
+            {
+                hasKey = true;
+                for (int c = 0; c < 3; ++c)
+                    key[c] = static_cast<uint16_t>((body[c * 2] << 8) | body[c * 2 + 1]);
+            }
+        }
+        else if (!memcmp(type, "IDAT", 4))
+        {
+            idat.insert(idat.end(), body, body + len);
+        }
+        else if (!memcmp(type, "IEND", 4))
+        {
+            break;
+        }
+        pos += 12 + len;
+    }
+
+    int channels;
+    switch (colorType)
+    {
+    case 0: channels = 1; break;
+    case 2: channels = 3; break;
+    case 3: channels = 1; break;
+    case 4: channels = 2; break;
+    case 6: channels = 4; break;
+    default:
+        error = "unsupported color type";
+        return false;
+    }
+    const bool depthOk = depth == 8 || (depth == 16 && colorType != 3) ||
+                         ((depth == 1 || depth == 2 || depth == 4) && (colorType == 0 || colorType == 3));
+    if (width == 0 || height == 0 || width > 65535 || height > 65535 || !depthOk || interlace > 1)
+    {
+        error = "unsupported header";
+        return false;
+    }
+    if (colorType == 3 && paletteSize == 0)
+    {
+        error = "missing palette";
+        return false;
+    }
+
+    std::vector<uint8_t> raw;
+    raw.reserve((size_t)width * height * channels * (depth == 16 ? 2 : 1) + height);
+    if (!inflate(idat.data(), idat.size(), raw))
+    {
+        error = "corrupt image data";
+        return false;
+    }
+
+    out.width = static_cast<int>(width);
+    out.height = static_cast<int>(height);
+    out.pixels.assign((size_t)width * height, 0);
+
+    const int bitsPerPixel = channels * depth;
+    const int bpp = (bitsPerPixel + 7) / 8; // 滤波时的字节距离
+    const int maxSample = (1 << depth) - 1;
+
+    // Adam7 各趟的起点和步长, 非交错图像只有一趟
+    static const int PASS[7][4] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}};
+    const int passCount = interlace ? 7 : 1;
+
+    size_t offset = 0;
+    std::vector<uint8_t> prev, cur;
+    for (int p = 0; p < passCount; ++p)
+    {
+        const int x0 = interlace ? PASS[p][0] : 0, y0 = interlace ? PASS[p][1] : 0;
+        const int dx = interlace ? PASS[p][2] : 1, dy = interlace ? PASS[p][3] : 1;
+        if (x0 >= (int)width || y0 >= (int)height)
+            continue;
+        const size_t passW = (width - x0 + dx - 1) / dx;
+        const size_t passH = (height - y0 + dy - 1) / dy;
+        const size_t stride = (passW * bitsPerPixel + 7) / 8;
+
+        prev.assign(stride, 0);
+        cur.resize(stride);
+        for (size_t row = 0; row < passH; ++row)
+        {
+            if (offset + 1 + stride > raw.size())
+            {
+                error = "truncated image data";
+                return false;
+            }
+            const int filter = raw[offset];
+            const uint8_t *src = &raw[offset + 1];
+            offset += 1 + stride;
+            for (size_t i = 0; i < stride; ++i)
+            {
+                int a = i >= (size_t)bpp ? cur[i - bpp] : 0;
+                int b = prev[i];
+                int c = i >= (size_t)bpp ? prev[i - bpp] : 0;
+                int v = src[i];
+                switch (filter)
+                {
+                case 0: break;
+                case 1: v += a; break;
+                case 2: v += b; break;
+                case 3: v += (a + b) >> 1; break;
+                case 4: v += paeth(a, b, c); break;
+                default:
+                    error = "bad filter";
+                    return false;
+                }
+                cur[i] = static_cast<uint8_t>(v);
+            }
+
+            // 逐像素转成预乘BGRA
+            uint32_t *dest = out.pixels.data() + (size_t)(y0 + row * dy) * width;
+            for (size_t i = 0; i < passW; ++i)
+            {
+                // 第 k 个通道的原始样本值
+                auto sample = [&](int k) -> int
+                {
+                    if (depth == 8)
+                        return cur[i * channels + k];
+                    if (depth == 16)
+                        return (cur[(i * channels + k) * 2] << 8) | cur[(i * channels + k) * 2 + 1];
+                    size_t bit = i * depth;
+                    return (cur[bit >> 3] >> (8 - depth - (bit & 7))) & maxSample;
+                };
+                // 样本值缩放到 8 位
+                auto to8 = [&](int v) -> uint32_t
+                {
+                    if (depth == 16)
+                        return static_cast<uint32_t>(v >> 8);
+                    return static_cast<uint32_t>(v * 255 / maxSample);
+                };
+
+                uint32_t r, g, b, a = 255;
+                switch (colorType)
+                {
+                case 0:
+                {
+                    int v = sample(0);
+                    r = g = b = to8(v);
+                    if (hasKey && v == key[0])
+                        a = 0;
+                    break;
+                }
+                case 2:
+                {
+                    int sr = sample(0), sg = sample(1), sb = sample(2);
+                    r = to8(sr);
+                    g = to8(sg);
+                    b = to8(sb);
+                    if (hasKey && sr == key[0] && sg == key[1] && sb == key[2])
+                        a = 0;
+                    break;
+                }
+                case 3:
+                {
+                    int idx = sample(0);
+                    uint32_t rgb = idx < paletteSize ? palette[idx] : 0;
+                    r = (rgb >> 16) & 0xFF;
+                    g = (rgb >> 8) & 0xFF;
+                    b = rgb & 0xFF;
+                    a = paletteAlpha[idx];
+                    break;
+                }
+                case 4:
+                    r = g = b = to8(sample(0));
+                    a = to8(sample(1));
+                    break;
+                default:
+                    r = to8(sample(0));
+                    g = to8(sample(1));
+                    b = to8(sample(2));
+                    a = to8(sample(3));
+                    break;
+                }
+                dest[(size_t)(x0 + i * dx)] = premultiply(r, g, b, a);
+            }
+            prev.swap(cur);
+            cur.resize(stride);
+        }
+    }
+    return true;
+}
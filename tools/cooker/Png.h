@@ -0,0 +1,22 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 最小PNG解码器: 支持全部颜色类型、位深、调色板透明(tRNS)和 Adam7 交错,
+// 输出预乘Alpha的BGRA (与 GDI+ PixelFormat32bppPARGB 的内存布局一致)
+namespace Png
+{
+    struct Image
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<uint32_t> pixels;
+    };
+
+    // 解码失败返回 false, error 中给出原因
+    bool decode(const std::vector<uint8_t> &file, Image &out, std::string &error);
+
+    // zlib 流解压
+    bool inflate(const uint8_t *data, size_t size, std::vector<uint8_t> &out);
+}
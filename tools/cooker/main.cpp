@@ -0,0 +1,322 @@
+﻿// 资源烘焙工具: 把 rc/resources.rc 中的PNG和额外目录下的PNG预解码打成一个资源包
+// 用法: cooker -o res/sprites.pak [-r rc/resources.rc] [-d tile] ...
+//       cooker -l res/sprites.pak      (用运行时的加载器映射并列出资源包内容)
+// 生成的包由运行时 SpritePack 映射后直接使用, 格式见 src/SpritePack.h
+#include "Png.h"
+#include "../../src/CachedImage.h"
+#include "../../src/SpritePack.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    struct Source
+    {
+        int resId = 0;
+        std::string name; // 包内名字: rc 中的相对路径, 或相对 -d 目录的路径 (UTF-8, '/' 分隔)
+        fs::path path;
+    };
+
+    // UTF-8 字符串转路径 (C++20 中 fs::u8path 已弃用)
+    fs::path utf8Path(std::string_view s)
+    {
+        return fs::path(std::u8string(reinterpret_cast<const char8_t *>(s.data()), s.size()));
+    }
+
+    std::string toName(const fs::path &p)
+    {
+        auto u8 = p.generic_u8string();
+        return std::string(reinterpret_cast<const char *>(u8.data()), u8.size());
+    }
+
+    bool endsWithPng(const fs::path &p)
+    {
+        std::string ext = p.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c)
+                       { return static_cast<char>(tolower(c)); });
+        return ext == ".png";
+    }
+
+    bool readFile(const fs::path &path, std::vector<uint8_t> &out)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // 解析 rc 文件中形如 `101 RCDATA "map/map1.png"` 的PNG资源行
+    bool parseRc(const fs::path &rcPath, std::vector<Source> &sources)
+    {
+        std::ifstream in(rcPath);
+        if (!in)
+        {
+            fprintf(stderr, "cooker: cannot open %s\n", rcPath.string().c_str());
+            return false;
+        }
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::istringstream ss(line);
+            int id;
+            std::string kind;
+            if (!(ss >> id >> kind) || kind != "RCDATA")
+                continue;
+            size_t q1 = line.find('"');
+            size_t q2 = line.find('"', q1 + 1);
+            if (q1 == std::string::npos || q2 == std::string::npos)
+                continue;
+            std::string rel = line.substr(q1 + 1, q2 - q1 - 1);
+            fs::path relPath = utf8Path(rel);
+            if (!endsWithPng(relPath))
+                continue;
+            sources.push_back({id, toName(relPath), rcPath.parent_path() / relPath});
+        }
+        return true;
+    }
+
+    void scanDir(const fs::path &dir, std::vector<Source> &sources)
+    {
+        std::vector<fs::path> files;
+        for (const auto &e : fs::recursive_directory_iterator(dir))
+        {
+            if (e.is_regular_file() && endsWithPng(e.path()))
+                files.push_back(e.path());
+        }
+        // 排序保证输出稳定
+        std::sort(files.begin(), files.end());
+        for (const auto &f : files)
+        {
+            sources.push_back({0, toName(fs::relative(f, dir)), f});
+        }
+    }
+
+    // 顺序写出资源包, pos 为当前文件偏移
+    struct PackWriter
+    {
+        std::ofstream &out;
+        uint64_t pos = 0;
+
+        void padTo(size_t align)
+        {
+            static const char zeros[SPRITE_PACK_ALIGN] = {};
+            while (pos % align != 0)
+            {
+                const size_t n = std::min<uint64_t>(align - pos % align, sizeof(zeros));
+                out.write(zeros, n);
+                pos += n;
+            }
+        }
+
+        template <typename T>
+        void write(const T *data, size_t count)
+        {
+            out.write(reinterpret_cast<const char *>(data), count * sizeof(T));
+            pos += count * sizeof(T);
+        }
+    };
+
+    void usage()
+    {
+        fprintf(stderr, "usage: cooker -o <out.pak> [-r <resources.rc>]... [-d <image dir>]...\n"
+                        "       cooker -l <pack.pak>\n");
+    }
+
+    int listPack(const char *path)
+    {
+        SpritePack pack;
+        if (!pack.open(path))
+        {
+            fprintf(stderr, "cooker: %s is not a valid sprite pack\n", path);
+            return 1;
+        }
+        for (size_t i = 0; i < pack.count(); ++i)
+        {
+            const SpritePackEntry &e = pack.entry(i);
+            CachedImage img;
+            pack.bind(e, img);
+            size_t spanCount = img.hasSpans() ? img.rowSpans[img.height] : 0;
+            printf("%6d  %5dx%-5d %-8s %7zu spans  %.*s\n", e.resId, img.width, img.height,
+                   img.isOpaque ? "opaque" : "alpha", spanCount,
+                   static_cast<int>(pack.name(e).size()), pack.name(e).data());
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 3 && !strcmp(argv[1], "-l"))
+        return listPack(argv[2]);
+
+    fs::path outPath;
+    std::vector<Source> sources;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            usage();
+            return 2;
+        }
+        if (!strcmp(arg, "-o"))
+            outPath = utf8Path(argv[++i]);
+        else if (!strcmp(arg, "-r"))
+        {
+            if (!parseRc(utf8Path(argv[++i]), sources))
+                return 1;
+        }
+        else if (!strcmp(arg, "-d"))
+        {
+            fs::path dir = utf8Path(argv[++i]);
+            if (!fs::is_directory(dir))
+            {
+                fprintf(stderr, "cooker: %s is not a directory\n", dir.string().c_str());
+                return 1;
+            }
+            scanDir(dir, sources);
+        }
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (outPath.empty() || sources.empty())
+    {
+        usage();
+        return 2;
+    }
+
+    // 同名图像只保留第一个 (rc 条目优先, 保留其资源ID)
+    std::map<std::string, size_t> seen;
+    std::vector<Source> unique;
+    for (auto &src : sources)
+    {
+        if (seen.emplace(src.name, unique.size()).second)
+            unique.push_back(std::move(src));
+    }
+
+    const uint32_t count = static_cast<uint32_t>(unique.size());
+    std::vector<SpritePackEntry> entries(count);
+    std::string names;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        entries[i] = {};
+        entries[i].nameOffset = static_cast<uint32_t>(names.size());
+        entries[i].nameLength = static_cast<uint32_t>(unique[i].name.size());
+        names += unique[i].name;
+    }
+
+    // 布局: 头部 | 索引 | 名字 | 数据区
+    // 名字在烘焙前就确定, 数据区起点随之确定; 每张图烘焙完直接写出, 最后回到文件头写头部和索引
+    SpritePackHeader header = {};
+    header.magic = SPRITE_PACK_MAGIC;
+    header.version = SPRITE_PACK_VERSION;
+    header.count = count;
+    header.indexOffset = sizeof(SpritePackHeader);
+    header.namesOffset = header.indexOffset + (uint64_t)count * sizeof(SpritePackEntry);
+
+    if (outPath.has_parent_path())
+        fs::create_directories(outPath.parent_path());
+    std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+    auto fail = [&]()
+    {
+        out.close();
+        std::error_code ec;
+        fs::remove(outPath, ec);
+        return 1;
+    };
+    PackWriter pack{out};
+    {
+        const std::vector<char> head(header.namesOffset + names.size(), 0);
+        pack.write(head.data(), head.size());
+    }
+    pack.padTo(SPRITE_PACK_ALIGN);
+
+    size_t totalPixels = 0;
+    for (uint32_t i = 0; i < count && out; ++i)
+    {
+        const Source &src = unique[i];
+        std::vector<uint8_t> file;
+        if (!readFile(src.path, file))
+        {
+            fprintf(stderr, "cooker: cannot read %s\n", src.path.string().c_str());
+            return fail();
+        }
+        Png::Image png;
+        std::string error;
+        if (!Png::decode(file, png, error))
+        {
+            fprintf(stderr, "cooker: %s: %s\n", src.path.string().c_str(), error.c_str());
+            return fail();
+        }
+
+        // 游程表与运行时解码生成的完全相同
+        CachedImage img;
+        memcpy(img.allocate(png.width, png.height), png.pixels.data(), png.pixels.size() * 4);
+        img.buildSpans();
+
+        SpritePackEntry &e = entries[i];
+        e.resId = src.resId;
+        e.width = static_cast<uint32_t>(img.width);
+        e.height = static_cast<uint32_t>(img.height);
+        e.flags = img.isOpaque ? static_cast<uint32_t>(SPRITE_OPAQUE) : 0u;
+
+        pack.padTo(SPRITE_PACK_ALIGN);
+        e.pixelOffset = pack.pos;
+        pack.write(img.pixels, png.pixels.size());
+
+        if (img.hasSpans())
+        {
+            e.flags |= SPRITE_HAS_SPANS;
+            e.spanCount = img.rowSpans[img.height];
+            pack.padTo(SPRITE_PACK_ALIGN);
+            e.spanOffset = pack.pos;
+            // 逐个写出, 保证填充字节为0
+            for (uint32_t s = 0; s < e.spanCount; ++s)
+            {
+                uint8_t rec[sizeof(ImageSpan)] = {};
+                memcpy(rec, &img.spans[s].x, sizeof(uint16_t));
+                memcpy(rec + 2, &img.spans[s].len, sizeof(uint16_t));
+                rec[4] = static_cast<uint8_t>(img.spans[s].type);
+                static_assert(offsetof(ImageSpan, len) == 2 && offsetof(ImageSpan, type) == 4, "span layout");
+                pack.write(rec, sizeof(rec));
+            }
+            pack.padTo(alignof(uint32_t));
+            e.rowSpanOffset = pack.pos;
+            pack.write(img.rowSpans, (size_t)img.height + 1);
+        }
+
+        totalPixels += png.pixels.size();
+        printf("%6d  %5dx%-5d %-8s %s\n", src.resId, img.width, img.height,
+               img.isOpaque ? "opaque" : "alpha", src.name.c_str());
+    }
+
+    header.fileSize = pack.pos;
+    pack.pos = 0;
+    out.seekp(0);
+    pack.write(&header, 1);
+    pack.write(entries.data(), entries.size());
+    pack.write(names.data(), names.size());
+    out.flush();
+    if (!out)
+    {
+        fprintf(stderr, "cooker: cannot write %s\n", outPath.string().c_str());
+        return fail();
+    }
+    printf("%u images, %.1f MB pixels -> %s (%llu bytes)\n", count, totalPixels * 4 / (1024.0 * 1024.0),
+           outPath.string().c_str(), static_cast<unsigned long long>(header.fileSize));
+    return 0;
+}